@@ -9,7 +9,22 @@
 
 #include <unistd.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* fast calibration (cache, CPUID, regression) - see ng_calibrate.c */
+unsigned long long ng_timer_calibrate(int *source);
+#ifdef __cplusplus
+}
+#endif
+
 #define HRT_CALIBRATE(freq) do {  \
+  freq = ng_timer_calibrate(NULL); \
+} while(0);
+
+/* the old sleep(1) based calibration - takes at least 3-4 seconds and
+ * is only used if nothing else works */
+#define HRT_CALIBRATE_SLEEP(freq) do {  \
   static volatile HRT_TIMESTAMP_T t1, t2; \
   static volatile UINT64_T elapsed_ticks, min = (UINT64_T)(~0x1); \
   int notsmaller=0; \
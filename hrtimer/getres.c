@@ -12,6 +12,12 @@
 #include <stdlib.h>
 #include "hrtimer.h"
 
+#if HRT_ARCH==2
+int g_hrt_backend = HRT_BACKEND_LFENCE;
+UINT64_T g_hrt_overhead = 0;
+unsigned long g_hrt_migrations = 0;
+#endif
+
 #define NUMTESTS 5
 
 int main() {
@@ -14,7 +14,7 @@
 #define UINT64_T uint64_t
 
 #define HRT_INIT(print, freq) do {\
-  if(print) printf("# initializing ia64 timer (takes some seconds)\n"); \
+  if(print) printf("# initializing ia64 timer\n"); \
   HRT_CALIBRATE(freq); \
 } while(0) 
 
@@ -15,7 +15,7 @@
 #define UINT64_T uint64_t
 
 #define HRT_INIT(print, freq) do {\
-  if(print) printf("# initializing mips64 (sicortex) timer (takes some seconds)\n"); \
+  if(print) printf("# initializing mips64 (sicortex) timer\n"); \
   HRT_CALIBRATE(freq); \
 } while(0) 
 
@@ -27,7 +27,7 @@
 #endif
 
 #define HRT_INIT(print, freq) do {\
-  if(print) printf("# initializing ppc timer (takes some seconds)\n"); \
+  if(print) printf("# initializing ppc timer\n"); \
   HRT_CALIBRATE(freq); \
 } while(0) 
 
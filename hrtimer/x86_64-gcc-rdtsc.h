@@ -9,27 +9,101 @@
 
 #include <inttypes.h>
 #include <stdio.h>
+#include <time.h>
 #include "calibrate.h"
 #define UINT32_T uint32_t
 #define UINT64_T uint64_t
 
-#define HRT_INIT(print, freq) do {\
-  if(print) printf("# initializing x86-64 timer (takes some seconds)\n"); \
-  HRT_CALIBRATE(freq); \
-} while(0) 
+/* timer backends (selected at runtime with --timer) */
+#define HRT_BACKEND_RDTSC   0  /* plain rdtsc, may be reordered */
+#define HRT_BACKEND_LFENCE  1  /* lfence;rdtsc;lfence */
+#define HRT_BACKEND_RDTSCP  2  /* rdtscp;lfence, detects CPU migrations */
+#define HRT_BACKEND_CLOCK   3  /* clock_gettime(CLOCK_MONOTONIC) in ns */
+
+/* the backend, the cost of one reading in ticks (subtracted from all
+ * intervals) and the number of intervals that spanned two CPUs */
+extern int g_hrt_backend;
+extern UINT64_T g_hrt_overhead;
+extern unsigned long g_hrt_migrations;
 
+static inline const char *hrt_backend_name(int backend) {
+  switch(backend) {
+    case HRT_BACKEND_LFENCE: return "lfence";
+    case HRT_BACKEND_RDTSCP: return "rdtscp";
+    case HRT_BACKEND_CLOCK: return "clock";
+  }
+  return "rdtsc";
+}
 
 typedef struct {
 	UINT32_T l;
 	UINT32_T h;
+	UINT32_T cpu; /* TSC_AUX of rdtscp (the cpu on Linux), 0 otherwise */
 } x86_64_timeval_t;
 
 #define HRT_TIMESTAMP_T x86_64_timeval_t
 
-/* TODO: Do we need a while loop here? aka Is rdtsc atomic? - check in the documentation */	
-#define HRT_GET_TIMESTAMP(t1)  __asm__ __volatile__ ("rdtsc" : "=a" (t1.l), "=d" (t1.h));
+static inline void hrt_read(x86_64_timeval_t *t) {
+  struct timespec ts;
+  UINT64_T ns;
+
+  switch(g_hrt_backend) {
+    case HRT_BACKEND_LFENCE:
+      /* waits for all earlier instructions and keeps later ones from
+       * starting before the read */
+      __asm__ __volatile__ ("lfence\n\trdtsc\n\tlfence" : "=a" (t->l), "=d" (t->h) :: "memory");
+      t->cpu = 0;
+      break;
+    case HRT_BACKEND_RDTSCP:
+      __asm__ __volatile__ ("rdtscp\n\tlfence" : "=a" (t->l), "=d" (t->h), "=c" (t->cpu) :: "memory");
+      break;
+    case HRT_BACKEND_CLOCK:
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      ns = (UINT64_T)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+      t->l = (UINT32_T)ns;
+      t->h = (UINT32_T)(ns >> 32);
+      t->cpu = 0;
+      break;
+    default:
+      __asm__ __volatile__ ("rdtsc" : "=a" (t->l), "=d" (t->h));
+      t->cpu = 0;
+  }
+}
+
+static inline UINT64_T hrt_elapsed(const x86_64_timeval_t *t1, const x86_64_timeval_t *t2) {
+  UINT64_T ticks = ((((UINT64_T)t2->h) << 32) | t2->l) - ((((UINT64_T)t1->h) << 32) | t1->l);
+
+  /* the TSCs of two CPUs are not necessarily in sync */
+  if(t1->cpu != t2->cpu) g_hrt_migrations++;
+  return ticks > g_hrt_overhead ? ticks - g_hrt_overhead : 0;
+}
+
+/* the minimum of back-to-back readings is the cost of one reading */
+static inline UINT64_T hrt_measure_overhead(void) {
+  x86_64_timeval_t t1, t2;
+  UINT64_T ticks, min = (UINT64_T)~0ULL;
+  int i;
+
+  for(i=0; i<1000; i++) {
+    hrt_read(&t1);
+    hrt_read(&t2);
+    ticks = ((((UINT64_T)t2.h) << 32) | t2.l) - ((((UINT64_T)t1.h) << 32) | t1.l);
+    if(ticks < min) min = ticks;
+  }
+  return min;
+}
+
+#define HRT_INIT(print, freq) do {\
+  if(print) printf("# initializing x86-64 timer (%s)\n", hrt_backend_name(g_hrt_backend)); \
+  HRT_CALIBRATE(freq); \
+  g_hrt_overhead = hrt_measure_overhead(); \
+  if(print) printf("# timer read overhead: %llu ticks (%.1lf ns, subtracted)\n", \
+                   (unsigned long long)g_hrt_overhead, 1e9*(double)g_hrt_overhead/(double)freq); \
+} while(0)
+
+#define HRT_GET_TIMESTAMP(t1) hrt_read((x86_64_timeval_t *)&(t1));
 
-#define HRT_GET_ELAPSED_TICKS(t1, t2, numptr)	*numptr = (((( UINT64_T ) t2.h) << 32) | t2.l) - \
-														  (((( UINT64_T ) t1.h) << 32) | t1.l);
+#define HRT_GET_ELAPSED_TICKS(t1, t2, numptr)	*numptr = hrt_elapsed((const x86_64_timeval_t *)&(t1), \
+                                                              (const x86_64_timeval_t *)&(t2));
 
 #define HRT_GET_TIME(t1, time) time = (((( UINT64_T ) t1.h) << 32) | t1.l)
@@ -0,0 +1,543 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* process_vm_readv */
+#endif
+
+#include "netgauge.h"
+#if defined NG_MOD_CMA && !defined HAVE_PROCESS_VM_READV
+#error "mode cma needs process_vm_readv()"
+#endif
+#ifdef NG_MOD_CMA
+
+#include "ng_reqpool.h"
+#include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/prctl.h>
+#include <getopt.h> /* getopt long */
+
+/* outstanding descriptors per direction (power of two) */
+#define CMA_SLOTS 64
+#define CMA_CACHELINE 64
+
+/* extern stuff */
+extern struct ng_options g_options;
+
+/* function prototypes */
+static int cma_sendto(int dst, void *buffer, int size);
+static int cma_recvfrom(int src, void *buffer, int size);
+static int cma_init(struct ng_options *global_opts);
+static int cma_getopt(int argc, char **argv, struct ng_options *global_opts);
+static void cma_writemanpage(void);
+static void cma_usage(void);
+static void cma_shutdown(struct ng_options *global_opts);
+static int cma_isendto(int dst, void *buffer, int size, NG_Request *req);
+static int cma_irecvfrom(int src, void *buffer, int size, NG_Request *req);
+static int cma_test(NG_Request *req);
+static int cma_waitall(int count, NG_Request *reqs);
+static int cma_testany(int count, NG_Request *reqs, int *index);
+static int cma_progress(int timeout);
+
+/* module registration data structure (cross memory attach) */
+struct ng_module cma_module = {
+   .name         = "cma",
+   .desc         = "Mode cma copies once between ranks on the same host with process_vm_readv/writev.",
+   .flags        = NG_MOD_RELIABLE | NG_MOD_CHANNEL,
+   .max_datasize = -1,        /*  can send data of arbitrary size */
+   .headerlen    = 0,         /*  no extra space needed for header */
+   .malloc       = NULL,
+   .getopt       = cma_getopt,
+   .init         = cma_init,
+   .shutdown     = cma_shutdown,
+   .usage        = cma_usage,
+   .writemanpage = cma_writemanpage,
+   .sendto         = cma_sendto,
+   .recvfrom       = cma_recvfrom,
+   .isendto        = cma_isendto,
+   .irecvfrom      = cma_irecvfrom,
+   .test           = cma_test,
+   .waitall        = cma_waitall,
+   .testany        = cma_testany,
+   .progress       = cma_progress,
+};
+
+/**
+ * getopt long options for cma
+ */
+static struct option long_options_cma[]={
+   {"write", no_argument, 0, 'W'},
+   {"yield", required_argument, 0, 'Y'},
+   {0, 0, 0, 0}
+};
+
+/**
+ * array of descriptions for cma
+ */
+static struct option_info long_option_infos_cma[]={
+   {"the sender writes with process_vm_writev (default: the receiver reads)", NULL},
+   {"sched_yield() while waiting (default: if there are more ranks than cores)", "on|off"},
+   {0, 0}
+};
+
+/* a buffer that the peer may copy from (read mode) or into (write mode) */
+struct cma_desc {
+   uint64_t addr;
+   uint64_t len;
+};
+
+/* descriptors from one rank to another - the consumer advances tail
+ * only after its copy, so tail also tells the producer which of its
+ * buffers are done */
+struct cma_channel {
+   uint64_t head __attribute__((aligned(CMA_CACHELINE)));
+   uint64_t tail __attribute__((aligned(CMA_CACHELINE)));
+   struct cma_desc desc[CMA_SLOTS] __attribute__((aligned(CMA_CACHELINE)));
+};
+
+/* module private data */
+struct cma_private_data {
+   /** the sender does the copy */
+   int write;
+   /** sched_yield() when idle, -1 decides at init */
+   int yield;
+   int npeers;
+   pid_t *pids;
+   /** the control segment of each peer pair and my two channels in it */
+   void **segs;
+   size_t seg_size;
+   struct cma_channel **out, **in;
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool reqpool;
+   struct ng_reqqueue *sendq, *recvq;
+   /** first request of the queue that doesn't copy (the sends in read
+    * mode, the receives in write mode) whose buffer is not in the
+    * channel yet */
+   req_handle_t **adv;
+};
+
+static struct cma_private_data module_data;
+
+
+/* parse command line parameters for module-specific options */
+static int cma_getopt(int argc, char **argv, struct ng_options *global_opts) {
+   int c;
+
+   char *optchars = "WY:";  /*  additional module options */
+
+   extern char *optarg;
+   int option_index = 0;
+   extern int optind, opterr, optopt;
+
+   int failure = 0;
+
+   /*  initialize module private information data structure */
+   memset(&module_data, 0, sizeof(module_data));
+   module_data.yield = -1;
+
+   /*  parse module-options */
+   while((c=getopt_long(argc, argv, optchars, long_options_cma, &option_index))
+         >= 0 ) {
+      switch( c ) {
+      case '?':  /* unrecognized or badly used option */
+         if (!strchr(optchars, optopt))
+            continue;  /* unrecognized */
+         ng_error("Option %c requires an argument", optopt);
+         failure = 1;
+         break;
+      case 'W':  /* sender side copy */
+         module_data.write = 1;
+         break;
+      case 'Y':  /* yield when idle */
+         if (strcmp(optarg, "on") == 0) module_data.yield = 1;
+         else if (strcmp(optarg, "off") == 0) module_data.yield = 0;
+         else {
+            ng_error("Option -Y expects on or off");
+            failure = 1;
+         }
+         break;
+      }
+   }
+
+   if (!failure && !global_opts->mpi) {
+      ng_error("Mode cma needs MPI to exchange pids and set up the control segments");
+      failure = 1;
+   }
+
+   /*  report success or failure */
+   return failure;
+}
+
+/* removes the completed head of a queue */
+static void cma_dequeue(struct ng_reqqueue *q) {
+   q->head->remaining_bytes = 0;
+   ng_reqqueue_pop(q);
+}
+
+/* the side that copies - the receiver in read mode, the sender in write mode */
+static int cma_copies(int type) {
+   return (type == TYPE_RECV) != module_data.write;
+}
+
+/**
+ * Puts the buffers of the queued requests into the channel to peer
+ * and completes the ones the peer has copied.
+ *
+ * @return 0 if the queue is empty
+ */
+static int cma_progress_adv(int peer, struct ng_reqqueue *q) {
+   struct cma_channel *ch = module_data.out[peer];
+   req_handle_t *nreq;
+   uint64_t head, tail;
+
+   tail = __atomic_load_n(&ch->tail, __ATOMIC_ACQUIRE);
+   while ((nreq = q->head) != NULL && nreq != module_data.adv[peer] &&
+          (int)((uint32_t)tail - nreq->seq) > 0) {
+      cma_dequeue(q);
+   }
+
+   head = ch->head;
+   while ((nreq = module_data.adv[peer]) != NULL && head - tail < CMA_SLOTS) {
+      ch->desc[head & (CMA_SLOTS - 1)].addr = (uintptr_t)nreq->buffer;
+      ch->desc[head & (CMA_SLOTS - 1)].len = nreq->size;
+      nreq->seq = (uint32_t)head++;
+      module_data.adv[peer] = nreq->next;
+   }
+   __atomic_store_n(&ch->head, head, __ATOMIC_RELEASE);
+
+   return q->head != NULL;
+}
+
+/**
+ * Copies between the queued requests and the buffers the peer put into
+ * its channel, in order. Receives take at most their size.
+ *
+ * @return 0 if the queue is empty, 1 if the peer has no buffer yet,
+ *         -1 if a copy failed (the request stays incomplete)
+ */
+static int cma_progress_copy(int peer, struct ng_reqqueue *q) {
+   struct cma_channel *ch = module_data.in[peer];
+   struct cma_desc *desc;
+   struct iovec local, remote;
+   req_handle_t *nreq;
+   uint64_t tail;
+   ssize_t n;
+   size_t len, done;
+
+   while ((nreq = q->head) != NULL) {
+      tail = ch->tail;
+      if (tail == __atomic_load_n(&ch->head, __ATOMIC_ACQUIRE)) return 1;
+      desc = &ch->desc[tail & (CMA_SLOTS - 1)];
+      len = ng_min((uint64_t)nreq->size, desc->len);
+
+      /* one call copies the whole message unless it hits a fault */
+      for (done = 0; done < len; done += n) {
+         local.iov_base = (char *)nreq->buffer + done;
+         local.iov_len = len - done;
+         remote.iov_base = (char *)(uintptr_t)desc->addr + done;
+         remote.iov_len = len - done;
+         if (module_data.write)
+            n = process_vm_writev(module_data.pids[peer], &local, 1, &remote, 1, 0);
+         else
+            n = process_vm_readv(module_data.pids[peer], &local, 1, &remote, 1, 0);
+         if (n < 0) {
+            ng_perror("Mode cma process_vm_%s of %lu bytes %s rank %d (pid %d) failed",
+                      module_data.write ? "writev" : "readv", (unsigned long)(len - done),
+                      module_data.write ? "to" : "from", peer, (int)module_data.pids[peer]);
+            return -1;
+         }
+         if (n == 0) {
+            ng_error("Mode cma process_vm_%s copied nothing of %lu bytes %s rank %d (pid %d)",
+                     module_data.write ? "writev" : "readv", (unsigned long)(len - done),
+                     module_data.write ? "to" : "from", peer, (int)module_data.pids[peer]);
+            return -1;
+         }
+      }
+
+      /* tells the peer that its buffer is free */
+      __atomic_store_n(&ch->tail, tail + 1, __ATOMIC_RELEASE);
+      cma_dequeue(q);
+   }
+   return 0;
+}
+
+static int cma_progress_queue(int peer, int type) {
+   struct ng_reqqueue *q;
+
+   q = type == TYPE_RECV ? &module_data.recvq[peer] : &module_data.sendq[peer];
+   if (cma_copies(type)) return cma_progress_copy(peer, q);
+   return cma_progress_adv(peer, q);
+}
+
+static int cma_post(int peer, int type, void *buffer, int size, NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = ng_reqpool_new(&module_data.reqpool, type, peer, buffer, size, req);
+   if (nreq == NULL) return -1;
+   /* empty messages are messages too */
+   if (size == 0) nreq->remaining_bytes = 1;
+   ng_reqqueue_push(type == TYPE_RECV ? &module_data.recvq[peer] : &module_data.sendq[peer], nreq);
+   if (module_data.adv[peer] == NULL && !cma_copies(type)) module_data.adv[peer] = nreq;
+   return cma_test(req);
+}
+
+static int cma_isendto(int dst, void *buffer, int size, NG_Request *req) {
+   return cma_post(dst, TYPE_SEND, buffer, size, req);
+}
+
+static int cma_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
+   return cma_post(src, TYPE_RECV, buffer, size, req);
+}
+
+/**
+ * Progresses all queues that have requests.
+ *
+ * @return number of queues that could not finish, -1 on a failed copy
+ */
+static int cma_progress(int timeout) {
+   int peer, ret, busy = 0;
+
+   for (peer = 0; peer < module_data.npeers; peer++) {
+      if (module_data.sendq[peer].head) {
+         if ((ret = cma_progress_queue(peer, TYPE_SEND)) < 0) return -1;
+         busy += ret;
+      }
+      if (module_data.recvq[peer].head) {
+         if ((ret = cma_progress_queue(peer, TYPE_RECV)) < 0) return -1;
+         busy += ret;
+      }
+   }
+   return busy;
+}
+
+static int cma_test(NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = (req_handle_t *)*req;
+   /* completed requests are back in the pool (like MPI_REQUEST_NULL) */
+   if (nreq == NULL)
+      return 0;
+
+   if (nreq->remaining_bytes > 0 && cma_progress_queue(nreq->index, nreq->type) < 0) return -1;
+   return ng_reqpool_release(&module_data.reqpool, req);
+}
+
+/* polls the channels until all requests are complete */
+static int cma_waitall(int count, NG_Request *reqs) {
+   return ng_reqpool_waitall(&module_data.reqpool, count, reqs, cma_progress, 0, module_data.yield);
+}
+
+static int cma_testany(int count, NG_Request *reqs, int *index) {
+   return ng_reqpool_testany(&module_data.reqpool, count, reqs, index, cma_progress);
+}
+
+static int cma_sendto(int dst, void *buffer, int size) {
+   NG_Request req;
+
+   if (cma_isendto(dst, buffer, size, &req) < 0) return -1;
+   if (cma_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+static int cma_recvfrom(int src, void *buffer, int size) {
+   NG_Request req;
+
+   if (cma_irecvfrom(src, buffer, size, &req) < 0) return -1;
+   if (cma_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+/**
+ * Exchanges the pids, maps one control segment per peer pair (like
+ * mode shm) and checks that every peer's memory can be read - Yama
+ * or a different uid forbid it.
+ */
+static int cma_init(struct ng_options *global_opts) {
+#ifdef NG_MPI
+   const int peer_count = g_options.mpi_opts->worldsize;
+   const int rank = g_options.mpi_opts->worldrank;
+   char name[64];
+   long job = getpid();
+   long pagesize = sysconf(_SC_PAGESIZE);
+   int i, fd, round, probe = rank, value;
+   uint64_t *addrs, myaddr = (uintptr_t)&probe;
+   struct iovec local, remote;
+   struct cma_channel *ch;
+   pid_t *ppids;
+#ifdef PR_SET_PTRACER
+   pid_t tracer;
+#endif
+
+   module_data.npeers = peer_count;
+   module_data.pids = calloc(peer_count, sizeof(pid_t));
+   ppids = calloc(peer_count, sizeof(pid_t));
+   addrs = calloc(peer_count, sizeof(uint64_t));
+   module_data.pids[rank] = getpid();
+   ppids[rank] = getppid();
+   MPI_Allgather(&module_data.pids[rank], sizeof(pid_t), MPI_BYTE, module_data.pids, sizeof(pid_t), MPI_BYTE, MPI_COMM_WORLD);
+   MPI_Allgather(&ppids[rank], sizeof(pid_t), MPI_BYTE, ppids, sizeof(pid_t), MPI_BYTE, MPI_COMM_WORLD);
+
+#ifdef PR_SET_PTRACER
+   /* the peers are no descendants of ours - Yama takes one ptracer and
+    * its descendants: the peer itself with two ranks, otherwise the
+    * launcher that started all of them */
+   tracer = peer_count == 2 ? module_data.pids[1 - rank] : ppids[rank];
+   for (i = 0; i < peer_count; i++) {
+      if (ppids[i] != ppids[rank] && peer_count > 2) tracer = 0;
+   }
+   if (tracer) prctl(PR_SET_PTRACER, (unsigned long)tracer, 0, 0, 0);
+   else ng_info(NG_VLEV1 | NG_VPALL, "Mode cma: the peers have different parents, no ptracer set");
+#endif
+   free(ppids);
+
+   /* all ptracers are set when this returns */
+   MPI_Allgather(&myaddr, 1, MPI_UINT64_T, addrs, 1, MPI_UINT64_T, MPI_COMM_WORLD);
+   MPI_Bcast(&job, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+   /* everybody reads the probe of everybody else */
+   for (i = 0; i < peer_count; i++) {
+      if (i == rank) continue;
+      local.iov_base = &value;
+      local.iov_len = sizeof(value);
+      remote.iov_base = (void *)(uintptr_t)addrs[i];
+      remote.iov_len = sizeof(value);
+      if (process_vm_readv(module_data.pids[i], &local, 1, &remote, 1, 0) != sizeof(value) || value != i) {
+         ng_perror("Mode cma cannot access the memory of rank %d (pid %d, see /proc/sys/kernel/yama/ptrace_scope)",
+                   i, (int)module_data.pids[i]);
+         free(addrs);
+         return 1;
+      }
+   }
+   /* keeps the probes alive until all are read */
+   MPI_Barrier(MPI_COMM_WORLD);
+   free(addrs);
+
+   module_data.seg_size = (2 * sizeof(struct cma_channel) + pagesize - 1) / pagesize * pagesize;
+   module_data.segs = calloc(peer_count, sizeof(void *));
+   module_data.out = calloc(peer_count, sizeof(struct cma_channel *));
+   module_data.in = calloc(peer_count, sizeof(struct cma_channel *));
+
+   /* round 0: the lower rank creates, round 1: the higher rank maps */
+   for (round = 0; round < 2; round++) {
+      for (i = 0; i < peer_count; i++) {
+         if (i == rank || (round == 0) != (rank < i)) continue;
+         snprintf(name, sizeof(name), "/netgauge-cma.%ld.%d.%d", job, ng_min(i, rank), rank < i ? i : rank);
+         if (round == 0) {
+            fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd >= 0 && ftruncate(fd, module_data.seg_size) < 0) {
+               close(fd);
+               fd = -1;
+            }
+         } else {
+            fd = shm_open(name, O_RDWR, 0);
+         }
+         if (fd < 0) {
+            ng_perror("Mode cma could not %s segment %s", round == 0 ? "create" : "open", name);
+            return 1;
+         }
+         module_data.segs[i] = mmap(NULL, module_data.seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         close(fd);
+         if (module_data.segs[i] == MAP_FAILED) {
+            module_data.segs[i] = NULL;
+            ng_perror("Mode cma could not map segment %s", name);
+            return 1;
+         }
+         ch = (struct cma_channel *)module_data.segs[i];
+         module_data.out[i] = rank < i ? &ch[0] : &ch[1];
+         module_data.in[i] = rank < i ? &ch[1] : &ch[0];
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+   }
+   for (i = rank + 1; i < peer_count; i++) {
+      snprintf(name, sizeof(name), "/netgauge-cma.%ld.%d.%d", job, rank, i);
+      shm_unlink(name);
+   }
+
+   module_data.sendq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   module_data.recvq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   module_data.adv = calloc(peer_count, sizeof(req_handle_t *));
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
+
+   if (module_data.yield < 0) module_data.yield = peer_count > sysconf(_SC_NPROCESSORS_ONLN);
+   ng_info(NG_VLEV1, "the %s copies with process_vm_%s()%s", module_data.write ? "sender" : "receiver",
+           module_data.write ? "writev" : "readv", module_data.yield ? ", yielding when idle" : "");
+   return 0;
+#else
+   return 1;
+#endif
+}
+
+/* module specific shutdown */
+static void cma_shutdown(struct ng_options *global_opts) {
+   int i;
+
+   if (module_data.segs) {
+      for (i = 0; i < module_data.npeers; i++) {
+         if (module_data.segs[i]) munmap(module_data.segs[i], module_data.seg_size);
+      }
+      free(module_data.segs);
+   }
+   ng_reqpool_destroy(&module_data.reqpool);
+   free(module_data.pids);
+   free(module_data.out);
+   free(module_data.in);
+   free(module_data.sendq);
+   free(module_data.recvq);
+   free(module_data.adv);
+}
+
+/* module specific manpage information */
+static void cma_writemanpage(void) {
+   int i;
+
+   for (i=0; long_options_cma[i].name != NULL; i++) {
+      ng_manpage_module(
+         long_options_cma[i].val,
+         long_options_cma[i].name,
+         long_option_infos_cma[i].desc,
+         long_option_infos_cma[i].param
+      );
+   }
+}
+
+/* module specific usage information */
+static void cma_usage(void) {
+   int i;
+
+   for (i=0; long_options_cma[i].name != NULL; i++) {
+      ng_longoption_usage(
+         long_options_cma[i].val,
+         long_options_cma[i].name,
+         long_option_infos_cma[i].desc,
+         long_option_infos_cma[i].param
+      );
+   }
+}
+
+
+/* module registration */
+int register_cma(void) {
+   ng_register_module(&cma_module);
+   return 0;
+}
+#else
+
+/* dummy module registration */
+int register_cma(void) {
+   return 0;
+}
+
+#endif
@@ -9,9 +9,11 @@
 
 
 #include "netgauge.h"
-#ifdef NG_MOD_EHT
+#ifdef NG_MOD_ETH
 
 #include "eth_helpers.h"
+#include "ng_reqpool.h"
+#include "ng_tstamp.h"
 
 #include <string.h>		/* memset & co. */
 #include <sys/socket.h>		/* socket operations */
@@ -26,9 +28,25 @@
 #include <linux/if_packet.h>	/* for socked statistics */
 #endif
 #include <sys/fcntl.h>
+#ifdef NG_HAVE_TSTAMP
+#include <linux/net_tstamp.h>
+#endif
 
 #define ETH_DEFAULT_ETHER_TYPE 0x8888
 
+#if defined(HAVE_LINUX_IF_PACKET_H) && defined(TPACKET3_HDRLEN)
+#define ETH_HAVE_MMAP 1
+#include <poll.h>
+#include <sys/mman.h>
+/* receive ring - the kernel hands over whole blocks */
+#define ETH_RX_BLOCK_SIZE (1 << 18)
+#define ETH_RX_BLOCKS 16
+/* transmit ring frames */
+#define ETH_TX_FRAMES 256
+/* payload offset in a TPACKET_V3 frame */
+#define ETH_TX_DATA TPACKET_ALIGN(sizeof(struct tpacket3_hdr))
+#endif
+
 /* module function prototypes */
 static int eth_getopt(int argc, char **argv, struct ng_options *global_opts);
 static int eth_init(struct ng_options *global_opts);
@@ -46,6 +64,7 @@ static int eth_irecvfrom(int src, void *buffer, int size, NG_Request *req);
 static int eth_test(NG_Request *req);
 static int eth_send_once(int dst, void *buffer, int size);
 static int eth_recv_once(int src, void *buffer, int size);
+static int eth_timestamps(int peer, struct ng_timestamps *ts);
 
 /* module registration data structure */
 static struct ng_module eth_module = {
@@ -64,7 +83,8 @@ static struct ng_module eth_module = {
    .recvfrom     = eth_recvfrom,
    .isendto      = eth_isendto,
    .irecvfrom    = eth_irecvfrom,
-	 .test         = eth_test
+	 .test         = eth_test,
+   .timestamps   = eth_timestamps
 };
 
 /**
@@ -75,6 +95,10 @@ static struct option long_options_eth[]={
 	{"protocol",				required_argument,	0, 'P'},
 	{"remoteaddr",			required_argument,	0, 'R'},
 	{"nonblocking",			required_argument,	0, 'N'},
+	{"mmap",					no_argument,			0, 'M'},
+	{"retire",				required_argument,	0, 'T'},
+	{"batch",					required_argument,	0, 'K'},
+	{"timestamping",			required_argument,	0, 'E'},
 	{0, 0, 0, 0}
 };
 
@@ -86,6 +110,10 @@ static struct option_info long_option_infos_eth[]={
 	{"ethernet frame protocol field value", "VALUE"},
 	{"ethernet (mac) address of the server (client mode only)", "PEER"},
 	{"nonblocking [s]end and/or [r]eceive mode", "[s][r]"},
+	{"use TPACKET_V3 rx and tx rings (PACKET_MMAP) instead of a syscall per frame", NULL},
+	{"ms until the kernel hands over a partly filled rx block (mmap mode, default: 1)", "MS"},
+	{"tx frames queued before the kernel is kicked (mmap mode, default: 32)", "FRAMES"},
+	{"collect [s]oft[w]are or [h]ard[w]are SO_TIMESTAMPING timestamps", "sw|hw"},
 };
 
 /* module private data */
@@ -102,9 +130,35 @@ static struct eth_private_data {
    struct sockaddr_ll          address; //For the socket (ll means "link level")
    struct ether_addr           local_addr, remote_addr; //remote_addr is for non MPI
    struct ether_addr					 *addresses; //addresses of all peers (indexed by rank)
-   const struct ng_mpi_options *mpi_opts;
+   /** our peer id (the rank, or client 0 and server 1 without MPI) and the number of peers */
+   int                         self, npeers;
 	 unsigned int                *rcvd_bytes;
 	 req_handle_t                **requests;
+   /** O_NONBLOCK state of the socket (fcntl only on changes) */
+   int                         nonblocking;
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool           reqpool;
+   /** PACKET_MMAP mode - rx ring first, tx ring behind it in one mapping */
+   int                         mmap;
+   int                         retire_tov;
+   unsigned int                tx_batch;
+   char                        *ring, *tx_ring;
+   size_t                      ring_size;
+   unsigned int                frame_size, tx_frame_nr;
+   /** next rx block and tx frame */
+   unsigned int                rx_block, tx_frame;
+   /** frames queued and frames handed to the kernel so far */
+   unsigned int                tx_queued, tx_kicked;
+   /** destination of the frames in the tx ring */
+   int                         tx_dst;
+   /** last sender found by eth_ring_src() */
+   int                         rx_last;
+   unsigned long               kicks, rx_blocks;
+   /** SO_TIMESTAMPING mode (-E) - the send timestamps are those of
+    * the socket, the receive timestamps those of each peer */
+   int                         tstamp;
+   struct ng_timestamps        ts_tx, *ts;
+   unsigned int                ts_sends;
 } module_data;
 
 
@@ -120,7 +174,7 @@ int register_eth(void) {
 static int eth_getopt(int argc, char **argv, struct ng_options *global_opts) {
    int c;
    
-   char *optchars = "I:P:R:N:";  // additional module options
+   char *optchars = "I:P:R:N:MT:K:E:";  // additional module options
    
    extern char *optarg;
    extern int optind, opterr, optopt;
@@ -131,6 +185,9 @@ static int eth_getopt(int argc, char **argv, struct ng_options *global_opts) {
 
    memset(&module_data, 0, sizeof(module_data));
    memset(&no_addr, 0, sizeof(no_addr));
+   module_data.retire_tov = 1;
+   module_data.tx_batch = 32;
+   module_data.tx_dst = -1;
 
 	/* parse module-options */
    while((c=getopt_long(argc, argv, optchars, long_options_eth, &option_index)) 
@@ -171,6 +228,38 @@ static int eth_getopt(int argc, char **argv, struct ng_options *global_opts) {
             ng_info(NG_VLEV2, "Using nonblocking receive mode");
          }
          break;
+      case 'M':	/* rx/tx rings */
+#ifdef ETH_HAVE_MMAP
+         module_data.mmap = 1;
+#else
+         ng_error("Option -M needs TPACKET_V3 (linux/if_packet.h)");
+         failure = 1;
+#endif
+         break;
+      case 'T':	/* rx block retire timeout */
+         module_data.retire_tov = atoi(optarg);
+         if (module_data.retire_tov < 1) {
+            ng_error("Option -T needs at least 1 ms");
+            failure = 1;
+         }
+         break;
+      case 'K':	/* tx kick batch */
+         if (atoi(optarg) < 1) {
+            ng_error("Option -K needs at least 1 frame");
+            failure = 1;
+         } else module_data.tx_batch = atoi(optarg);
+         break;
+      case 'E':	/* kernel timestamps */
+         module_data.tstamp = ng_tstamp_mode(optarg);
+         if (module_data.tstamp < 0) {
+            ng_error("Unknown timestamping mode %s (sw or hw)", optarg);
+            failure = 1;
+         }
+#ifndef NG_HAVE_TSTAMP
+         ng_error("SO_TIMESTAMPING is not supported on this system");
+         failure = 1;
+#endif
+         break;
       }
    }
 
@@ -198,7 +287,12 @@ static int eth_getopt(int argc, char **argv, struct ng_options *global_opts) {
 
 static int eth_set_blocking(int do_block, int partner)
 {
-   int flags = fcntl(module_data.sock, F_GETFL);
+   int flags;
+
+   /* all peers share one socket - nothing to do if it is in this state */
+   if (module_data.nonblocking == !do_block) return 1;
+
+   flags = fcntl(module_data.sock, F_GETFL);
    if (flags < 0) {
       ng_perror("Could not get flags");
       return 0;
@@ -216,22 +310,331 @@ static int eth_set_blocking(int do_block, int partner)
          return 0;
       }
    }
+   module_data.nonblocking = !do_block;
    return 1;
 }
 
+/* reads the send timestamps every NG_TSTAMP_REAP frames so that the
+ * error queue doesn't eat the receive buffer */
+static inline void eth_tstamp_sent(void) {
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp && ++module_data.ts_sends % NG_TSTAMP_REAP == 0)
+      ng_tstamp_reap(module_data.sock, &module_data.ts_tx);
+#endif
+}
+
+/* a server without MPI learns the client's address from its first
+ * frame, @return 1 if it did */
+static inline int eth_learn_client(const struct sockaddr_ll *sll) {
+   static const struct ether_addr no_addr;
+
+   if (g_options.mpi || !g_options.server || memcmp(&module_data.addresses[0], &no_addr, ETH_ALEN))
+      return 0;
+   memcpy(&module_data.addresses[0], sll->sll_addr, ETH_ALEN);
+   ng_info(NG_VLEV1, "Client has ethernet address %s", ether_ntoa(&module_data.addresses[0]));
+   return 1;
+}
+
+/* recvfrom() that keeps the receive timestamp of the sender (the
+ * first byte of the frame) if timestamping is on */
+static inline int eth_recv(void *buffer, int size, struct sockaddr_ll *client) {
+   socklen_t addrlen = sizeof(*client);
+   int rcvd;
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp) {
+      char control[256];
+      struct iovec iov = { buffer, size };
+      struct msghdr msg;
+      int src;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = client;
+      msg.msg_namelen = addrlen;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      rcvd = recvmsg(module_data.sock, &msg, module_data.recv_flags);
+      src = *((unsigned char *)buffer);
+      if (rcvd > 0) eth_learn_client(client);
+      if (rcvd > 0 && src < module_data.npeers)
+         ng_tstamp_rx(&msg, &module_data.ts[src]);
+      return rcvd;
+   }
+#endif
+   rcvd = recvfrom(module_data.sock, buffer, size, module_data.recv_flags,
+                   (struct sockaddr *)client, &addrlen);
+   if (rcvd > 0) eth_learn_client(client);
+   return rcvd;
+}
+
+#ifdef ETH_HAVE_MMAP
+/* switches the socket to TPACKET_V3 and maps an rx and a tx ring */
+static int eth_ring_setup(void) {
+   struct tpacket_req3 req;
+   int version = TPACKET_V3;
+   long pagesize = sysconf(_SC_PAGESIZE);
+   size_t rx_size;
+
+   // a frame holds the tpacket header and one mtu of payload
+   module_data.frame_size = TPACKET_ALIGNMENT;
+   while (module_data.frame_size < TPACKET3_HDRLEN + sizeof(struct ethhdr) + module_data.mtu)
+      module_data.frame_size <<= 1;
+
+   if (setsockopt(module_data.sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+      ng_perror("Mode %s could not switch the socket to TPACKET_V3", eth_module.name);
+      return 1;
+   }
+
+   memset(&req, 0, sizeof(req));
+   req.tp_block_size = ETH_RX_BLOCK_SIZE;
+   req.tp_block_nr = ETH_RX_BLOCKS;
+   req.tp_frame_size = module_data.frame_size;
+   req.tp_frame_nr = ETH_RX_BLOCK_SIZE / module_data.frame_size * ETH_RX_BLOCKS;
+   req.tp_retire_blk_tov = module_data.retire_tov;
+   if (setsockopt(module_data.sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+      ng_perror("Mode %s could not set up the rx ring", eth_module.name);
+      return 1;
+   }
+   rx_size = (size_t)req.tp_block_size * req.tp_block_nr;
+
+   // tx frames are used one by one, the kernel wants no timeout here
+   memset(&req, 0, sizeof(req));
+   req.tp_block_size = ng_max((long)module_data.frame_size, pagesize);
+   req.tp_frame_size = module_data.frame_size;
+   req.tp_block_nr = ETH_TX_FRAMES * module_data.frame_size / req.tp_block_size;
+   req.tp_frame_nr = req.tp_block_size / module_data.frame_size * req.tp_block_nr;
+   if (setsockopt(module_data.sock, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+      ng_perror("Mode %s could not set up the tx ring", eth_module.name);
+      return 1;
+   }
+   module_data.tx_frame_nr = req.tp_frame_nr;
+
+   module_data.ring_size = rx_size + (size_t)req.tp_block_size * req.tp_block_nr;
+   module_data.ring = mmap(NULL, module_data.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, module_data.sock, 0);
+   if (module_data.ring == MAP_FAILED) {
+      module_data.ring = NULL;
+      ng_perror("Mode %s could not map the rings", eth_module.name);
+      return 1;
+   }
+   module_data.tx_ring = module_data.ring + rx_size;
+   ng_info(NG_VLEV1, "Mapped TPACKET_V3 rings: %d rx blocks of %d bytes, %u tx frames of %u bytes",
+           ETH_RX_BLOCKS, ETH_RX_BLOCK_SIZE, module_data.tx_frame_nr, module_data.frame_size);
+   return 0;
+}
+
+/* hands all queued tx frames to the kernel with one sendto(), waits
+ * for the ring to drain if wait is set */
+static void eth_ring_kick(int wait) {
+   if (module_data.tx_dst < 0 || (module_data.tx_kicked == module_data.tx_queued && !wait))
+      return;
+
+   memcpy(module_data.address.sll_addr, &module_data.addresses[module_data.tx_dst], sizeof(struct ether_addr));
+   if (sendto(module_data.sock, NULL, 0, wait ? 0 : MSG_DONTWAIT,
+              (struct sockaddr *)&module_data.address, sizeof(struct sockaddr_ll)) < 0 &&
+       errno != EAGAIN && errno != ENOBUFS)
+      ng_perror("Mode %s could not kick the tx ring", eth_module.name);
+   module_data.tx_kicked = module_data.tx_queued;
+   module_data.kicks++;
+   eth_tstamp_sent();
+}
+
+/* copies up to size bytes into free tx frames, returns the bytes queued */
+static int eth_ring_queue(int dst, char *buffer, int size) {
+   struct tpacket3_hdr *hdr;
+   unsigned int status;
+   int n, queued = 0;
+
+   // the kick address applies to the whole ring
+   if (module_data.tx_dst != dst) {
+      eth_ring_kick(1);
+      module_data.tx_dst = dst;
+   }
+
+   while (queued < size) {
+      hdr = (struct tpacket3_hdr *)(module_data.tx_ring + (size_t)module_data.tx_frame * module_data.frame_size);
+      status = __atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE);
+      if (status != TP_STATUS_AVAILABLE) {
+         if (status == TP_STATUS_WRONG_FORMAT) {
+            ng_error("Mode %s: the kernel rejected a %u byte frame", eth_module.name, hdr->tp_len);
+            return -1;
+         }
+         // ring full - let the kernel drain it
+         eth_ring_kick(0);
+         break;
+      }
+      n = ng_min(size - queued, module_data.mtu);
+      memcpy((char *)hdr + ETH_TX_DATA, buffer + queued, n);
+      hdr->tp_len = n;
+      hdr->tp_next_offset = 0;
+      __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+      module_data.tx_frame = (module_data.tx_frame + 1) % module_data.tx_frame_nr;
+      module_data.tx_queued++;
+      queued += n;
+      if (module_data.tx_queued - module_data.tx_kicked >= module_data.tx_batch)
+         eth_ring_kick(0);
+   }
+   return queued;
+}
+
+/* the rank with the source address of a received frame */
+static int eth_ring_src(struct sockaddr_ll *sll) {
+   int i;
+
+   if (!memcmp(sll->sll_addr, &module_data.addresses[module_data.rx_last], ETH_ALEN))
+      return module_data.rx_last;
+   for (i = 0; i < module_data.npeers; i++) {
+      if (!memcmp(sll->sll_addr, &module_data.addresses[i], ETH_ALEN))
+         return module_data.rx_last = i;
+   }
+   if (eth_learn_client(sll)) return module_data.rx_last = 0;
+   return -1;
+}
+
+/* walks the blocks the kernel handed over - frames go to the posted
+ * receive of their sender, or are counted for later like in eth_recvfrom() */
+static int eth_ring_poll(void) {
+   struct tpacket_block_desc *block;
+   struct tpacket3_hdr *hdr;
+   req_handle_t *nreq;
+   unsigned int i, frames = 0;
+   int src, n;
+
+   while (1) {
+      block = (struct tpacket_block_desc *)(module_data.ring + (size_t)module_data.rx_block * ETH_RX_BLOCK_SIZE);
+      if (!(__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER))
+         break;
+
+      hdr = (struct tpacket3_hdr *)((char *)block + block->hdr.bh1.offset_to_first_pkt);
+      for (i = 0; i < block->hdr.bh1.num_pkts; i++) {
+         src = eth_ring_src((struct sockaddr_ll *)((char *)hdr + ETH_TX_DATA));
+#ifdef NG_HAVE_TSTAMP
+         /* the ring has room for one stamp - the NIC's if PACKET_TIMESTAMP asked for it */
+         if (src >= 0 && module_data.ts && (hdr->tp_status & (TP_STATUS_TS_SOFTWARE | TP_STATUS_TS_RAW_HARDWARE))) {
+            unsigned long long t = (unsigned long long)hdr->tp_sec * 1000000000ULL + hdr->tp_nsec;
+            if (hdr->tp_status & TP_STATUS_TS_RAW_HARDWARE) module_data.ts[src].hw_rx = t;
+            else module_data.ts[src].sw_rx = t;
+         }
+#endif
+         if (src >= 0) {
+            nreq = module_data.requests[src];
+            if (nreq && nreq->remaining_bytes > 0) {
+               n = ng_min((int)hdr->tp_snaplen, nreq->remaining_bytes);
+               memcpy((char *)nreq->buffer + nreq->size - nreq->remaining_bytes, (char *)hdr + hdr->tp_mac, n);
+               nreq->remaining_bytes -= n;
+            } else {
+               module_data.rcvd_bytes[src] += hdr->tp_snaplen;
+            }
+         }
+         hdr = (struct tpacket3_hdr *)((char *)hdr + hdr->tp_next_offset);
+      }
+      frames += block->hdr.bh1.num_pkts;
+
+      __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+      module_data.rx_block = (module_data.rx_block + 1) % ETH_RX_BLOCKS;
+      module_data.rx_blocks++;
+   }
+   return frames;
+}
+
+/* receives counted earlier go to the new receive first */
+static void eth_ring_post(int src, req_handle_t *rreq) {
+   int n = ng_min(module_data.rcvd_bytes[src], (unsigned int)rreq->remaining_bytes);
+
+   module_data.rcvd_bytes[src] -= n;
+   rreq->remaining_bytes -= n;
+   module_data.requests[src] = rreq;
+}
+
+static int eth_ring_sendto(int dst, char *buffer, int size) {
+   struct pollfd pfd = { module_data.sock, POLLOUT, 0 };
+   int sent = 0, ret;
+
+   while (sent < size) {
+      ret = eth_ring_queue(dst, buffer + sent, size - sent);
+      if (ret < 0) return 1;
+      if (ret == 0) {
+         if (g_stop_tests) {
+            ng_error("sendto() interrupted at %d bytes", sent);
+            return 1;
+         }
+         // the timeout catches frames the kernel could not send yet
+         poll(&pfd, 1, 1);
+      }
+      sent += ret;
+   }
+   eth_ring_kick(0);
+   return sent;
+}
+
+static int eth_ring_recvfrom(int src, void *buffer, int size) {
+   struct pollfd pfd = { module_data.sock, POLLIN, 0 };
+   req_handle_t rreq;
+
+   memset(&rreq, 0, sizeof(rreq));
+   rreq.buffer = buffer;
+   rreq.size = size;
+   rreq.remaining_bytes = size;
+   eth_ring_post(src, &rreq);
+   // nobody may wait for our frames while we wait
+   eth_ring_kick(0);
+
+   while (rreq.remaining_bytes > 0) {
+      if (eth_ring_poll() > 0) continue;
+      if (g_stop_tests) {
+         ng_error("recvfrom() interrupted at %d bytes", size - rreq.remaining_bytes);
+         module_data.requests[src] = NULL;
+         return 1;
+      }
+      if (!(module_data.recv_flags & MSG_DONTWAIT)) poll(&pfd, 1, 10);
+   }
+   module_data.requests[src] = NULL;
+   return size;
+}
+
+/* eth_test() in mmap mode - sends are done once their frames are
+ * with the kernel, receives are filled by eth_ring_poll() */
+static int eth_ring_test(req_handle_t *nreq) {
+   int ret;
+
+   if (nreq->type == TYPE_RECV) {
+      if (nreq->remaining_bytes > 0) {
+         eth_ring_kick(0);
+         eth_ring_poll();
+      }
+      return nreq->remaining_bytes;
+   }
+
+   if (nreq->remaining_bytes > 0) {
+      ret = eth_ring_queue(nreq->index, (char *)nreq->buffer + nreq->size - nreq->remaining_bytes,
+                           nreq->remaining_bytes);
+      if (ret < 0) return ret;
+      nreq->remaining_bytes -= ret;
+      nreq->seq = module_data.tx_queued;
+      if (nreq->remaining_bytes > 0) return nreq->remaining_bytes;
+   }
+   if ((int)(nreq->seq - module_data.tx_kicked) > 0)
+      eth_ring_kick(0);
+   return 0;
+}
+#endif
+
 /* module specific benchmark initialization */
 static int eth_init(struct ng_options *global_opts) {
-#ifdef NG_MPI
    struct ifreq if_data;
    socklen_t optlen;
    int optval;
-	 const int peer_count = g_options.mpi_opts->worldsize;
-	 module_data.mpi_opts = g_options.mpi_opts;
+   /* without MPI the client is peer 0 and the server peer 1 */
+	 const int peer_count = g_options.mpi ? g_options.mpi_opts->worldsize : 2;
+	 module_data.npeers = peer_count;
+	 module_data.self = g_options.mpi ? g_options.mpi_opts->worldrank : (g_options.server ? 1 : 0);
 
 	 module_data.addresses   = calloc(peer_count, sizeof(struct ether_addr));
 	 module_data.rcvd_bytes  = calloc(peer_count, sizeof(unsigned int));
 	 module_data.requests = calloc(peer_count, sizeof(req_handle_t*));
 	 memset(module_data.requests, 0, sizeof(req_handle_t*)*peer_count);
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
 		
    // initialize network socket
    ng_info(NG_VLEV2, "Initializing network socket");
@@ -241,11 +644,19 @@ static int eth_init(struct ng_options *global_opts) {
       return 1;
    }
 
-   // set maximum possible read/write memory
-   optval = global_opts->max_datasize;
-   setsockopt(module_data.sock, SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval));
-   setsockopt(module_data.sock, SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval));
+   // set maximum possible read/write memory - but don't shrink the
+   // defaults, a window of small frames needs more than one message
    optlen = sizeof(int);
+   if (getsockopt(module_data.sock, SOL_SOCKET, SO_RCVBUF, &optval, &optlen) == 0 &&
+       optval < global_opts->max_datasize) {
+      optval = global_opts->max_datasize;
+      setsockopt(module_data.sock, SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval));
+   }
+   if (getsockopt(module_data.sock, SOL_SOCKET, SO_SNDBUF, &optval, &optlen) == 0 &&
+       optval < global_opts->max_datasize) {
+      optval = global_opts->max_datasize;
+      setsockopt(module_data.sock, SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval));
+   }
    if (getsockopt(module_data.sock, SOL_SOCKET, SO_RCVBUF, &module_data.recv_buf, &optlen) < 0 ||
        getsockopt(module_data.sock, SOL_SOCKET, SO_SNDBUF, &module_data.send_buf, &optlen) < 0) {
       ng_perror("Mode %s could not determine the socket's send or receive buffer size",
@@ -279,6 +690,26 @@ static int eth_init(struct ng_options *global_opts) {
       ng_info(NG_VLEV1 | NG_VPALL, "Determined local interface %s MTU %d", if_data.ifr_name, module_data.mtu);
    }
 
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap && eth_ring_setup())
+      return 1;
+#endif
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp) {
+      module_data.ts = calloc(peer_count, sizeof(struct ng_timestamps));
+      if (ng_tstamp_enable(module_data.sock, module_data.tstamp,
+                           module_data.tstamp == NG_TSTAMP_HW ? module_data.interface : NULL))
+         return 1;
+#ifdef ETH_HAVE_MMAP
+      if (module_data.mmap && module_data.tstamp == NG_TSTAMP_HW) {
+         int req = SOF_TIMESTAMPING_RAW_HARDWARE;
+         setsockopt(module_data.sock, SOL_PACKET, PACKET_TIMESTAMP, &req, sizeof(req));
+      }
+#endif
+      ng_info(NG_VLEV1, "Collecting %s timestamps", module_data.tstamp == NG_TSTAMP_HW ? "hardware" : "software");
+   }
+#endif
+
    // bind socket to local interface
    ng_info(NG_VLEV1, "Binding network socket to interface %s", module_data.interface);
    memset(&module_data.address, 0, sizeof(module_data.address));
@@ -290,6 +721,8 @@ static int eth_init(struct ng_options *global_opts) {
       ng_perror("Mode %s could not bind socket to local interface %s", eth_module.name, module_data.interface);
       return 1;
    }
+   if (g_options.mpi) {
+#ifdef NG_MPI
 	 //copy address of peer i to position i in module_data.addresses	
    if (MPI_Allgather(&module_data.local_addr, sizeof(struct ether_addr), MPI_CHAR,
                      module_data.addresses, sizeof(struct ether_addr), MPI_CHAR,
@@ -298,72 +731,120 @@ static int eth_init(struct ng_options *global_opts) {
       exit(1);
    }
 	 MPI_Barrier(MPI_COMM_WORLD);
-   ng_info(NG_VLEV1, "Peer connections established.");
-#else
-	 ng_error("This module does not work without MPI yet.");
 #endif
+   } else {
+      /* the server may leave -R out, see eth_learn_client() */
+      module_data.addresses[module_data.self] = module_data.local_addr;
+      module_data.addresses[1 - module_data.self] = module_data.remote_addr;
+   }
+   ng_info(NG_VLEV1, "Peer connections established.");
    // report success
    return 0;
 }
 
+/* returns and clears the timestamps of peer - the send timestamps are
+ * those of the last frame sent to anybody */
+static int eth_timestamps(int peer, struct ng_timestamps *ts) {
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.ts == NULL) return 1;
+   if (ng_tstamp_reap(module_data.sock, &module_data.ts_tx) < 0) return 1;
+   *ts = module_data.ts[peer];
+   ts->sched = module_data.ts_tx.sched;
+   ts->sw_tx = module_data.ts_tx.sw_tx;
+   ts->hw_tx = module_data.ts_tx.hw_tx;
+   memset(&module_data.ts[peer], 0, sizeof(struct ng_timestamps));
+   memset(&module_data.ts_tx, 0, sizeof(struct ng_timestamps));
+   return 0;
+#else
+   return 1;
+#endif
+}
+
 static int eth_isendto(int dst, void *buffer, int size, NG_Request *req) {
    req_handle_t *sreq;
    //init sending
-   sreq = malloc(sizeof(req_handle_t));
-	 memset(sreq, 0, sizeof(req_handle_t));
+   sreq = ng_reqpool_get(&module_data.reqpool);
+   if (sreq == NULL) return -1;
    sreq->type = TYPE_SEND;
    sreq->index = dst;
    sreq->buffer = buffer;
    sreq->size = size;
    sreq->remaining_bytes = size;
    *req = (NG_Request *) sreq;
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap) {
+      // only queue the frames, eth_test() kicks the kernel
+      int ret = eth_ring_queue(dst, buffer, size);
+      if (ret < 0) return ret;
+      sreq->remaining_bytes -= ret;
+      sreq->seq = module_data.tx_queued;
+      return ret;
+   }
+#endif
    eth_set_blocking(0, dst);    //non-blocking
-   eth_test(req);
-	 return size-sreq->remaining_bytes;
+   if (eth_test(req) == 0) return size;
+   return size-sreq->remaining_bytes;
 }
 
 static int eth_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
    req_handle_t *rreq;
 //init receiving
-   rreq = malloc(sizeof(req_handle_t));
-	 memset(rreq, 0, sizeof(req_handle_t));
+   rreq = ng_reqpool_get(&module_data.reqpool);
+   if (rreq == NULL) return -1;
    rreq->type = TYPE_RECV;
    rreq->index = src;
    rreq->buffer = buffer;
    rreq->size = size;
    rreq->remaining_bytes = size;
    *req = (NG_Request *) rreq;
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap) {
+      eth_ring_post(src, rreq);
+      return 0;
+   }
+#endif
    eth_set_blocking(0, src);    //non-blocking
 	 module_data.requests[src] = rreq;
    return 0;
 }
 
 int eth_test(NG_Request *req) {
-	 req_handle_t *nreq;
+   req_handle_t *nreq;
    int ret=0;
 //do the rest
    nreq = (req_handle_t *)*req;
-   if (nreq->remaining_bytes <= 0)
+   // completed requests are back in the pool (like MPI_REQUEST_NULL)
+   if (nreq == NULL)
       return 0;
 
-   if (get_req_type(req) == TYPE_RECV) {
-      ret = eth_recv_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { //was busy or data from unexpected host
-         return 1; //in progress
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap) {
+      ret = eth_ring_test(nreq);
+      if (ret != 0) return ret;
+   } else
+#endif
+   if (nreq->remaining_bytes > 0) {
+      if (get_req_type(req) == TYPE_RECV) {
+         ret = eth_recv_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
+      } else {
+         ret = eth_send_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
       }
-   } else {
-      ret = eth_send_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { //was busy
+      if (ret == -EAGAIN) { //was busy
          return 1; //in progress
+      } else if (ret < 0) {
+         return ret;
       }
+      nreq->remaining_bytes -= ret;
+      if (nreq->remaining_bytes > 0)
+         return nreq->remaining_bytes;
    }
-   return ret;
+
+   // done - release the request
+   if (module_data.requests[nreq->index] == nreq)
+      module_data.requests[nreq->index] = NULL;
+   ng_reqpool_put(&module_data.reqpool, nreq);
+   *req = NULL;
+   return 0;
 }
 
 static int eth_send_once(int dst, void *buffer, int size)
@@ -375,7 +856,7 @@ static int eth_send_once(int dst, void *buffer, int size)
    /* the first byte of the packet is the source-rank - we use this to
     * not add additional overhead to the protocol to have the measurement
     * as accurate as possible */
-   *((char *)buffer) = (char)g_options.mpi_opts->worldrank;
+   *((char *)buffer) = (char)module_data.self;
    errno = 0;
    // send at most one mtu of data
    sent = sendto(module_data.sock,
@@ -395,6 +876,7 @@ static int eth_send_once(int dst, void *buffer, int size)
       ng_perror("Mode eth send_once failed");
       return -1;
    }
+   eth_tstamp_sent();
    return sent;
 }
 
@@ -402,17 +884,11 @@ static int eth_recv_once(int src, void *buffer, int size)
 {
    char               *bufptr  = buffer;
    struct sockaddr_ll client;
-   socklen_t          addrlen  = sizeof(client);
    int                rcvd     = 0;
 
    errno = 0;
    // receive any outstanding data
-   rcvd = recvfrom(module_data.sock,
-                   (void *)bufptr,
-                   ng_min(size, module_data.mtu),
-                   module_data.recv_flags,
-                   (struct sockaddr *)&client,
-                   &addrlen);
+   rcvd = eth_recv(bufptr, ng_min(size, module_data.mtu), &client);
    if (rcvd < 0) {
       if (errno == EAGAIN)
          return -EAGAIN;
@@ -440,11 +916,16 @@ static int eth_sendto(int dst, void *buffer, int size) {
    ssize_t      sent       = 0;
    unsigned int sent_total = 0;
 
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap)
+      return eth_ring_sendto(dst, buffer, size);
+#endif
+
    memcpy(module_data.address.sll_addr, &module_data.addresses[dst], sizeof(struct ether_addr));
   /* the first byte of the packet is the source-rank - we use this to
    * not add additional overhead to the protocol to have the measurement
    * as accurate as possible */
-   bufptr[0] = (char)g_options.mpi_opts->worldrank;
+   bufptr[0] = (char)module_data.self;
 
    while (sent_total < size) {
 			errno = 0;   
@@ -455,7 +936,7 @@ static int eth_sendto(int dst, void *buffer, int size) {
                     (struct sockaddr *)&module_data.address, sizeof(struct sockaddr_ll));
       if (sent <= 0) {
          // CTRL-C
-         if (stop_tests || errno == EINTR) {
+         if (g_stop_tests || errno == EINTR) {
             ng_error("sendto() interrupted at %d bytes", sent_total);
 						return 1;
          }
@@ -470,6 +951,7 @@ static int eth_sendto(int dst, void *buffer, int size) {
          ng_perror("Mode %s sendto failed", eth_module.name);
 				 return 1;
       }
+      eth_tstamp_sent();
       // continue sending while there is data left
       sent_total += sent;
       bufptr     += sent;
@@ -484,9 +966,12 @@ static int eth_recvfrom(int src, void *buffer, int size)
 	 char         *bufptr    = buffer;
    int          rcvd       = 0;
    unsigned int rcvd_total = 0;
-	 struct sockaddr client;
-	 unsigned int addrlen   = sizeof(client);
-   
+	 struct sockaddr_ll client;
+
+#ifdef ETH_HAVE_MMAP
+   if (module_data.mmap)
+      return eth_ring_recvfrom(src, buffer, size);
+#endif
   /* look if we already have something */
   rcvd_total = module_data.rcvd_bytes[src];
   module_data.rcvd_bytes[src] = 0;
@@ -495,13 +980,10 @@ static int eth_recvfrom(int src, void *buffer, int size)
    while (rcvd_total < size) {
 			errno = 0;
       // receive any outstanding data
-      rcvd = recvfrom(module_data.sock,
-                      bufptr,
-                      size - rcvd_total,
-                      module_data.recv_flags, (struct sockaddr *)&client, &addrlen);
+      rcvd = eth_recv(bufptr, size - rcvd_total, &client);
       if (rcvd <= 0) {
          // CTRL-C
-         if (stop_tests || errno == EINTR) {
+         if (g_stop_tests || errno == EINTR) {
             ng_error("recvfrom() interrupted at %d bytes", rcvd_total);
             return 1;
          }
@@ -540,10 +1022,19 @@ void eth_shutdown(struct ng_options *global_opts) {
                  st.tp_packets, st.tp_drops);
       }
 
+#ifdef ETH_HAVE_MMAP
+      if (module_data.ring) {
+         ng_info(NG_VLEV1 | NG_VPALL, "%u frames sent with %lu kicks, %lu rx blocks",
+                 module_data.tx_queued, module_data.kicks, module_data.rx_blocks);
+         munmap(module_data.ring, module_data.ring_size);
+      }
+#endif
       ng_info(NG_VLEV1, "Closing network socket");
       if (close(module_data.sock) < 0)
          ng_perror("Failed to close network socket");
    }
+   ng_reqpool_destroy(&module_data.reqpool);
+   free(module_data.ts);
 }
 
 
@@ -0,0 +1,505 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+
+#include "netgauge.h"
+#ifdef NG_MOD_SHM
+
+#include "ng_reqpool.h"
+#include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <getopt.h> /* getopt long */
+
+/* slots of the small message ring (power of two) */
+#define SHM_SLOTS 128
+/* bytes per slot including the 8 byte header */
+#define SHM_SLOT_SIZE 1024
+/* largest message that goes through the ring */
+#define SHM_EAGER (SHM_SLOT_SIZE - 8)
+/* size of each of the two large message buffers */
+#define SHM_BIG_SIZE 65536
+#define SHM_CACHELINE 64
+
+/* extern stuff */
+extern struct ng_options g_options;
+
+/* function prototypes */
+static int shm_sendto(int dst, void *buffer, int size);
+static int shm_recvfrom(int src, void *buffer, int size);
+static int shm_init(struct ng_options *global_opts);
+static int shm_getopt(int argc, char **argv, struct ng_options *global_opts);
+static void shm_writemanpage(void);
+static void shm_usage(void);
+static void shm_shutdown(struct ng_options *global_opts);
+static int shm_isendto(int dst, void *buffer, int size, NG_Request *req);
+static int shm_irecvfrom(int src, void *buffer, int size, NG_Request *req);
+static int shm_test(NG_Request *req);
+static int shm_waitall(int count, NG_Request *reqs);
+static int shm_testany(int count, NG_Request *reqs, int *index);
+static int shm_progress(int timeout);
+
+/* module registration data structure (shared memory) */
+struct ng_module shm_module = {
+   .name         = "shm",
+   .desc         = "Mode shm uses shared memory rings between ranks on the same host.",
+   .flags        = NG_MOD_RELIABLE | NG_MOD_CHANNEL,
+   .max_datasize = -1,        /*  can send data of arbitrary size */
+   .headerlen    = 0,         /*  no extra space needed for header */
+   .malloc       = NULL,
+   .getopt       = shm_getopt,
+   .init         = shm_init,
+   .shutdown     = shm_shutdown,
+   .usage        = shm_usage,
+   .writemanpage = shm_writemanpage,
+   .sendto         = shm_sendto,
+   .recvfrom       = shm_recvfrom,
+   .isendto        = shm_isendto,
+   .irecvfrom      = shm_irecvfrom,
+   .test           = shm_test,
+   .waitall        = shm_waitall,
+   .testany        = shm_testany,
+   .progress       = shm_progress,
+};
+
+/**
+ * getopt long options for shm
+ */
+static struct option long_options_shm[]={
+   {"yield", required_argument, 0, 'Y'},
+   {0, 0, 0, 0}
+};
+
+/**
+ * array of descriptions for shm
+ */
+static struct option_info long_option_infos_shm[]={
+   {"sched_yield() while waiting (default: if there are more ranks than cores)", "on|off"},
+   {0, 0}
+};
+
+/* a message in the ring - large messages only have the header here,
+ * their data follows through the two large message buffers */
+struct shm_slot {
+   uint32_t len;
+   uint32_t large;
+   char data[SHM_EAGER];
+};
+
+/* one of the two large message buffers - the producer fills one while
+ * the consumer drains the other */
+struct shm_big {
+   uint32_t full __attribute__((aligned(SHM_CACHELINE)));
+   uint32_t len;
+   char data[SHM_BIG_SIZE] __attribute__((aligned(SHM_CACHELINE)));
+};
+
+/* one direction of a peer pair - head and tail live in their own
+ * cache lines, each is written by one side only */
+struct shm_channel {
+   uint64_t head __attribute__((aligned(SHM_CACHELINE)));
+   uint64_t tail __attribute__((aligned(SHM_CACHELINE)));
+   struct shm_slot slots[SHM_SLOTS] __attribute__((aligned(SHM_CACHELINE)));
+   struct shm_big big[2];
+};
+
+/* module private data */
+struct shm_private_data {
+   /** sched_yield() when idle, -1 decides at init */
+   int yield;
+   int npeers;
+   /** the segment of each peer pair and my two channels in it */
+   void **segs;
+   size_t seg_size;
+   struct shm_channel **out, **in;
+   /** producer copy of the consumer tail (saves a cache miss per send) */
+   uint64_t *cached_tail;
+   /** next large message buffer of each channel */
+   char *send_big, *recv_big;
+   /** the descriptor of the head send is in the ring */
+   char *send_started;
+   /** bytes of the large message being received */
+   int *recv_left;
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool reqpool;
+   struct ng_reqqueue *sendq, *recvq;
+};
+
+static struct shm_private_data module_data;
+
+
+/* parse command line parameters for module-specific options */
+static int shm_getopt(int argc, char **argv, struct ng_options *global_opts) {
+   int c;
+
+   char *optchars = "Y:";  /*  additional module options */
+
+   extern char *optarg;
+   int option_index = 0;
+   extern int optind, opterr, optopt;
+
+   int failure = 0;
+
+   /*  initialize module private information data structure */
+   memset(&module_data, 0, sizeof(module_data));
+   module_data.yield = -1;
+
+   /*  parse module-options */
+   while((c=getopt_long(argc, argv, optchars, long_options_shm, &option_index))
+         >= 0 ) {
+      switch( c ) {
+      case '?':  /* unrecognized or badly used option */
+         if (!strchr(optchars, optopt))
+            continue;  /* unrecognized */
+         ng_error("Option %c requires an argument", optopt);
+         failure = 1;
+         break;
+      case 'Y':  /* yield when idle */
+         if (strcmp(optarg, "on") == 0) module_data.yield = 1;
+         else if (strcmp(optarg, "off") == 0) module_data.yield = 0;
+         else {
+            ng_error("Option -Y expects on or off");
+            failure = 1;
+         }
+         break;
+      }
+   }
+
+   if (!failure && !global_opts->mpi) {
+      ng_error("Mode shm needs MPI to set up the shared segments");
+      failure = 1;
+   }
+
+   /*  report success or failure */
+   return failure;
+}
+
+/**
+ * Moves the sends to peer into the channel in order: small messages
+ * into a ring slot, large ones as a descriptor followed by chunks
+ * through the two large message buffers.
+ *
+ * @return 0 if the queue is empty, 1 if the channel is full
+ */
+static int shm_progress_send(int peer) {
+   struct ng_reqqueue *q = &module_data.sendq[peer];
+   struct shm_channel *ch = module_data.out[peer];
+   struct shm_slot *slot;
+   struct shm_big *big;
+   req_handle_t *nreq;
+   uint64_t head;
+   int n;
+
+   while ((nreq = q->head) != NULL) {
+      if (!module_data.send_started[peer]) {
+         head = ch->head;
+         if (head - module_data.cached_tail[peer] >= SHM_SLOTS) {
+            module_data.cached_tail[peer] = __atomic_load_n(&ch->tail, __ATOMIC_ACQUIRE);
+            if (head - module_data.cached_tail[peer] >= SHM_SLOTS) return 1;
+         }
+         slot = &ch->slots[head & (SHM_SLOTS - 1)];
+         slot->len = nreq->size;
+         slot->large = nreq->size > SHM_EAGER;
+         if (!slot->large) memcpy(slot->data, nreq->buffer, nreq->size);
+         __atomic_store_n(&ch->head, head + 1, __ATOMIC_RELEASE);
+
+         if (!slot->large) {
+            nreq->remaining_bytes = 0;
+            ng_reqqueue_pop(q);
+            continue;
+         }
+         module_data.send_started[peer] = 1;
+      }
+
+      while (nreq->remaining_bytes > 0) {
+         big = &ch->big[(int)module_data.send_big[peer]];
+         if (__atomic_load_n(&big->full, __ATOMIC_ACQUIRE)) return 1;
+         n = ng_min(nreq->remaining_bytes, SHM_BIG_SIZE);
+         memcpy(big->data, (char *)nreq->buffer + (nreq->size - nreq->remaining_bytes), n);
+         big->len = n;
+         __atomic_store_n(&big->full, 1, __ATOMIC_RELEASE);
+         module_data.send_big[peer] ^= 1;
+         nreq->remaining_bytes -= n;
+      }
+      module_data.send_started[peer] = 0;
+      ng_reqqueue_pop(q);
+   }
+   return 0;
+}
+
+/**
+ * Takes the messages from peer into the posted receives in order. Data
+ * beyond the size of a receive is dropped.
+ *
+ * @return 0 if the queue is empty, 1 if the channel is empty
+ */
+static int shm_progress_recv(int peer) {
+   struct ng_reqqueue *q = &module_data.recvq[peer];
+   struct shm_channel *ch = module_data.in[peer];
+   struct shm_slot *slot;
+   struct shm_big *big;
+   req_handle_t *nreq;
+   uint64_t tail;
+   int n;
+
+   while ((nreq = q->head) != NULL) {
+      if (module_data.recv_left[peer] == 0) {
+         tail = ch->tail;
+         if (tail == __atomic_load_n(&ch->head, __ATOMIC_ACQUIRE)) return 1;
+         slot = &ch->slots[tail & (SHM_SLOTS - 1)];
+         if (!slot->large) {
+            memcpy(nreq->buffer, slot->data, ng_min((int)slot->len, nreq->size));
+            __atomic_store_n(&ch->tail, tail + 1, __ATOMIC_RELEASE);
+            nreq->remaining_bytes = 0;
+            ng_reqqueue_pop(q);
+            continue;
+         }
+         module_data.recv_left[peer] = slot->len;
+         __atomic_store_n(&ch->tail, tail + 1, __ATOMIC_RELEASE);
+      }
+
+      while (module_data.recv_left[peer] > 0) {
+         big = &ch->big[(int)module_data.recv_big[peer]];
+         if (!__atomic_load_n(&big->full, __ATOMIC_ACQUIRE)) return 1;
+         n = ng_min((int)big->len, nreq->remaining_bytes);
+         memcpy((char *)nreq->buffer + (nreq->size - nreq->remaining_bytes), big->data, n);
+         nreq->remaining_bytes -= n;
+         module_data.recv_left[peer] -= big->len;
+         __atomic_store_n(&big->full, 0, __ATOMIC_RELEASE);
+         module_data.recv_big[peer] ^= 1;
+      }
+      nreq->remaining_bytes = 0;
+      ng_reqqueue_pop(q);
+   }
+   return 0;
+}
+
+static int shm_post(int peer, int type, void *buffer, int size, NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = ng_reqpool_new(&module_data.reqpool, type, peer, buffer, size, req);
+   if (nreq == NULL) return -1;
+   /* empty messages are messages too */
+   if (size == 0) nreq->remaining_bytes = 1;
+   ng_reqqueue_push(type == TYPE_RECV ? &module_data.recvq[peer] : &module_data.sendq[peer], nreq);
+   return shm_test(req);
+}
+
+static int shm_isendto(int dst, void *buffer, int size, NG_Request *req) {
+   return shm_post(dst, TYPE_SEND, buffer, size, req);
+}
+
+static int shm_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
+   return shm_post(src, TYPE_RECV, buffer, size, req);
+}
+
+/**
+ * Progresses all queues that have requests.
+ *
+ * @return number of queues that could not finish
+ */
+static int shm_progress(int timeout) {
+   int peer, busy = 0;
+
+   for (peer = 0; peer < module_data.npeers; peer++) {
+      if (module_data.sendq[peer].head) busy += shm_progress_send(peer);
+      if (module_data.recvq[peer].head) busy += shm_progress_recv(peer);
+   }
+   return busy;
+}
+
+static int shm_test(NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = (req_handle_t *)*req;
+   /* completed requests are back in the pool (like MPI_REQUEST_NULL) */
+   if (nreq == NULL)
+      return 0;
+
+   /* earlier requests of this peer may still be in the way */
+   if (nreq->remaining_bytes > 0) {
+      if (nreq->type == TYPE_RECV) shm_progress_recv(nreq->index);
+      else shm_progress_send(nreq->index);
+   }
+   return ng_reqpool_release(&module_data.reqpool, req);
+}
+
+/* polls the channels until all requests are complete */
+static int shm_waitall(int count, NG_Request *reqs) {
+   return ng_reqpool_waitall(&module_data.reqpool, count, reqs, shm_progress, 0, module_data.yield);
+}
+
+static int shm_testany(int count, NG_Request *reqs, int *index) {
+   return ng_reqpool_testany(&module_data.reqpool, count, reqs, index, shm_progress);
+}
+
+static int shm_sendto(int dst, void *buffer, int size) {
+   NG_Request req;
+
+   if (shm_isendto(dst, buffer, size, &req) < 0) return -1;
+   if (shm_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+static int shm_recvfrom(int src, void *buffer, int size) {
+   NG_Request req;
+
+   if (shm_irecvfrom(src, buffer, size, &req) < 0) return -1;
+   if (shm_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+/**
+ * Maps one segment per peer pair. The lower rank creates it (the
+ * pages are zero, i.e. all channels are empty), the higher rank maps
+ * it after a barrier and the creator unlinks it once both have it.
+ * Channel 0 of a segment goes from the lower to the higher rank.
+ */
+static int shm_init(struct ng_options *global_opts) {
+#ifdef NG_MPI
+   const int peer_count = g_options.mpi_opts->worldsize;
+   const int rank = g_options.mpi_opts->worldrank;
+   char name[64];
+   long job = getpid();
+   long pagesize = sysconf(_SC_PAGESIZE);
+   int i, fd, round;
+   struct shm_channel *ch;
+
+   /* the name has to be unique for this run */
+   MPI_Bcast(&job, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+
+   module_data.npeers = peer_count;
+   module_data.seg_size = (2 * sizeof(struct shm_channel) + pagesize - 1) / pagesize * pagesize;
+   module_data.segs = calloc(peer_count, sizeof(void *));
+   module_data.out = calloc(peer_count, sizeof(struct shm_channel *));
+   module_data.in = calloc(peer_count, sizeof(struct shm_channel *));
+
+   /* round 0: the lower rank creates, round 1: the higher rank maps */
+   for (round = 0; round < 2; round++) {
+      for (i = 0; i < peer_count; i++) {
+         if (i == rank || (round == 0) != (rank < i)) continue;
+         snprintf(name, sizeof(name), "/netgauge.%ld.%d.%d", job, ng_min(i, rank), rank < i ? i : rank);
+         if (round == 0) {
+            fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd >= 0 && ftruncate(fd, module_data.seg_size) < 0) {
+               close(fd);
+               fd = -1;
+            }
+         } else {
+            fd = shm_open(name, O_RDWR, 0);
+         }
+         if (fd < 0) {
+            ng_perror("Mode shm could not %s segment %s (all ranks must be on one host)",
+                      round == 0 ? "create" : "open", name);
+            return 1;
+         }
+         module_data.segs[i] = mmap(NULL, module_data.seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+         close(fd);
+         if (module_data.segs[i] == MAP_FAILED) {
+            module_data.segs[i] = NULL;
+            ng_perror("Mode shm could not map segment %s", name);
+            return 1;
+         }
+         ch = (struct shm_channel *)module_data.segs[i];
+         module_data.out[i] = rank < i ? &ch[0] : &ch[1];
+         module_data.in[i] = rank < i ? &ch[1] : &ch[0];
+      }
+      MPI_Barrier(MPI_COMM_WORLD);
+   }
+   for (i = rank + 1; i < peer_count; i++) {
+      snprintf(name, sizeof(name), "/netgauge.%ld.%d.%d", job, rank, i);
+      shm_unlink(name);
+   }
+
+   module_data.cached_tail = calloc(peer_count, sizeof(uint64_t));
+   module_data.send_big = calloc(peer_count, sizeof(char));
+   module_data.recv_big = calloc(peer_count, sizeof(char));
+   module_data.send_started = calloc(peer_count, sizeof(char));
+   module_data.recv_left = calloc(peer_count, sizeof(int));
+   module_data.sendq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   module_data.recvq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
+
+   if (module_data.yield < 0) module_data.yield = peer_count > sysconf(_SC_NPROCESSORS_ONLN);
+   ng_info(NG_VLEV1, "shared memory channels: %d slots of %d bytes, 2 x %d bytes for large messages%s",
+           SHM_SLOTS, SHM_SLOT_SIZE, SHM_BIG_SIZE, module_data.yield ? ", yielding when idle" : "");
+   return 0;
+#else
+   return 1;
+#endif
+}
+
+/* module specific shutdown */
+static void shm_shutdown(struct ng_options *global_opts) {
+   int i;
+
+   if (module_data.segs) {
+      for (i = 0; i < module_data.npeers; i++) {
+         if (module_data.segs[i]) munmap(module_data.segs[i], module_data.seg_size);
+      }
+      free(module_data.segs);
+   }
+   ng_reqpool_destroy(&module_data.reqpool);
+   free(module_data.out);
+   free(module_data.in);
+   free(module_data.cached_tail);
+   free(module_data.send_big);
+   free(module_data.recv_big);
+   free(module_data.send_started);
+   free(module_data.recv_left);
+   free(module_data.sendq);
+   free(module_data.recvq);
+}
+
+/* module specific manpage information */
+static void shm_writemanpage(void) {
+   int i;
+
+   for (i=0; long_options_shm[i].name != NULL; i++) {
+      ng_manpage_module(
+         long_options_shm[i].val,
+         long_options_shm[i].name,
+         long_option_infos_shm[i].desc,
+         long_option_infos_shm[i].param
+      );
+   }
+}
+
+/* module specific usage information */
+static void shm_usage(void) {
+   int i;
+
+   for (i=0; long_options_shm[i].name != NULL; i++) {
+      ng_longoption_usage(
+         long_options_shm[i].val,
+         long_options_shm[i].name,
+         long_option_infos_shm[i].desc,
+         long_option_infos_shm[i].param
+      );
+   }
+}
+
+
+/* module registration */
+int register_shm(void) {
+   ng_register_module(&shm_module);
+   return 0;
+}
+#else
+
+/* dummy module registration */
+int register_shm(void) {
+   return 0;
+}
+
+#endif
@@ -9,15 +9,50 @@
 
 /*  vim:sts=3:sw=3:ts=3:expandtab */
 
+/* vmsplice/splice */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "netgauge.h"
 #ifdef NG_MOD_TCP
 
 #include "mod_inet.h"
-#include <sys/fcntl.h>
+#include "ng_reqpool.h"
+#include "ng_tstamp.h"
+#include "hrtimer/hrtimer.h"
+#include <fcntl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <getopt.h> /* getopt long */
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#if defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#define TCP_HAVE_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
+#if defined(HAVE_VMSPLICE) && defined(HAVE_SPLICE)
+#define TCP_HAVE_SPLICE
+#endif
+
+/* maximum number of readiness events fetched per progress call */
+#define TCP_MAX_EVENTS 512
+
+/* send modes (-Z) */
+#define TCP_SEND_COPY   0
+#define TCP_SEND_MSGZC  1
+#define TCP_SEND_SPLICE 2
+/* requested pipe size of the splice mode */
+#define TCP_PIPE_SIZE (1 << 20)
+/* zero-copy sends per peer whose send time is kept (power of two) */
+#define TCP_ZC_TRACK 1024
 
 /* extern stuff */
 extern struct ng_options g_options;
@@ -36,8 +71,13 @@ static void tcp_shutdown(struct ng_options *global_opts);
 static int tcp_isendto(int dst, void *buffer, int size, NG_Request *req);
 static int tcp_irecvfrom(int src, void *buffer, int size, NG_Request *req);
 static int tcp_test(NG_Request *req);
+static int tcp_waitall(int count, NG_Request *reqs);
+static int tcp_testany(int count, NG_Request *reqs, int *index);
+static int tcp_progress(int timeout);
 static int tcp_send_once(int dst, void *buffer, int size);
 static int tcp_recv_once(int src, void *buffer, int size);
+static int tcp_timestamps(int peer, struct ng_timestamps *ts);
+static int tcp_stats(long size, char *buf, int len);
 
 /* module registration data structure (TCP) */
 struct ng_module tcp_module = {
@@ -58,6 +98,11 @@ struct ng_module tcp_module = {
    .isendto        = tcp_isendto,
    .irecvfrom      = tcp_irecvfrom,
    .test           = tcp_test,
+   .waitall        = tcp_waitall,
+   .testany        = tcp_testany,
+   .progress       = tcp_progress,
+   .timestamps     = tcp_timestamps,
+   .stats          = tcp_stats,
 };
 
 /**
@@ -69,6 +114,9 @@ static struct option long_options_ip[]={
    {"subnet", required_argument, 0, 'S'},
    {"port", required_argument, 0, 'P'},
    {"nonblocking",   required_argument, 0, 'N'},
+   {"zerocopy", required_argument, 0, 'Z'},
+   {"timestamping", required_argument, 0, 'E'},
+   {"nodelay", no_argument, 0, 'D'},
    {0, 0, 0, 0}
 };
 
@@ -81,9 +129,22 @@ static struct option_info long_option_infos_ip[]={
    {"subnet to use for server and client (only valid when MPI is used)", "SUBNET/MASK"},
    {"server port to bind or connect to (not IP)", "NUMBER"},
         {"nonblocking [s]end and/or [r]eceive mode", "[s][r]"},
+        {"zero-copy sends with MSG_ZEROCOPY or vmsplice/splice (splice: no buffer reuse guarantee)", "msg|splice"},
+        {"collect [s]oft[w]are or [h]ard[w]are SO_TIMESTAMPING timestamps", "sw|hw"},
+        {"disable Nagle's algorithm (TCP_NODELAY)", NULL},
         {0, 0}
 };
 
+/* a MSG_ZEROCOPY send waiting for its completion */
+struct tcp_zc_call {
+      unsigned long long tsend;
+};
+
+/* zero-copy statistics of the sends since the last report */
+struct tcp_zc_stats {
+      unsigned long long calls, copied, ticks, max_ticks;
+};
+
 /* module private data */
 struct tcp_private_data {
       int                         sock;
@@ -102,6 +163,45 @@ struct tcp_private_data {
       struct sockaddr_in server_address;
       /** my server socket */
       int server_socket;
+      /** O_NONBLOCK state of each peer connection (fcntl only on changes) */
+      char *nonblocking;
+      /** preallocated handles for isendto/irecvfrom */
+      struct ng_reqpool reqpool;
+      /** outstanding requests of each peer in FIFO order - only the
+       * head may transfer data to keep the byte stream in order */
+      struct ng_reqqueue *sendq, *recvq;
+      /** number of peer_connections entries */
+      int npeers;
+      /** readiness of each connection - cleared when a send/recv returns
+       * EAGAIN, set again by the (edge-triggered) progress engine */
+      char *readable, *writable;
+#ifdef HAVE_SYS_EPOLL_H
+      int epfd;
+      struct epoll_event *events;
+#else
+      struct pollfd *pfds;
+#endif
+      int nevents;
+      /** send mode (-Z) */
+      int send_mode;
+      /** splice mode: a pipe per peer and the bytes still in it */
+      int (*pipes)[2];
+      int *pipe_bytes;
+      int pipe_size;
+      unsigned long long spliced, vmsplices, splices;
+      /** MSG_ZEROCOPY: id of the next send call and number of completed
+       * calls per peer (the kernel numbers the calls of a socket) */
+      unsigned int *zc_next, *zc_done;
+      /** sent MSG_ZEROCOPY requests waiting for their notification */
+      struct ng_reqqueue *zcq;
+      struct tcp_zc_call *zc_calls;
+      struct tcp_zc_stats zc_stat;
+      /** SO_TIMESTAMPING mode (-E) and the timestamps of each peer */
+      int tstamp;
+      struct ng_timestamps *ts;
+      unsigned int ts_sends;
+      /** set TCP_NODELAY on all connections (-D) */
+      int nodelay;
 } module_data;
 
 
@@ -109,7 +209,7 @@ struct tcp_private_data {
 static int tcp_getopt(int argc, char **argv, struct ng_options *global_opts) {
    int c;
    
-    char *optchars = "P:L:R:S:N:";  /*  additional module options */
+    char *optchars = "P:L:R:S:N:Z:E:D";  /*  additional module options */
    
    extern char *optarg;
    int option_index = 0;
@@ -227,6 +327,40 @@ static int tcp_getopt(int argc, char **argv, struct ng_options *global_opts) {
           ng_info(NG_VLEV2, "Using nonblocking receive mode");
        }
        break;
+    case 'Z':  /* zero-copy send mode */
+       if (strcmp(optarg, "msg") == 0) {
+#ifdef TCP_HAVE_ZEROCOPY
+          module_data.send_mode = TCP_SEND_MSGZC;
+#else
+          ng_error("MSG_ZEROCOPY is not supported on this system");
+          failure = 1;
+#endif
+       } else if (strcmp(optarg, "splice") == 0) {
+#ifdef TCP_HAVE_SPLICE
+          module_data.send_mode = TCP_SEND_SPLICE;
+#else
+          ng_error("vmsplice/splice is not supported on this system");
+          failure = 1;
+#endif
+       } else {
+          ng_error("Unknown zero-copy mode %s (msg or splice)", optarg);
+          failure = 1;
+       }
+       break;
+    case 'E':  /* kernel timestamps */
+       module_data.tstamp = ng_tstamp_mode(optarg);
+       if (module_data.tstamp < 0) {
+          ng_error("Unknown timestamping mode %s (sw or hw)", optarg);
+          failure = 1;
+       }
+#ifndef NG_HAVE_TSTAMP
+       ng_error("SO_TIMESTAMPING is not supported on this system");
+       failure = 1;
+#endif
+       break;
+    case 'D':  /* no Nagle */
+       module_data.nodelay = 1;
+       break;
       }
    }
    
@@ -242,6 +376,12 @@ static int tcp_getopt(int argc, char **argv, struct ng_options *global_opts) {
     ng_error("No remote address given for mode TCP - use option -R");
     failure = 1;
       }
+
+      /* both use the error queue of the socket */
+      if (module_data.tstamp && module_data.send_mode == TCP_SEND_MSGZC) {
+    ng_error("Option -E can not be combined with -Z msg");
+    failure = 1;
+      }
       
 #ifdef NG_MPI
       if (global_opts->mpi && module_data.local_addr.s_addr == 0) {
@@ -257,7 +397,12 @@ static int tcp_getopt(int argc, char **argv, struct ng_options *global_opts) {
 }
 
 static int tcp_set_blocking(int do_block, int partner) {
-   int flags = fcntl(module_data.peer_connections[partner], F_GETFL);
+   int flags;
+
+   /* nothing to do if the connection is in this state already */
+   if (module_data.nonblocking[partner] == !do_block) return 1;
+
+   flags = fcntl(module_data.peer_connections[partner], F_GETFL);
    if(flags<0) {
       ng_perror("Could not get flags");
    return 0;
@@ -275,17 +420,111 @@ static int tcp_set_blocking(int do_block, int partner) {
        return 0;
      }
    }
+   module_data.nonblocking[partner] = !do_block;
    return 1;
 }
 
+#ifdef TCP_HAVE_SPLICE
+/**
+ * vmsplice maps the pages of buffer into the pipe of dst and splice
+ * moves them on to the socket, the data is never copied. Bytes still
+ * in the pipe are the start of buffer (the caller continues at the
+ * offset of what left the pipe), so only an empty pipe takes pages.
+ *
+ * A request completes when its bytes left the pipe, but the socket
+ * (and on loopback the receive queue of the peer) may still reference
+ * the pages until the data is acknowledged or read. Unlike
+ * MSG_ZEROCOPY there is no notification for that, so this mode gives
+ * no buffer reuse guarantee: a pattern that changes the buffer after
+ * completion may change data that is still in flight.
+ *
+ * @return bytes that went to the socket, -EAGAIN if it is full
+ */
+static int tcp_splice_once(int dst, void *buffer, int size) {
+   struct iovec iov;
+   ssize_t n;
+
+   if (module_data.pipe_bytes[dst] == 0) {
+      iov.iov_base = buffer;
+      iov.iov_len = ng_min(size, module_data.pipe_size);
+      n = vmsplice(module_data.pipes[dst][1], &iov, 1, 0);
+      if (n < 0) {
+         ng_perror("Mode TCP vmsplice failed");
+         return -1;
+      }
+      module_data.pipe_bytes[dst] = n;
+      module_data.spliced += n;
+      module_data.vmsplices++;
+   }
+   n = splice(module_data.pipes[dst][0], NULL, module_data.peer_connections[dst], NULL,
+              module_data.pipe_bytes[dst], SPLICE_F_MOVE);
+   module_data.splices++;
+   if (n < 0) {
+      if (errno == EAGAIN) {
+         return -EAGAIN;
+      }
+      ng_perror("Mode TCP splice failed");
+      return -1;
+   }
+   module_data.pipe_bytes[dst] -= n;
+   return n;
+}
+#endif
+
+/* recv() that keeps the receive timestamp if timestamping is on */
+static inline int tcp_recv(int src, void *buffer, int size) {
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp) {
+      char control[256];
+      struct iovec iov = { buffer, size };
+      struct msghdr msg;
+      int rcvd;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      rcvd = recvmsg(module_data.peer_connections[src], &msg, module_data.recv_flags);
+      if (rcvd > 0) ng_tstamp_rx(&msg, &module_data.ts[src]);
+      return rcvd;
+   }
+#endif
+   return recv(module_data.peer_connections[src], buffer, size, module_data.recv_flags);
+}
+
+/* reads the send timestamps of dst every NG_TSTAMP_REAP sends so that
+ * the error queue doesn't eat the receive buffer */
+static inline void tcp_tstamp_sent(int dst) {
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp && ++module_data.ts_sends % NG_TSTAMP_REAP == 0)
+      ng_tstamp_reap(module_data.peer_connections[dst], &module_data.ts[dst]);
+#endif
+}
+
 static int tcp_send_once(int dst, void *buffer, int size) {
    int sent = 0;
+   int flags = module_data.send_flags;
+#ifdef TCP_HAVE_ZEROCOPY
+   HRT_TIMESTAMP_T t;
+   unsigned long long tsend = 0;
+   struct tcp_zc_call *call;
+
+   if (module_data.send_mode == TCP_SEND_MSGZC) {
+      flags |= MSG_ZEROCOPY;
+      HRT_GET_TIMESTAMP(t);
+      HRT_GET_TIME(t, tsend);
+   }
+#endif
+#ifdef TCP_HAVE_SPLICE
+   if (module_data.send_mode == TCP_SEND_SPLICE) return tcp_splice_once(dst, buffer, size);
+#endif
    errno = 0;
    sent = send(
       module_data.peer_connections[dst],
       (void *)buffer,
       size,
-      module_data.send_flags);
+      flags);
    if (sent == -1) {
       if (errno == EAGAIN) {
          return -EAGAIN;
@@ -293,12 +532,30 @@ static int tcp_send_once(int dst, void *buffer, int size) {
       ng_perror("Mode TCP send failed");
       return -1;
    }
+   tcp_tstamp_sent(dst);
+#ifdef TCP_HAVE_ZEROCOPY
+   /* every call that sent data gets the next id of the socket */
+   if (module_data.send_mode == TCP_SEND_MSGZC && sent > 0) {
+      call = &module_data.zc_calls[dst * TCP_ZC_TRACK + (module_data.zc_next[dst] & (TCP_ZC_TRACK - 1))];
+      call->tsend = tsend;
+      module_data.zc_next[dst]++;
+   }
+#endif
    return sent;
 }
 
 static int tcp_sendto(int dst, void *buffer, int size) {
    int sent = 0;
    
+   if (module_data.send_mode != TCP_SEND_COPY) {
+      /* the buffer may only be reused after the kernel released it */
+      NG_Request req;
+
+      if (tcp_isendto(dst, buffer, size, &req) < 0) return -1;
+      if (tcp_waitall(1, &req) < 0) return -1;
+      return size;
+   }
+
   again:
    /* send data */
    sent = send(
@@ -322,6 +579,7 @@ static int tcp_sendto(int dst, void *buffer, int size) {
       ng_perror("Mode TCP send failed");
       return -1;
    }
+   tcp_tstamp_sent(dst);
    
    /* report success */
    return sent;
@@ -331,11 +589,7 @@ static int tcp_recv_once(int src, void *buffer, int size) {
    int rcvd = 0;
    errno = 0;
    
-   rcvd = recv(
-      module_data.peer_connections[src],
-      (void *)buffer,
-      size,
-      module_data.recv_flags);
+   rcvd = tcp_recv(src, buffer, size);
    
    if (rcvd == -1) {
       if (errno == EAGAIN) {
@@ -351,11 +605,7 @@ static int tcp_recvfrom(int src, void *buffer, int size) {
    int rcvd = 0;
 
   again:
-   rcvd = recv(
-      module_data.peer_connections[src],
-      (void *)buffer,
-      size,
-      module_data.recv_flags);
+   rcvd = tcp_recv(src, buffer, size);
    
    if (rcvd == -1) {
       /* CTRL-C */
@@ -378,71 +628,392 @@ static int tcp_recvfrom(int src, void *buffer, int size) {
    return rcvd;
 }
 
-int tcp_isendto(int dst, void *buffer, int size, NG_Request *req) {
-   req_handle_t *sreq;
-   /* init sending */
-   sreq = malloc(sizeof(req_handle_t));
-   sreq->type            = TYPE_SEND;
-   sreq->index           = dst;
-   sreq->buffer          = buffer;
-   sreq->size            = size;
-   sreq->remaining_bytes = size;
-   *req = (NG_Request *) sreq;
-   tcp_set_blocking(0, dst);    /* non-blocking */
+#ifdef TCP_HAVE_ZEROCOPY
+/* completes the queued sends of peer whose calls were all notified */
+static void tcp_zc_complete(int peer) {
+   struct ng_reqqueue *q = &module_data.zcq[peer];
+
+   while (q->head && (int)(q->head->seq - module_data.zc_done[peer]) <= 0) {
+      q->head->remaining_bytes = 0;
+      ng_reqqueue_pop(q);
+   }
+}
+
+/**
+ * Reads the MSG_ZEROCOPY notifications of peer from the error queue.
+ * A notification covers a range of send calls whose pages the kernel
+ * released, it says if the kernel had to copy after all.
+ */
+static int tcp_zc_reap(int peer) {
+   char control[256];
+   struct msghdr msg;
+   struct cmsghdr *cmsg;
+   struct sock_extended_err *serr;
+   struct tcp_zc_call *call;
+   struct tcp_zc_stats *st = &module_data.zc_stat;
+   HRT_TIMESTAMP_T t;
+   unsigned long long now, ticks;
+   unsigned int id;
+
+   while (1) {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (recvmsg(module_data.peer_connections[peer], &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+         if (errno == EINTR) continue;
+         ng_perror("Mode TCP could not read the error queue");
+         return -1;
+      }
+      HRT_GET_TIMESTAMP(t);
+      HRT_GET_TIME(t, now);
+
+      for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+         if (!(cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) &&
+             !(cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) continue;
+         serr = (struct sock_extended_err *)CMSG_DATA(cmsg);
+         if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) continue;
+
+         for (id = serr->ee_info; (int)(serr->ee_data - id) >= 0; id++) {
+            call = &module_data.zc_calls[peer * TCP_ZC_TRACK + (id & (TCP_ZC_TRACK - 1))];
+            ticks = now - call->tsend;
+            st->calls++;
+            st->ticks += ticks;
+            if (ticks > st->max_ticks) st->max_ticks = ticks;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) st->copied++;
+         }
+         if ((int)(serr->ee_data + 1 - module_data.zc_done[peer]) > 0)
+            module_data.zc_done[peer] = serr->ee_data + 1;
+      }
+      tcp_zc_complete(peer);
+   }
+}
+#endif
+
+static int tcp_post(int peer, int type, void *buffer, int size, NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = ng_reqpool_new(&module_data.reqpool, type, peer, buffer, size, req);
+   if (nreq == NULL) return -1;
+   nreq->seq = module_data.zc_next ? module_data.zc_next[peer] : 0;
+
+   /* append to the peer's queue */
+   if (size > 0)
+      ng_reqqueue_push(type == TYPE_RECV ? &module_data.recvq[peer] : &module_data.sendq[peer], nreq);
+   tcp_set_blocking(0, peer);    /* non-blocking */
    return tcp_test(req);
 }
 
+int tcp_isendto(int dst, void *buffer, int size, NG_Request *req) {
+   return tcp_post(dst, TYPE_SEND, buffer, size, req);
+}
+
 int tcp_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
-   req_handle_t *rreq;
-   /* init receiving */
-   rreq = malloc(sizeof(req_handle_t));
-   rreq->type            = TYPE_RECV;
-   rreq->index           = src;
-   rreq->buffer          = buffer;
-   rreq->size            = size;
-   rreq->remaining_bytes = size;
-   *req = (NG_Request *) rreq;
-   tcp_set_blocking(0, src);    /* non-blocking */
-   return tcp_test(req);
+   return tcp_post(src, TYPE_RECV, buffer, size, req);
+}
+
+/**
+ * Moves data for the requests of peer in direction type (in order)
+ * until the socket would block. Every request continues at its offset
+ * (size - remaining). Completed requests leave the queue. Does not
+ * issue a syscall if the socket is known to be busy.
+ *
+ * @return 0 if the queue is empty, 1 if requests remain, < 0 on errors
+ */
+static int tcp_progress_queue(int peer, int type) {
+   struct ng_reqqueue *q;
+   req_handle_t *nreq;
+   char *ready;
+   char *buf;
+   int ret;
+
+   if (type == TYPE_RECV) {
+      q = &module_data.recvq[peer];
+      ready = &module_data.readable[peer];
+   } else {
+      q = &module_data.sendq[peer];
+      ready = &module_data.writable[peer];
+   }
+   if (q->head == NULL) return 0;
+   if (!*ready) return 1;
+   tcp_set_blocking(0, peer);
+
+   while ((nreq = q->head) != NULL) {
+      buf = (char *)nreq->buffer + (nreq->size - nreq->remaining_bytes);
+      if (type == TYPE_RECV) {
+         ret = tcp_recv_once(peer, buf, nreq->remaining_bytes);
+         if (ret == 0) {
+            ng_error("Mode TCP peer %d closed the connection", peer);
+            return -1;
+         }
+      } else {
+         ret = tcp_send_once(peer, buf, nreq->remaining_bytes);
+      }
+      if (ret == -EAGAIN) {
+         /* wait for the next edge */
+         *ready = 0;
+         return 1;
+      }
+      if (ret < 0) return ret;
+
+      /* partial transfers go on until the socket reports EAGAIN */
+      nreq->remaining_bytes -= ret;
+      if (type == TYPE_SEND && module_data.zc_next) nreq->seq = module_data.zc_next[peer];
+      if (nreq->remaining_bytes > 0) continue;
+
+      ng_reqqueue_pop(q);
+#ifdef TCP_HAVE_ZEROCOPY
+      /* complete only after the kernel released the pages of its calls */
+      if (type == TYPE_SEND && module_data.zcq &&
+          (int)(nreq->seq - module_data.zc_done[peer]) > 0) {
+         nreq->remaining_bytes = 1;
+         ng_reqqueue_push(&module_data.zcq[peer], nreq);
+      }
+#endif
+   }
+   return 0;
+}
+
+/**
+ * The progress engine: fetches readiness changes of the connections
+ * and moves data only for the sockets that became ready. Waits up to
+ * timeout ms (-1 forever) for events.
+ *
+ * @return number of events, < 0 on errors
+ */
+static int tcp_progress(int timeout) {
+   int i, n, peer;
+   unsigned int ev;
+
+#ifdef HAVE_SYS_EPOLL_H
+   n = epoll_wait(module_data.epfd, module_data.events, module_data.nevents, timeout);
+   if (n < 0) {
+      if (errno == EINTR) return 0;
+      ng_perror("Mode TCP epoll_wait failed");
+      return -1;
+   }
+#else
+   /* level-triggered fallback: poll the connections with requests */
+   for (n = 0, peer = 0; peer < module_data.npeers; peer++) {
+      short events = 0;
+      int zc = module_data.zc_next && module_data.zc_next[peer] != module_data.zc_done[peer];
+      if (module_data.recvq[peer].head) events |= POLLIN;
+      if (module_data.sendq[peer].head) events |= POLLOUT;
+      /* POLLERR (zero-copy notifications) is always reported */
+      if (!events && !zc) continue;
+      module_data.pfds[n].fd = module_data.peer_connections[peer];
+      module_data.pfds[n].events = events;
+      n++;
+   }
+   if (n == 0) return 0;
+   if (poll(module_data.pfds, n, timeout) < 0) {
+      if (errno == EINTR) return 0;
+      ng_perror("Mode TCP poll failed");
+      return -1;
+   }
+#endif
+
+   for (i = 0; i < n; i++) {
+#ifdef HAVE_SYS_EPOLL_H
+      peer = module_data.events[i].data.u32;
+      ev = module_data.events[i].events;
+      if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) module_data.readable[peer] = 1;
+      if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) module_data.writable[peer] = 1;
+#else
+      for (peer = 0; module_data.peer_connections[peer] != module_data.pfds[i].fd; peer++);
+      ev = module_data.pfds[i].revents;
+      if (ev & (POLLIN | POLLERR | POLLHUP)) module_data.readable[peer] = 1;
+      if (ev & (POLLOUT | POLLERR | POLLHUP)) module_data.writable[peer] = 1;
+#endif
+#ifdef TCP_HAVE_ZEROCOPY
+      if (module_data.zc_next && tcp_zc_reap(peer) < 0) return -1;
+#endif
+#ifdef NG_HAVE_TSTAMP
+      if (module_data.ts && ng_tstamp_reap(module_data.peer_connections[peer], &module_data.ts[peer]) < 0) return -1;
+#endif
+      if (tcp_progress_queue(peer, TYPE_RECV) < 0) return -1;
+      if (tcp_progress_queue(peer, TYPE_SEND) < 0) return -1;
+   }
+   return n;
 }
 
 int tcp_test(NG_Request *req) {
    req_handle_t *nreq;
-   int ret=0;
-/* do the rest */
+
    nreq = (req_handle_t *)*req;
-   if (nreq->remaining_bytes <= 0)
+   /* completed requests are back in the pool (like MPI_REQUEST_NULL) */
+   if (nreq == NULL)
       return 0;
 
-   if (get_req_type(req) == TYPE_RECV) {
-      ret = tcp_recv_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { /* was busy */
-         return 1; /* in progress */
+   if (nreq->remaining_bytes > 0) {
+      if (tcp_progress_queue(nreq->index, nreq->type) < 0) return -1;
+#ifdef TCP_HAVE_ZEROCOPY
+      if (nreq->remaining_bytes > 0 && module_data.zcq && module_data.zcq[nreq->index].head &&
+          tcp_zc_reap(nreq->index) < 0) return -1;
+#endif
+      /* one non-blocking call to the engine if the socket was busy */
+      if (nreq->remaining_bytes > 0 && tcp_progress(0) < 0) return -1;
+   }
+   /* earlier requests of this peer may still be in the way */
+   return ng_reqpool_release(&module_data.reqpool, req);
+}
+
+/* sleeps in the progress engine until all requests are complete */
+static int tcp_waitall(int count, NG_Request *reqs) {
+   return ng_reqpool_waitall(&module_data.reqpool, count, reqs, tcp_progress, -1, 0);
+}
+
+static int tcp_testany(int count, NG_Request *reqs, int *index) {
+   return ng_reqpool_testany(&module_data.reqpool, count, reqs, index, tcp_progress);
+}
+
+/* registers all connections with the progress engine */
+static int tcp_setup_progress(void) {
+   int i;
+
+   module_data.readable = malloc(module_data.npeers);
+   module_data.writable = malloc(module_data.npeers);
+   /* unknown state - the first send/recv finds out */
+   memset(module_data.readable, 1, module_data.npeers);
+   memset(module_data.writable, 1, module_data.npeers);
+   module_data.nevents = module_data.npeers < TCP_MAX_EVENTS ? module_data.npeers : TCP_MAX_EVENTS;
+
+#ifdef HAVE_SYS_EPOLL_H
+   module_data.events = malloc(module_data.nevents * sizeof(struct epoll_event));
+   module_data.epfd = epoll_create(module_data.npeers);
+   if (module_data.epfd < 0) {
+      ng_perror("Mode TCP could not create epoll instance");
+      return 1;
+   }
+   for (i = 0; i < module_data.npeers; i++) {
+      struct epoll_event ev;
+
+      if (module_data.peer_connections[i] < 0) continue;
+      memset(&ev, 0, sizeof(ev));
+      ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+      ev.data.u32 = i;
+      if (epoll_ctl(module_data.epfd, EPOLL_CTL_ADD, module_data.peer_connections[i], &ev) < 0) {
+         ng_perror("Mode TCP could not add connection %d to epoll", i);
+         return 1;
       }
-   } else {
-      ret = tcp_send_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { /* was busy */
-         return 1; /* in progress */
+   }
+   ng_info(NG_VLEV2, "epoll progress engine watches %d connections", module_data.npeers - 1);
+#else
+   (void)i;
+   module_data.pfds = malloc(module_data.npeers * sizeof(struct pollfd));
+#endif
+   return 0;
+}
+
+
+/* with -D small messages go out right away - Nagle would hold back all but the
+ * first of several messages in flight until the (delayed) ack */
+static int tcp_setup_nodelay(void) {
+   int i, one = 1;
+
+   if (!module_data.nodelay) return 0;
+   for (i = 0; i < module_data.npeers; i++) {
+      if (module_data.peer_connections[i] < 0) continue;
+      if (setsockopt(module_data.peer_connections[i], IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) < 0) {
+         ng_perror("Mode TCP could not set TCP_NODELAY");
+         return 1;
       }
    }
-   return ret;
+   return 0;
+}
+
+/* prepares the connections for the zero-copy send mode */
+static int tcp_setup_zerocopy(void) {
+   int i;
+
+#ifdef TCP_HAVE_ZEROCOPY
+   if (module_data.send_mode == TCP_SEND_MSGZC) {
+      int one = 1;
+
+      module_data.zc_next = calloc(module_data.npeers, sizeof(unsigned int));
+      module_data.zc_done = calloc(module_data.npeers, sizeof(unsigned int));
+      module_data.zc_calls = calloc(module_data.npeers * TCP_ZC_TRACK, sizeof(struct tcp_zc_call));
+      module_data.zcq = calloc(module_data.npeers, sizeof(struct ng_reqqueue));
+      for (i = 0; i < module_data.npeers; i++) {
+         if (module_data.peer_connections[i] < 0) continue;
+         if (setsockopt(module_data.peer_connections[i], SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+            ng_perror("Mode TCP could not enable SO_ZEROCOPY");
+            return 1;
+         }
+      }
+      ng_info(NG_VLEV1, "Using MSG_ZEROCOPY sends");
+   }
+#endif
+#ifdef TCP_HAVE_SPLICE
+   if (module_data.send_mode == TCP_SEND_SPLICE) {
+      module_data.pipes = malloc(module_data.npeers * sizeof(int[2]));
+      module_data.pipe_bytes = calloc(module_data.npeers, sizeof(int));
+      for (i = 0; i < module_data.npeers; i++) {
+         module_data.pipes[i][0] = module_data.pipes[i][1] = -1;
+         if (module_data.peer_connections[i] < 0) continue;
+         if (pipe2(module_data.pipes[i], O_NONBLOCK) < 0) {
+            ng_perror("Mode TCP could not create a pipe");
+            return 1;
+         }
+         /* larger pipes need fewer splice calls (the limit is fs.pipe-max-size) */
+         fcntl(module_data.pipes[i][1], F_SETPIPE_SZ, TCP_PIPE_SIZE);
+         module_data.pipe_size = fcntl(module_data.pipes[i][1], F_GETPIPE_SZ);
+      }
+      ng_info(NG_VLEV1, "Using vmsplice/splice sends through %d byte pipes", module_data.pipe_size);
+      ng_info(NG_VNORM, "Mode TCP splice sends complete before the kernel released the buffer - do not reuse it for new data");
+   }
+#endif
+   (void)i;
+   return 0;
 }
 
+/* enables SO_TIMESTAMPING on all connections */
+static int tcp_setup_tstamp(void) {
+#ifdef NG_HAVE_TSTAMP
+   char ifname[IF_NAMESIZE], *nic = NULL;
+   int i;
+
+   if (!module_data.tstamp) return 0;
+   if (module_data.tstamp == NG_TSTAMP_HW && !ng_tstamp_inet_if(module_data.local_addr, ifname))
+      nic = ifname;
+   module_data.ts = calloc(module_data.npeers, sizeof(struct ng_timestamps));
+   for (i = 0; i < module_data.npeers; i++) {
+      if (module_data.peer_connections[i] < 0) continue;
+      if (ng_tstamp_enable(module_data.peer_connections[i], module_data.tstamp, nic)) return 1;
+   }
+   ng_info(NG_VLEV1, "Collecting %s timestamps", module_data.tstamp == NG_TSTAMP_HW ? "hardware" : "software");
+#endif
+   return 0;
+}
+
+/* returns and clears the timestamps of peer */
+static int tcp_timestamps(int peer, struct ng_timestamps *ts) {
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.ts == NULL) return 1;
+   if (ng_tstamp_reap(module_data.peer_connections[peer], &module_data.ts[peer]) < 0) return 1;
+   *ts = module_data.ts[peer];
+   memset(&module_data.ts[peer], 0, sizeof(struct ng_timestamps));
+   return 0;
+#else
+   return 1;
+#endif
+}
 
 /* module specific benchmark initialization */
 static int tcp_init(struct ng_options *global_opts) {
+  int ret;
+
   if (!g_options.mpi) {
     /* we don't want or we don't have MPI */
-    return tcp_setup_channels_NOMPI();
+    ret = tcp_setup_channels_NOMPI();
   } else {
-    return tcp_setup_channels_MPI();
+    ret = tcp_setup_channels_MPI();
   }
+  if (ret) return ret;
+  if (tcp_setup_nodelay()) return 1;
+  if (tcp_setup_zerocopy()) return 1;
+  if (tcp_setup_tstamp()) return 1;
+  return tcp_setup_progress();
 }
 
 /**
@@ -454,7 +1025,13 @@ static int tcp_setup_channels_NOMPI() {
   struct sockaddr_in cli;
   
   /* one for client, one for server */
+  module_data.npeers = 2;
   module_data.peer_connections = malloc(sizeof(int) * 2);
+  module_data.peer_connections[0] = module_data.peer_connections[1] = -1;
+  module_data.nonblocking = calloc(2, sizeof(char));
+  module_data.sendq = calloc(2, sizeof(struct ng_reqqueue));
+  module_data.recvq = calloc(2, sizeof(struct ng_reqqueue));
+  ng_reqpool_init(&module_data.reqpool, 2 * 2);
 
   if (g_options.server) {
     /* SERVER mode */
@@ -600,7 +1177,14 @@ static int tcp_setup_channels_MPI() {
    
    /* make the connections */
 
+   module_data.npeers = peer_count;
    module_data.peer_connections = malloc(sizeof(int) * peer_count);
+   for (i=0; i < peer_count; i++) module_data.peer_connections[i] = -1;
+   module_data.nonblocking = calloc(peer_count, sizeof(char));
+   module_data.sendq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   module_data.recvq = calloc(peer_count, sizeof(struct ng_reqqueue));
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
 
    for (i=0; i < peer_count; i++) {
 
@@ -674,8 +1258,33 @@ static int tcp_setup_channels_MPI() {
 #endif
 }
 
+/**
+ * Formats what the zero-copy send mode did since the last call (the
+ * patterns call it after each size) and clears the counters.
+ */
+static int tcp_stats(long size, char *buf, int len) {
+   struct tcp_zc_stats *st = &module_data.zc_stat;
+   int ret = 1;
+
+   if (module_data.send_mode == TCP_SEND_SPLICE && module_data.vmsplices > 0) {
+      snprintf(buf, len, "spliced %llu bytes in %llu vmsplice and %llu splice calls",
+               module_data.spliced, module_data.vmsplices, module_data.splices);
+      ret = 0;
+   } else if (module_data.send_mode == TCP_SEND_MSGZC && st->calls > 0) {
+      snprintf(buf, len, "zero-copy send calls %llu copied %llu completion after %.2lf us (max %.2lf us)",
+               st->calls, st->copied,
+               HRT_GET_USEC(st->ticks) / st->calls, HRT_GET_USEC(st->max_ticks));
+      ret = 0;
+   }
+   memset(st, 0, sizeof(*st));
+   module_data.spliced = module_data.vmsplices = module_data.splices = 0;
+   return ret;
+}
+
 /* module specific shutdown */
 static void tcp_shutdown(struct ng_options *global_opts) {
+  int i;
+
   /*  close accepted socket (if any) */
   if (module_data.conn > 0) {
 /*    // print socket statistics ???
@@ -696,6 +1305,32 @@ static void tcp_shutdown(struct ng_options *global_opts) {
     if (close(module_data.sock) < 0)
      ng_perror("Failed to close network socket");
   }
+
+  ng_reqpool_destroy(&module_data.reqpool);
+  free(module_data.nonblocking);
+  free(module_data.sendq);
+  free(module_data.recvq);
+  free(module_data.readable);
+  free(module_data.writable);
+#ifdef HAVE_SYS_EPOLL_H
+  if (module_data.epfd > 0) close(module_data.epfd);
+  free(module_data.events);
+#else
+  free(module_data.pfds);
+#endif
+  if (module_data.pipes) {
+    for (i = 0; i < module_data.npeers; i++) {
+      if (module_data.pipes[i][0] >= 0) close(module_data.pipes[i][0]);
+      if (module_data.pipes[i][1] >= 0) close(module_data.pipes[i][1]);
+    }
+    free(module_data.pipes);
+  }
+  free(module_data.pipe_bytes);
+  free(module_data.zc_next);
+  free(module_data.zc_done);
+  free(module_data.zc_calls);
+  free(module_data.zcq);
+  free(module_data.ts);
 }
 
 /* module specific manpage information */
@@ -9,13 +9,29 @@
 
 // vim:sts=3:sw=3:ts=3:expandtab
 
+/* sendmmsg/recvmmsg */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "netgauge.h"
+#include "ng_reqpool.h"
+#include "ng_tstamp.h"
 #ifdef NG_MOD_UDP
 
 #include "mod_inet.h"
 #include <sys/fcntl.h>
 #include <getopt.h> /* getopt long */
 
+#if defined(HAVE_SENDMMSG) && defined(HAVE_RECVMMSG)
+#define UDP_HAVE_MMSG
+#endif
+
+/* maximum datagrams per sendmmsg/recvmmsg */
+#define UDP_MAX_BATCH 1024
+/* maximum segments the kernel accepts in one GSO send */
+#define UDP_MAX_GSO_SEGS 64
+
 /* extern stuff */
 extern struct ng_options g_options;
 
@@ -35,6 +51,8 @@ static int udp_send_once(int dst, void *buffer, int size);
 static int udp_isendto(int dst, void *buffer, int size, NG_Request *req);
 static int udp_irecvfrom(int src, void *buffer, int size, NG_Request *req);
 static int udp_test(NG_Request *req);
+static int udp_syscalls(long size, double *sends, double *recvs);
+static int udp_timestamps(int peer, struct ng_timestamps *ts);
 
 /* module registration data structure (udp) */
 struct ng_module udp_module = {
@@ -56,6 +74,8 @@ struct ng_module udp_module = {
    .isendto          = udp_isendto,
    .irecvfrom        = udp_irecvfrom,
    .test             = udp_test,
+   .timestamps       = udp_timestamps,
+   .syscalls         = udp_syscalls,
 };
 
 /**
@@ -67,6 +87,9 @@ static struct option long_options_ip[] = {
    {"subnet", required_argument, 0, 'S'},
    {"port", required_argument, 0, 'P'},
    {"nonblocking", required_argument, 0, 'N'},
+   {"batch", required_argument, 0, 'B'},
+   {"gso", required_argument, 0, 'G'},
+   {"timestamping", required_argument, 0, 'E'},
    {0, 0, 0, 0}
 };
 
@@ -80,9 +103,21 @@ static struct option_info long_option_infos_ip[] = {
     "SUBNET/MASK"},
    {"server port to bind or connect to (not IP)", "NUMBER"},
    {"nonblocking [s]end and/or [r]eceive mode", "[s][r]"},
+   {"datagrams per sendmmsg/recvmmsg call (0 = one syscall per datagram)", "NUMBER"},
+   {"datagram size for UDP_SEGMENT/UDP_GRO offload (one syscall sends up to 64 datagrams)", "BYTES"},
+   {"collect [s]oft[w]are or [h]ard[w]are SO_TIMESTAMPING timestamps", "sw|hw"},
    {0, 0}
 };
 
+/** message sizes with their own syscall statistics */
+#define UDP_STAT_SIZES 8
+
+/** syscall statistics of the messages of one size */
+struct udp_stat {
+   long size;
+   unsigned long long sends, recvs, ssys, rsys;
+};
+
 /* module private data */
 struct mod_udp_data {
    /* array of all addresses of all peers ... */
@@ -103,10 +138,38 @@ struct mod_udp_data {
    /* this array holds the received bytes from every peer. Because UDP does
     * not have channel semantics and we may receive from a peer that we
     * don't want to receive from ... just store the bytes in
-    * rcvd_bytes[peer] in this case - the recvfrom function will look into
-    * this array first */
+    * rcvd_bytes[peer] in this case (if no request of this peer is posted)
+    * - the recvfrom functions will look into this array first */
    int *rcvd_bytes;
+   /* open addressing table (rank+1, 0 = empty) of the peer addresses -
+    * datagrams are matched to their sender by the source address, the
+    * payload stays untouched */
+   int *peer_hash;
+   unsigned int peer_hash_mask;
    req_handle_t **requests;
+   /** O_NONBLOCK state of the socket (fcntl only on changes) */
+   int nonblocking;
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool reqpool;
+   /** datagrams per sendmmsg/recvmmsg call (0 = sendto/recvfrom) */
+   int batch;
+   /** GSO/GRO segment size (0 = no offload) */
+   int gso;
+   /** bytes passed to the kernel per datagram - a GSO buffer or the mtu */
+   unsigned int chunk;
+#ifdef UDP_HAVE_MMSG
+   struct mmsghdr *msgs;
+   struct iovec *iovs;
+   struct sockaddr_in *names;
+#endif
+   /** syscall statistics per message size, stat is the slot of the
+    * message in progress */
+   struct udp_stat stats[UDP_STAT_SIZES], *stat;
+   /** SO_TIMESTAMPING mode (-E) - the send timestamps are those of
+    * the socket, the receive timestamps those of each peer */
+   int tstamp;
+   struct ng_timestamps ts_tx, *ts;
+   unsigned int ts_sends;
 };
 static struct mod_udp_data module_data;
 
@@ -115,7 +178,7 @@ static int udp_getopt(int argc, char **argv, struct ng_options *global_opts)
 {
    int c;
 
-   char *optchars = "P:L:R:S:N:";       // additional module options
+   char *optchars = "P:L:R:S:N:B:G:E:";   // additional module options
 
    extern char *optarg;
    int option_index = 0;
@@ -126,6 +189,7 @@ static int udp_getopt(int argc, char **argv, struct ng_options *global_opts)
 
    // initialize module private information data structure
    memset(&module_data, 0, sizeof(module_data));
+   module_data.stat = module_data.stats;
 
    module_data.mtu = 65535 -    /* max ip data len  - */
        sizeof(struct udphdr) -  /* udp header len   - */
@@ -238,9 +302,52 @@ static int udp_getopt(int argc, char **argv, struct ng_options *global_opts)
             ng_info(NG_VLEV2, "Using nonblocking receive mode");
          }
          break;
+      case 'B':                /* batched send/receive */
+         module_data.batch = atoi(optarg);
+         if (module_data.batch < 0 || module_data.batch > UDP_MAX_BATCH) {
+            ng_error("Batch size must be between 0 and %d", UDP_MAX_BATCH);
+            failure = 1;
+         }
+#ifndef UDP_HAVE_MMSG
+         if (module_data.batch) {
+            ng_error("sendmmsg/recvmmsg are not available on this system");
+            failure = 1;
+         }
+#endif
+         break;
+      case 'G':                /* segmentation offload */
+         module_data.gso = atoi(optarg);
+         if (module_data.gso <= 0 || module_data.gso > module_data.mtu) {
+            ng_error("GSO datagram size must be between 1 and %u", module_data.mtu);
+            failure = 1;
+         }
+#if !defined(UDP_SEGMENT) || !defined(UDP_GRO)
+         ng_error("UDP_SEGMENT/UDP_GRO are not available on this system");
+         failure = 1;
+#endif
+         break;
+      case 'E':                /* kernel timestamps */
+         module_data.tstamp = ng_tstamp_mode(optarg);
+         if (module_data.tstamp < 0) {
+            ng_error("Unknown timestamping mode %s (sw or hw)", optarg);
+            failure = 1;
+         }
+#ifndef NG_HAVE_TSTAMP
+         ng_error("SO_TIMESTAMPING is not supported on this system");
+         failure = 1;
+#endif
+         break;
       }
    }
 
+   /* one GSO send carries as many datagrams as fit into one IP packet */
+   module_data.chunk = module_data.mtu;
+   if (module_data.gso > 0)
+      module_data.chunk = module_data.gso * ng_min(UDP_MAX_GSO_SEGS, module_data.mtu / module_data.gso);
+   /* batched modes split messages into many datagrams */
+   if (module_data.batch || module_data.gso)
+      udp_module.max_datasize = -1;
+
    // check for necessary parameters, apply default values where possible
    if (!failure) {
       if (!module_data.port) {
@@ -252,6 +359,12 @@ static int udp_getopt(int argc, char **argv, struct ng_options *global_opts)
          ng_error("No remote address given for mode UDP - use option -R");
          failure = 1;
       }
+
+      /* recvmmsg() would need a control buffer per datagram */
+      if (module_data.tstamp && module_data.batch) {
+         ng_error("Option -E can not be combined with -B");
+         failure = 1;
+      }
 #ifdef NG_MPI
       if (global_opts->mpi && module_data.local_addr.s_addr == 0) {
          ng_error("No subnet address/mask given for mode UDP - use option -S");
@@ -268,7 +381,12 @@ static int udp_getopt(int argc, char **argv, struct ng_options *global_opts)
 
 static int udp_set_blocking(int do_block, int partner)
 {
-   int flags = fcntl(module_data.server_socket, F_GETFL);
+   int flags;
+
+   /* all peers share one socket - nothing to do if it is in this state */
+   if (module_data.nonblocking == !do_block) return 1;
+
+   flags = fcntl(module_data.server_socket, F_GETFL);
    if (flags < 0) {
       ng_perror("Could not get flags");
       return 0;
@@ -286,25 +404,244 @@ static int udp_set_blocking(int do_block, int partner)
          return 0;
       }
    }
+   module_data.nonblocking = !do_block;
    return 1;
 }
 
 
 
+/* makes the slot of size the one the syscalls go to - the last slot
+ * is recycled once all are taken */
+static inline void udp_stat_of(int size)
+{
+   struct udp_stat *s = module_data.stat;
+   int i;
+
+   if (s->size == size) return;
+   for (i = 0, s = module_data.stats; i < UDP_STAT_SIZES - 1; i++, s++) {
+      if (s->size == size || s->sends + s->recvs == 0) break;
+   }
+   if (s->size != size) memset(s, 0, sizeof(*s));
+   s->size = size;
+   module_data.stat = s;
+}
+
+/* counts a message for the syscall statistics */
+static inline void udp_count(int size, int type)
+{
+   udp_stat_of(size);
+   if (type == TYPE_SEND) module_data.stat->sends++;
+   else module_data.stat->recvs++;
+}
+
+static int udp_syscalls(long size, double *sends, double *recvs)
+{
+   struct udp_stat *s;
+   int i, ret = 1;
+
+   for (i = 0, s = module_data.stats; i < UDP_STAT_SIZES; i++, s++) {
+      if (s->size != size || s->sends + s->recvs == 0) continue;
+      *sends = s->sends ? (double)s->ssys / s->sends : 0.0;
+      *recvs = s->recvs ? (double)s->rsys / s->recvs : 0.0;
+      ret = 0;
+   }
+   memset(module_data.stats, 0, sizeof(module_data.stats));
+   module_data.stat = module_data.stats;
+   return ret;
+}
+
+static inline unsigned int udp_addr_hash(const struct sockaddr_in *addr)
+{
+   return ((unsigned int)addr->sin_addr.s_addr * 2654435761u) ^ (addr->sin_port * 40503u);
+}
+
+/* returns the rank that sent from addr or -1 for strangers */
+static inline int udp_peer_of(const struct sockaddr_in *addr)
+{
+   unsigned int i = udp_addr_hash(addr) & module_data.peer_hash_mask;
+   const struct sockaddr_in *peer;
+
+   while (module_data.peer_hash[i]) {
+      peer = &module_data.addresses[module_data.peer_hash[i] - 1];
+      if (peer->sin_port == addr->sin_port && peer->sin_addr.s_addr == addr->sin_addr.s_addr)
+         return module_data.peer_hash[i] - 1;
+      i = (i + 1) & module_data.peer_hash_mask;
+   }
+   return -1;
+}
+
+/* without MPI there is one peer - the server replies to the address
+ * the client sends from */
+static inline int udp_single_peer(const struct sockaddr_in *addr, int src)
+{
+   if (g_options.server) module_data.addresses[0] = *addr;
+   return src;
+}
+
+/**
+ * Stores a datagram that arrived from another peer than the one we
+ * are receiving from - in its posted request or, if there is none,
+ * as count in rcvd_bytes[peer].
+ */
+static void udp_deliver_other(int peer, const char *data, int len)
+{
+   req_handle_t *req;
+   int n;
+
+   if (peer < 0) {
+      ng_info(NG_VLEV2, "Dropped %d bytes from unknown sender", len);
+      return;
+   }
+   req = module_data.requests[peer];
+   if (req && req->remaining_bytes > 0) {
+      n = ng_min(len, req->remaining_bytes);
+      memcpy((char *)req->buffer + (req->size - req->remaining_bytes), data, n);
+      req->remaining_bytes -= n;
+      len -= n;
+   }
+   module_data.rcvd_bytes[peer] += len;
+}
+
+/* takes up to size bytes that arrived early from src */
+static inline int udp_take_early(int src, int size)
+{
+   int n = ng_min(module_data.rcvd_bytes[src], size);
+
+   module_data.rcvd_bytes[src] -= n;
+   return n;
+}
+
+/**
+ * Sends the next datagrams of buffer to dst - one chunk with sendto()
+ * or up to batch chunks with one sendmmsg(). Returns like sendto().
+ */
+static int udp_send_chunks(int dst, char *buffer, int size)
+{
+#ifdef UDP_HAVE_MMSG
+   int i, n, ret, sent;
+
+   if (module_data.batch) {
+      for (n = 0; n < module_data.batch && n * module_data.chunk < size; n++) {
+         module_data.iovs[n].iov_base = buffer + n * module_data.chunk;
+         module_data.iovs[n].iov_len = ng_min(module_data.chunk, size - n * module_data.chunk);
+         module_data.msgs[n].msg_hdr.msg_name = &module_data.addresses[dst];
+         module_data.msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      }
+      module_data.stat->ssys++;
+      ret = sendmmsg(module_data.server_socket, module_data.msgs, n, module_data.send_flags);
+      if (ret <= 0) return -1;
+      for (sent = 0, i = 0; i < ret; i++) sent += module_data.msgs[i].msg_len;
+      return sent;
+   }
+#endif
+   module_data.stat->ssys++;
+#ifdef NG_HAVE_TSTAMP
+   /* read the send timestamps before the error queue eats the receive buffer */
+   if (module_data.tstamp && ++module_data.ts_sends % NG_TSTAMP_REAP == 0)
+      ng_tstamp_reap(module_data.server_socket, &module_data.ts_tx);
+#endif
+   return sendto(module_data.server_socket,
+                 buffer,
+                 ng_min(size, module_data.chunk),
+                 module_data.send_flags,
+                 (struct sockaddr *)&module_data.addresses[dst], sizeof(struct sockaddr));
+}
+
+/**
+ * Receives the next datagrams - one with recvfrom() or up to batch
+ * with one recvmmsg(). Data from src is packed into buffer, data from
+ * other peers is handed to udp_deliver_other(). Returns the number of
+ * bytes from src (may be 0) or -1 (and errno) like recvfrom().
+ */
+static int udp_recv_chunks(int src, char *buffer, int size)
+{
+   struct sockaddr_in client;
+   socklen_t addrlen = sizeof(client);
+   int rcvd, peer;
+#ifdef UDP_HAVE_MMSG
+   int i, n, ret;
+
+   if (module_data.batch) {
+      for (n = 0; n < module_data.batch && n * module_data.chunk < size; n++) {
+         module_data.iovs[n].iov_base = buffer + n * module_data.chunk;
+         module_data.iovs[n].iov_len = ng_min(module_data.chunk, size - n * module_data.chunk);
+         module_data.msgs[n].msg_hdr.msg_name = &module_data.names[n];
+         module_data.msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      }
+      module_data.stat->rsys++;
+      /* block (if blocking at all) only for the first datagram */
+      ret = recvmmsg(module_data.server_socket, module_data.msgs, n,
+                     module_data.recv_flags | MSG_WAITFORONE, NULL);
+      if (ret <= 0) return -1;
+      /* datagrams shorter than their slot (e.g. partially coalesced
+       * GRO buffers) or from other peers leave gaps - close them */
+      for (rcvd = 0, i = 0; i < ret; i++) {
+         peer = g_options.mpi ? udp_peer_of(&module_data.names[i]) : udp_single_peer(&module_data.names[i], src);
+         if (peer != src) {
+            udp_deliver_other(peer, module_data.iovs[i].iov_base, module_data.msgs[i].msg_len);
+            continue;
+         }
+         if (module_data.iovs[i].iov_base != buffer + rcvd)
+            memmove(buffer + rcvd, module_data.iovs[i].iov_base, module_data.msgs[i].msg_len);
+         rcvd += module_data.msgs[i].msg_len;
+      }
+      return rcvd;
+   }
+#endif
+   module_data.stat->rsys++;
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp) {
+      char control[256];
+      struct iovec iov = { buffer, ng_min(size, module_data.chunk) };
+      struct msghdr msg;
+
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = &client;
+      msg.msg_namelen = addrlen;
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      rcvd = recvmsg(module_data.server_socket, &msg, module_data.recv_flags);
+      if (rcvd < 0) return -1;
+      peer = g_options.mpi ? udp_peer_of(&client) : udp_single_peer(&client, src);
+      if (peer >= 0) ng_tstamp_rx(&msg, &module_data.ts[peer]);
+   } else
+#endif
+   {
+      rcvd = recvfrom(module_data.server_socket,
+                      buffer,
+                      ng_min(size, module_data.chunk),
+                      module_data.recv_flags,
+                      (struct sockaddr *)&client,
+                      &addrlen);
+      if (rcvd < 0) return -1;
+
+      /* only MPI runs have more than one peer */
+      peer = g_options.mpi ? udp_peer_of(&client) : udp_single_peer(&client, src);
+   }
+   if (peer != src) {
+      udp_deliver_other(peer, buffer, rcvd);
+      return 0;
+   }
+   return rcvd;
+}
+
 static int udp_isendto(int dst, void *buffer, int size, NG_Request *req)
 {
    req_handle_t *sreq;
    //init sending
-   sreq = malloc(sizeof(req_handle_t));
-   memset(sreq, 0, sizeof(req_handle_t));
+   sreq = ng_reqpool_get(&module_data.reqpool);
+   if (sreq == NULL) return -1;
    sreq->type = TYPE_SEND;
    sreq->index = dst;
    sreq->buffer = buffer;
    sreq->size = size;
    sreq->remaining_bytes = size;
    *req = (NG_Request *) sreq;
+   udp_count(size, TYPE_SEND);
    udp_set_blocking(0, dst);    //non-blocking
-   udp_test(req);
+   if (udp_test(req) == 0) return size;
    return size-sreq->remaining_bytes;
 }
 
@@ -312,14 +649,15 @@ static int udp_irecvfrom(int src, void *buffer, int size, NG_Request *req)
 {
    req_handle_t *rreq;
 //init receiving
-   rreq = malloc(sizeof(req_handle_t));
-   memset(rreq, 0, sizeof(req_handle_t));
+   rreq = ng_reqpool_get(&module_data.reqpool);
+   if (rreq == NULL) return -1;
    rreq->type = TYPE_RECV;
    rreq->index = src;
    rreq->buffer = buffer;
    rreq->size = size;
-   rreq->remaining_bytes = size;
+   rreq->remaining_bytes = size - udp_take_early(src, size);
    *req = (NG_Request *) rreq;
+   udp_count(size, TYPE_RECV);
    udp_set_blocking(0, src);    //non-blocking
    module_data.requests[src] = rreq;
    return 0;
@@ -327,19 +665,11 @@ static int udp_irecvfrom(int src, void *buffer, int size, NG_Request *req)
 
 static int udp_recv_once(int src, void *buffer, int size)
 {
-   char               *bufptr   = buffer;
-   int                rcvd      = 0;
-   struct sockaddr_in client;
-   socklen_t          addrlen   = sizeof(client);
+   int rcvd = 0;
 
    errno = 0;
    // receive any outstanding data
-   rcvd = recvfrom(module_data.server_socket,
-                   (void *)bufptr,
-                   ng_min(size, module_data.mtu), 
-                   module_data.recv_flags, 
-                   (struct sockaddr *)&client, 
-                   &addrlen);
+   rcvd = udp_recv_chunks(src, buffer, size);
    if (rcvd < 0) {
       if (errno == EAGAIN)
          return -EAGAIN;
@@ -347,37 +677,16 @@ static int udp_recv_once(int src, void *buffer, int size)
       ng_perror("Mode udp recv_once() failed");
       return -1;
    }
-
-   /* check if the data is from our src */
-   int index = (int)*((char *)buffer);
-   if (index != src) {
-      /* it's from somebody else */
-      //ng_info(NG_VLEV2, "Data from wrong host: host: %i, size: %i\n", *((char *)buffer), rcvd);
-      if(module_data.requests[index]) {
-         module_data.requests[index]->remaining_bytes -= rcvd;
-      }
-      //return -EAGAIN;
-      return 0;
-   }
    return rcvd;
 }
 
 static int udp_send_once(int dst, void *buffer, int size)
 {
-   char *bufptr = buffer;
    int sent = 0;
 
-   /* the first byte of the packet is the source-rank - we use this to
-    * not add additional overhead to the protocol to have the measurement
-    * as accurate as possible */
-   *((char *)buffer) = (char)g_options.mpi_opts->worldrank;
    errno = 0;
-   // send at most one mtu of data
-   sent = sendto(module_data.server_socket,
-                 bufptr,
-                 ng_min(size, module_data.mtu),
-                 module_data.send_flags,
-                 (struct sockaddr *)&module_data.addresses[dst], sizeof(struct sockaddr));
+   // send at most one batch of data
+   sent = udp_send_chunks(dst, buffer, size);
    if (sent <= 0) {
       // nonblocking operation would block - try again
       if (errno == EAGAIN)
@@ -398,27 +707,36 @@ int udp_test(NG_Request *req) {
    int ret=0;
 //do the rest
    nreq = (req_handle_t *)*req;
-   if (nreq->remaining_bytes <= 0)
+   // completed requests are back in the pool (like MPI_REQUEST_NULL)
+   if (nreq == NULL)
       return 0;
 
-   if (get_req_type(req) == TYPE_RECV) {
-      ret = udp_recv_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { //was busy
-         return 1; //in progress
+   if (nreq->remaining_bytes > 0) {
+      /* continue where the last call stopped */
+      char *buf = (char *)nreq->buffer + (nreq->size - nreq->remaining_bytes);
+
+      udp_stat_of(nreq->size);
+      if (get_req_type(req) == TYPE_RECV) {
+         ret = udp_recv_once(nreq->index, buf, nreq->remaining_bytes);
+      } else {
+         ret = udp_send_once(nreq->index, buf, nreq->remaining_bytes);
       }
-   } else {
-      ret = udp_send_once(nreq->index, nreq->buffer, nreq->remaining_bytes);
-      if (ret >= 0) {
-         nreq->remaining_bytes -= ret;
-         return nreq->remaining_bytes;
-      } else if(ret == -EAGAIN) { //was busy
+      if (ret == -EAGAIN) { //was busy
          return 1; //in progress
+      } else if (ret < 0) {
+         return ret;
       }
+      nreq->remaining_bytes -= ret;
+      if (nreq->remaining_bytes > 0)
+         return nreq->remaining_bytes;
    }
-   return ret;
+
+   // done - release the request
+   if (module_data.requests[nreq->index] == nreq)
+      module_data.requests[nreq->index] = NULL;
+   ng_reqpool_put(&module_data.reqpool, nreq);
+   *req = NULL;
+   return 0;
 }
 
 static int udp_sendto(int dst, void *buffer, int size) {
@@ -426,19 +744,12 @@ static int udp_sendto(int dst, void *buffer, int size) {
    int          sent       = 0;
    unsigned int sent_total = 0;
 
-   /* the first byte of the packet is the source-rank - we use this to
-    * not add additional overhead to the protocol to have the measurement
-    * as accurate as possible */
-   *((char*)buffer) = (char)g_options.mpi_opts->worldrank;
+   udp_count(size, TYPE_SEND);
 
    /* send data */
    while (sent_total < size) {
-      // send at most one mtu of data
-      sent = sendto(module_data.server_socket,
-                    (void *)bufptr,
-                    ng_min(size - sent_total, module_data.mtu),
-                    module_data.send_flags,
-                    (struct sockaddr *)&module_data.addresses[dst], sizeof(struct sockaddr));
+      // send at most one batch of data
+      sent = udp_send_chunks(dst, bufptr, size - sent_total);
       if (sent <= 0) {
          // CTRL-C
          if (g_stop_tests || errno == EINTR) {
@@ -470,23 +781,19 @@ static int udp_recvfrom(int src, void *buffer, int size)
    char *bufptr = buffer;
    int rcvd     = 0;
    unsigned int rcvd_total = 0;
-   struct sockaddr_in client;
-   socklen_t addrlen = sizeof(client);
+
+   udp_count(size, TYPE_RECV);
 
    /* look if we already have something */
-   rcvd_total = module_data.rcvd_bytes[src];
-   module_data.rcvd_bytes[src] = 0;
+   rcvd_total = udp_take_early(src, size);
+   bufptr += rcvd_total;
 
    // receive data
    while (rcvd_total < size) {
       // receive any outstanding data
-      rcvd = recvfrom(module_data.server_socket,
-                      (void *)bufptr,
-                      size - rcvd_total,
-                      module_data.recv_flags, (struct sockaddr *)&client, &addrlen);
+      rcvd = udp_recv_chunks(src, bufptr, size - rcvd_total);
 
-      //printf("**\n");
-      if (rcvd <= 0) {
+      if (rcvd < 0) {
          // CTRL-C
          if (g_stop_tests || errno == EINTR) {
             ng_error("recvfrom() interrupted at %d bytes", rcvd_total);
@@ -501,15 +808,9 @@ static int udp_recvfrom(int src, void *buffer, int size)
          return -1;
       }
 
-      /* check if the data is from our src :) */
-      if (*((char *)buffer) == (char)src) {
-         /* yes it is -  continue sending while there is data left */
-         rcvd_total += rcvd;
-         bufptr     += rcvd;
-      } else {
-         /* it's from somebody else */
-         module_data.rcvd_bytes[(int)*((char *)buffer)] += rcvd;
-      }
+      /* continue receiving while there is data left */
+      rcvd_total += rcvd;
+      bufptr     += rcvd;
    }
 
    return rcvd_total;
@@ -518,12 +819,78 @@ static int udp_recvfrom(int src, void *buffer, int size)
 /* module specific benchmark initialization */
 static int udp_init(struct ng_options *global_opts)
 {
+   int ret;
+
    if (!g_options.mpi) {
       /* we don't want or we don't have MPI */
-      return udp_setup_channels_NOMPI();
+      ret = udp_setup_channels_NOMPI();
    } else {
-      return udp_setup_channels_MPI();
+      ret = udp_setup_channels_MPI();
+   }
+   if (ret) return ret;
+
+#ifdef UDP_HAVE_MMSG
+   if (module_data.batch) {
+      int i;
+
+      module_data.msgs = calloc(module_data.batch, sizeof(struct mmsghdr));
+      module_data.iovs = calloc(module_data.batch, sizeof(struct iovec));
+      module_data.names = calloc(module_data.batch, sizeof(struct sockaddr_in));
+      for (i = 0; i < module_data.batch; i++) {
+         module_data.msgs[i].msg_hdr.msg_iov = &module_data.iovs[i];
+         module_data.msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      ng_info(NG_VLEV1, "Using sendmmsg/recvmmsg with up to %d datagrams", module_data.batch);
+   }
+#endif
+#if defined(UDP_SEGMENT) && defined(UDP_GRO)
+   if (module_data.gso) {
+      int on = 1;
+
+      if (setsockopt(module_data.server_socket, SOL_UDP, UDP_SEGMENT,
+                     &module_data.gso, sizeof(module_data.gso)) < 0) {
+         ng_perror("Mode UDP could not enable UDP_SEGMENT");
+         return 1;
+      }
+      if (setsockopt(module_data.server_socket, SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0) {
+         ng_perror("Mode UDP could not enable UDP_GRO");
+         return 1;
+      }
+      ng_info(NG_VLEV1, "Using UDP GSO/GRO with %d byte datagrams (%u bytes per send)",
+              module_data.gso, module_data.chunk);
    }
+#endif
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.tstamp) {
+      char ifname[IF_NAMESIZE], *nic = NULL;
+
+      if (module_data.tstamp == NG_TSTAMP_HW && !ng_tstamp_inet_if(module_data.local_addr, ifname))
+         nic = ifname;
+      module_data.ts = calloc(g_options.mpi ? g_options.mpi_opts->worldsize : 2, sizeof(struct ng_timestamps));
+      if (ng_tstamp_enable(module_data.server_socket, module_data.tstamp, nic)) return 1;
+      ng_info(NG_VLEV1, "Collecting %s timestamps", module_data.tstamp == NG_TSTAMP_HW ? "hardware" : "software");
+   }
+#endif
+   return 0;
+}
+
+/* returns and clears the timestamps of peer - the send timestamps are
+ * those of the last datagram sent to anybody */
+static int udp_timestamps(int peer, struct ng_timestamps *ts)
+{
+#ifdef NG_HAVE_TSTAMP
+   if (module_data.ts == NULL) return 1;
+   if (ng_tstamp_reap(module_data.server_socket, &module_data.ts_tx) < 0) return 1;
+   *ts = module_data.ts[peer];
+   ts->sched = module_data.ts_tx.sched;
+   ts->sw_tx = module_data.ts_tx.sw_tx;
+   ts->hw_tx = module_data.ts_tx.hw_tx;
+   memset(&module_data.ts[peer], 0, sizeof(struct ng_timestamps));
+   memset(&module_data.ts_tx, 0, sizeof(struct ng_timestamps));
+   return 0;
+#else
+   return 1;
+#endif
 }
 
 /**
@@ -537,6 +904,7 @@ static int udp_setup_channels_NOMPI()
    module_data.addresses = calloc(2, sizeof(struct sockaddr_in));
    module_data.requests = calloc(2, sizeof(req_handle_t*));
    memset(module_data.requests, 0, sizeof(req_handle_t*)*2);
+   ng_reqpool_init(&module_data.reqpool, 2 * 2);
 
    if (g_options.server) {
       /* SERVER mode */
@@ -630,7 +998,8 @@ static int udp_setup_channels_MPI()
 {
 #ifdef NG_MPI
    const int peer_count = g_options.mpi_opts->worldsize;
-   int result, retries = 0;
+   int result, retries = 0, rank;
+   unsigned int size = 2, i;
 
    ng_info(NG_VLEV2, "Distributing IP adresses between %d peers.", peer_count);
 
@@ -638,6 +1007,8 @@ static int udp_setup_channels_MPI()
    module_data.addresses = malloc(peer_count * sizeof(struct sockaddr_in));
    module_data.requests = calloc(peer_count, sizeof(req_handle_t*));
    memset(module_data.requests, 0, sizeof(req_handle_t*)*peer_count);
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
 
    /* allocate rcvd_bytes array, used to count the bytes that are
     * received "accidentially" */
@@ -688,6 +1059,16 @@ static int udp_setup_channels_MPI()
       exit(1);
    }
 
+   /* fill the address -> rank table for udp_peer_of() */
+   while (size < 2 * peer_count) size <<= 1;
+   module_data.peer_hash = calloc(size, sizeof(int));
+   module_data.peer_hash_mask = size - 1;
+   for (rank = 0; rank < peer_count; rank++) {
+      i = udp_addr_hash(&module_data.addresses[rank]) & module_data.peer_hash_mask;
+      while (module_data.peer_hash[i]) i = (i + 1) & module_data.peer_hash_mask;
+      module_data.peer_hash[i] = rank + 1;
+   }
+
    return 0;
 #else
    /* we should have called the NOMPI version of this
@@ -701,6 +1082,16 @@ static void udp_shutdown(struct ng_options *global_opts)
 {
 
    free(module_data.addresses);
+   ng_reqpool_destroy(&module_data.reqpool);
+#ifdef UDP_HAVE_MMSG
+   free(module_data.msgs);
+   free(module_data.iovs);
+   free(module_data.names);
+#endif
+   free(module_data.peer_hash);
+   free(module_data.rcvd_bytes);
+   free(module_data.requests);
+   free(module_data.ts);
 
    if (module_data.server_socket > 0) {
       ng_info(NG_VLEV1, "Closing network socket");
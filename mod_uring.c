@@ -0,0 +1,1064 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+
+#include "netgauge.h"
+#ifdef NG_MOD_URING
+
+#include "mod_inet.h"
+#include "ng_reqpool.h"
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <getopt.h> /* getopt long */
+
+/* default number of submission queue entries */
+#define URING_DEFAULT_DEPTH 256
+/* maximum number of registered (fixed) buffers */
+#define URING_MAX_FIXED 16
+/* provided buffers for multishot receives (power of two) */
+#define URING_PBUF_COUNT 64
+#define URING_PBUF_SIZE  65536
+#define URING_PBUF_GROUP 0
+/* user_data of the multishot receive of a peer (requests use their
+ * address, which never has the top bit set) */
+#define URING_TAG_MULTISHOT (1ULL << 63)
+/* maximum UDP payload of a single datagram */
+#define URING_UDP_MAX 65507
+
+/* extern stuff */
+extern struct ng_options g_options;
+
+/* function prototypes */
+static int uring_setup_channels_MPI();
+static int uring_sendto(int dst, void *buffer, int size);
+static int uring_recvfrom(int src, void *buffer, int size);
+static void *uring_malloc(size_t size);
+static void uring_free(void *buf);
+static int uring_init(struct ng_options *global_opts);
+static int uring_getopt(int argc, char **argv, struct ng_options *global_opts);
+static void uring_writemanpage(void);
+static void uring_usage(void);
+static void uring_shutdown(struct ng_options *global_opts);
+static int uring_isendto(int dst, void *buffer, int size, NG_Request *req);
+static int uring_irecvfrom(int src, void *buffer, int size, NG_Request *req);
+static int uring_test(NG_Request *req);
+static int uring_waitall(int count, NG_Request *reqs);
+static int uring_testany(int count, NG_Request *reqs, int *index);
+static int uring_progress(int timeout);
+
+/* module registration data structure (io_uring) */
+struct ng_module uring_module = {
+   .name         = "uring",
+   .desc         = "Mode uring uses TCP or UDP sockets driven by io_uring.",
+   .flags        = NG_MOD_RELIABLE | NG_MOD_CHANNEL,
+   .max_datasize = -1,        /*  can send data of arbitrary size (TCP) */
+   .headerlen    = 0,         /*  no extra space needed for header */
+   .malloc       = uring_malloc,
+   .free         = uring_free,
+   .getopt       = uring_getopt,
+   .init         = uring_init,
+   .shutdown     = uring_shutdown,
+   .usage        = uring_usage,
+   .writemanpage = uring_writemanpage,
+   .sendto         = uring_sendto,
+   .recvfrom       = uring_recvfrom,
+   .isendto        = uring_isendto,
+   .irecvfrom      = uring_irecvfrom,
+   .test           = uring_test,
+   .waitall        = uring_waitall,
+   .testany        = uring_testany,
+   .progress       = uring_progress,
+};
+
+/**
+ * getopt long options for uring
+ */
+static struct option long_options_uring[]={
+   {"subnet", required_argument, 0, 'S'},
+   {"port", required_argument, 0, 'P'},
+   {"udp", no_argument, 0, 'U'},
+   {"depth", required_argument, 0, 'D'},
+   {"sqpoll", required_argument, 0, 'Q'},
+   {"multishot", no_argument, 0, 'M'},
+   {"nofixed", no_argument, 0, 'X'},
+   {0, 0, 0, 0}
+};
+
+/**
+ * array of descriptions for uring
+ */
+static struct option_info long_option_infos_uring[]={
+   {"subnet to use (only valid when MPI is used)", "SUBNET/MASK"},
+   {"first port to bind to", "NUMBER"},
+   {"use UDP instead of TCP (one connected socket per peer)", NULL},
+   {"number of submission queue entries", "NUMBER"},
+   {"let a kernel thread poll the submission queue (idle time in ms)", "MS"},
+   {"receive with one multishot recv per peer into provided buffers", NULL},
+   {"do not register the buffers allocated by the patterns", NULL},
+   {0, 0}
+};
+
+/* a provided buffer filled by a multishot receive */
+struct uring_chunk {
+   int next;
+   int off, len;
+};
+
+/* module private data */
+struct uring_private_data {
+   unsigned short port;
+   struct in_addr local_addr;
+   /** SOCK_DGRAM instead of SOCK_STREAM */
+   int udp;
+   int depth;
+   /** SQPOLL idle time in ms, 0 if off */
+   int sqpoll;
+   int multishot;
+   int nofixed;
+   /** the sockets to the other peers (-1 for myself) */
+   int *peer_connections;
+   int npeers;
+
+   int ring_fd;
+   void *sq_ring, *cq_ring;
+   size_t sq_ring_size, cq_ring_size, sqes_size;
+   unsigned *sq_head, *sq_tail, *sq_mask, *sq_flags;
+   unsigned sq_entries;
+   /** next free SQE and SQEs not yet handed to the kernel */
+   unsigned sq_local_tail, to_submit;
+   struct io_uring_sqe *sqes;
+   unsigned *cq_head, *cq_tail, *cq_mask;
+   struct io_uring_cqe *cqes;
+
+   /** registered buffers (the pattern buffers from uring_malloc) */
+   struct iovec fixed[URING_MAX_FIXED];
+   int nfixed, registered;
+
+   /** provided buffer ring of the multishot receives */
+   struct io_uring_buf_ring *pbuf_ring;
+   size_t pbuf_ring_size;
+   char *pbufs;
+   unsigned short pbuf_tail;
+   /** provided buffers the kernel can fill */
+   int pbuf_free;
+   struct uring_chunk chunks[URING_PBUF_COUNT];
+   /** received but not yet consumed chunks of each peer */
+   int *chunk_head, *chunk_tail;
+   /** state of the multishot receive of each peer */
+   char *armed;
+#define URING_IDLE   0
+#define URING_ARMED  1
+#define URING_CLOSED 2
+
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool reqpool;
+   struct ng_reqqueue *sendq, *recvq;
+   /** the head of the queue has an SQE in flight (only the head, to
+    * keep the byte stream in order) */
+   char *send_busy, *recv_busy;
+
+   /** statistics */
+   unsigned long long nenter, nsqes, ncqes;
+};
+
+static struct uring_private_data module_data;
+
+
+/* parse command line parameters for module-specific options */
+static int uring_getopt(int argc, char **argv, struct ng_options *global_opts) {
+   int c;
+
+   char *optchars = "P:S:UD:Q:MX";  /*  additional module options */
+
+   extern char *optarg;
+   int option_index = 0;
+   extern int optind, opterr, optopt;
+
+   int failure = 0;
+
+   /*  initialize module private information data structure */
+   memset(&module_data, 0, sizeof(module_data));
+   module_data.depth = URING_DEFAULT_DEPTH;
+
+   /*  parse module-options */
+   while((c=getopt_long(argc, argv, optchars, long_options_uring, &option_index))
+         >= 0 ) {
+      switch( c ) {
+      case '?':  /* unrecognized or badly used option */
+         if (!strchr(optchars, optopt))
+            continue;  /* unrecognized */
+         ng_error("Option %c requires an argument", optopt);
+         failure = 1;
+         break;
+      case 'P':  /* port */
+         module_data.port = atoi(optarg);
+         break;
+      case 'S':  /* subnet to use when using MPI */
+         if (global_opts->mpi > 0) {
+            char *addr, *mask;
+            char *pos;
+            struct in_addr addr_in, mask_in;
+
+            pos = strstr(optarg, "/");
+            if (pos == NULL) {
+               ng_error("Expected an \"address/netmask\" style argument");
+               failure = 1;
+               break;
+            }
+            addr = optarg;
+            mask = pos + 1;
+            *pos = '\0';
+
+            if (!inet_aton(addr, &addr_in)) {
+               ng_error("Malformed \"address\" part of argument %s/%s", addr, mask);
+               failure = 1;
+               break;
+            }
+            pos = strstr(mask, ".");
+            if (pos == NULL) { /*  netmask as number (e.g. 24, 16,...) */
+               mask_in.s_addr = htonl( ( (unsigned int) pow(2, atoi(mask) + 1) - 1 ) << (32 - atoi(mask)) );
+            } else { /*  netmask in std. dot notation */
+               mask_in.s_addr = htonl(inet_network(mask));
+               if (mask_in.s_addr == 0) {
+                  ng_error("Malformed \"netmask\" part of argument %s/%s", addr, mask);
+                  failure = 1;
+                  break;
+               }
+            }
+
+            if (inet_get_subnet(addr_in, mask_in, &module_data.local_addr)) {
+               ng_error("Could not determine subnet to use");
+               failure = 1;
+               break;
+            }
+         } else
+            ng_error("Option -S is only valid when using MPI (global option -p)");
+         break;
+      case 'U':  /* UDP */
+         module_data.udp = 1;
+         break;
+      case 'D':  /* ring size */
+         module_data.depth = atoi(optarg);
+         break;
+      case 'Q':  /* kernel submission queue polling */
+         module_data.sqpoll = atoi(optarg);
+         if (module_data.sqpoll <= 0) {
+            ng_error("The SQPOLL idle time must be positive");
+            failure = 1;
+         }
+         break;
+      case 'M':  /* multishot receive */
+         module_data.multishot = 1;
+         break;
+      case 'X':  /* plain buffers */
+         module_data.nofixed = 1;
+         break;
+      }
+   }
+
+   /*  check for necessary parameters, apply default values where possible */
+   if (!failure) {
+      if (!module_data.port) {
+         module_data.port = INET_DEFAULT_PORT;
+         ng_info(NG_VLEV2, "No port specified - using default %d", module_data.port);
+      }
+      if (module_data.depth < 8) {
+         ng_error("The ring needs at least 8 entries");
+         failure = 1;
+      }
+      if (!global_opts->mpi) {
+         ng_error("Mode uring needs MPI to set up the connections");
+         failure = 1;
+      } else if (module_data.local_addr.s_addr == 0) {
+         ng_error("No subnet address/mask given for mode uring - use option -S");
+         failure = 1;
+      }
+      if (module_data.udp) {
+         /* connected datagram sockets - reliable they are not */
+         uring_module.flags = NG_MOD_CHANNEL;
+         uring_module.max_datasize = URING_UDP_MAX;
+      }
+   }
+
+   /*  report success or failure */
+   return failure;
+}
+
+/**
+ * Hands the new SQEs to the kernel and waits for wait completions.
+ * With SQPOLL the kernel thread picks them up by itself and this
+ * is only a syscall if the thread went to sleep (or we wait).
+ */
+static int uring_enter(unsigned wait) {
+   unsigned flags = 0;
+   int ret;
+
+   if (wait) flags |= IORING_ENTER_GETEVENTS;
+   if (module_data.sqpoll) {
+      /* the tail store must be visible before we look at the flags */
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (__atomic_load_n(module_data.sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+         flags |= IORING_ENTER_SQ_WAKEUP;
+      module_data.to_submit = 0;
+      if (!flags) return 0;
+   } else if (!module_data.to_submit && !wait) {
+      return 0;
+   }
+
+   ret = syscall(__NR_io_uring_enter, module_data.ring_fd, module_data.to_submit, wait, flags, NULL, 0);
+   module_data.nenter++;
+   if (ret < 0) {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return 0;
+      ng_perror("Mode uring io_uring_enter failed");
+      return -1;
+   }
+   if (!module_data.sqpoll) module_data.to_submit -= ret;
+   return 0;
+}
+
+/* returns a zeroed SQE - submits first if the ring is full */
+static struct io_uring_sqe *uring_get_sqe(void) {
+   struct io_uring_sqe *sqe;
+   unsigned head;
+
+   while (1) {
+      head = __atomic_load_n(module_data.sq_head, __ATOMIC_ACQUIRE);
+      if (module_data.sq_local_tail - head < module_data.sq_entries) break;
+      if (uring_enter(0) < 0 || g_stop_tests) return NULL;
+   }
+   sqe = &module_data.sqes[module_data.sq_local_tail & *module_data.sq_mask];
+   memset(sqe, 0, sizeof(*sqe));
+   return sqe;
+}
+
+/* makes the SQE from uring_get_sqe visible to the kernel */
+static void uring_queue_sqe(void) {
+   module_data.sq_local_tail++;
+   module_data.to_submit++;
+   module_data.nsqes++;
+   __atomic_store_n(module_data.sq_tail, module_data.sq_local_tail, __ATOMIC_RELEASE);
+}
+
+/* index of the registered buffer that holds [buf, buf+len) or -1 */
+static int uring_fixed_index(void *buf, int len) {
+   int i;
+
+   for (i = 0; i < module_data.nfixed; i++) {
+      char *base = module_data.fixed[i].iov_base;
+      if ((char *)buf >= base && (char *)buf + len <= base + module_data.fixed[i].iov_len)
+         return i;
+   }
+   return -1;
+}
+
+/* registers the buffer table with the kernel, which only knows whole tables */
+static void uring_register_fixed(void) {
+   int ret;
+
+   if (module_data.registered)
+      syscall(__NR_io_uring_register, module_data.ring_fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+   module_data.registered = 0;
+   if (module_data.nfixed == 0) return;
+   ret = syscall(__NR_io_uring_register, module_data.ring_fd, IORING_REGISTER_BUFFERS,
+                 module_data.fixed, module_data.nfixed);
+   module_data.registered = ret >= 0;
+   if (ret < 0) {
+      ng_perror("Mode uring could not register %d buffers - using plain send/recv", module_data.nfixed);
+      module_data.nfixed = 0;
+      module_data.nofixed = 1;
+   }
+}
+
+/**
+ * Adds [buf, buf+size) to the registered buffers, the oldest entry
+ * goes (and is sent from plain memory again) if the table is full.
+ */
+static void uring_register_buffer(void *buf, size_t size) {
+   int n = module_data.nfixed;
+
+   if (n == URING_MAX_FIXED) {
+      memmove(&module_data.fixed[0], &module_data.fixed[1], (n - 1) * sizeof(struct iovec));
+      n--;
+   }
+   module_data.fixed[n].iov_base = buf;
+   module_data.fixed[n].iov_len = size;
+   module_data.nfixed = n + 1;
+   uring_register_fixed();
+   if (module_data.registered)
+      ng_info(NG_VLEV2, "registered %d buffers (%lu bytes at %p)", module_data.nfixed, (unsigned long)size, buf);
+}
+
+/* communication memory - registered with the ring */
+static void *uring_malloc(size_t size) {
+   void *buf;
+
+   if (posix_memalign(&buf, sysconf(_SC_PAGESIZE), size ? size : 1) != 0) return NULL;
+   if (!module_data.nofixed && module_data.ring_fd > 0 && size > 0)
+      uring_register_buffer(buf, size);
+   return buf;
+}
+
+/**
+ * Releases memory from uring_malloc. The kernel keeps registered
+ * pages pinned, so the buffer leaves the table first - otherwise a
+ * later allocation at the same address would send the old pages.
+ */
+static void uring_free(void *buf) {
+   int i;
+
+   for (i = 0; i < module_data.nfixed; i++) {
+      if (module_data.fixed[i].iov_base != buf) continue;
+      memmove(&module_data.fixed[i], &module_data.fixed[i + 1],
+              (module_data.nfixed - i - 1) * sizeof(struct iovec));
+      module_data.nfixed--;
+      uring_register_fixed();
+      break;
+   }
+   free(buf);
+}
+
+/* hands provided buffer bid back to the kernel */
+static void uring_recycle(int bid) {
+   struct io_uring_buf *b;
+
+   b = &module_data.pbuf_ring->bufs[module_data.pbuf_tail & (URING_PBUF_COUNT - 1)];
+   b->addr = (unsigned long)(module_data.pbufs + (size_t)bid * URING_PBUF_SIZE);
+   b->len = URING_PBUF_SIZE;
+   b->bid = bid;
+   module_data.pbuf_tail++;
+   module_data.pbuf_free++;
+   __atomic_store_n(&module_data.pbuf_ring->tail, module_data.pbuf_tail, __ATOMIC_RELEASE);
+}
+
+/* posts the multishot receive of peer */
+static int uring_arm(int peer) {
+   struct io_uring_sqe *sqe;
+
+   if ((sqe = uring_get_sqe()) == NULL) return -1;
+   sqe->opcode    = IORING_OP_RECV;
+   sqe->fd        = module_data.peer_connections[peer];
+   sqe->ioprio    = IORING_RECV_MULTISHOT;
+   sqe->flags     = IOSQE_BUFFER_SELECT;
+   sqe->buf_group = URING_PBUF_GROUP;
+   sqe->user_data = URING_TAG_MULTISHOT | peer;
+   uring_queue_sqe();
+   module_data.armed[peer] = URING_ARMED;
+   return 0;
+}
+
+/* re-arms the multishot receives that stopped for lack of buffers */
+static int uring_rearm(void) {
+   int peer;
+
+   if (!module_data.multishot || module_data.pbuf_free == 0) return 0;
+   for (peer = 0; peer < module_data.npeers; peer++) {
+      if (module_data.peer_connections[peer] >= 0 && module_data.armed[peer] == URING_IDLE &&
+          uring_arm(peer) < 0) return -1;
+   }
+   return 0;
+}
+
+static struct ng_reqqueue *uring_get_queue(int peer, int type) {
+   if (type == TYPE_RECV) return &module_data.recvq[peer];
+   return &module_data.sendq[peer];
+}
+
+/**
+ * Copies chunks of the multishot receive into the posted receives of
+ * peer. A datagram completes a request (the rest of it is dropped),
+ * stream data fills the requests in order.
+ */
+static void uring_deliver(int peer) {
+   struct ng_reqqueue *q = &module_data.recvq[peer];
+   struct uring_chunk *chunk;
+   req_handle_t *nreq;
+   int bid, n;
+
+   while ((nreq = q->head) != NULL && (bid = module_data.chunk_head[peer]) >= 0) {
+      chunk = &module_data.chunks[bid];
+      if (module_data.udp) {
+         /* one datagram per request */
+         memcpy(nreq->buffer, module_data.pbufs + (size_t)bid * URING_PBUF_SIZE,
+                ng_min(chunk->len, nreq->size));
+         nreq->remaining_bytes = 0;
+         chunk->len = 0;
+      } else {
+         n = ng_min(chunk->len, nreq->remaining_bytes);
+         memcpy((char *)nreq->buffer + (nreq->size - nreq->remaining_bytes),
+                module_data.pbufs + (size_t)bid * URING_PBUF_SIZE + chunk->off, n);
+         chunk->off += n;
+         chunk->len -= n;
+         nreq->remaining_bytes -= n;
+      }
+      if (chunk->len == 0) {
+         module_data.chunk_head[peer] = chunk->next;
+         if (chunk->next < 0) module_data.chunk_tail[peer] = -1;
+         uring_recycle(bid);
+      }
+      if (nreq->remaining_bytes == 0) ng_reqqueue_pop(q);
+   }
+}
+
+/* submits the head of a queue unless it is in flight already */
+static int uring_start(int peer, int type) {
+   struct ng_reqqueue *q = uring_get_queue(peer, type);
+   struct io_uring_sqe *sqe;
+   req_handle_t *nreq;
+   char *busy;
+   char *buf;
+   int idx, len;
+
+   if (type == TYPE_RECV && module_data.multishot) {
+      uring_deliver(peer);
+      return 0;
+   }
+   busy = type == TYPE_RECV ? &module_data.recv_busy[peer] : &module_data.send_busy[peer];
+   if (*busy || (nreq = q->head) == NULL) return 0;
+
+   if ((sqe = uring_get_sqe()) == NULL) return -1;
+   if (module_data.udp) {
+      /* a datagram always goes as a whole */
+      buf = nreq->buffer;
+      len = nreq->size;
+   } else {
+      buf = (char *)nreq->buffer + (nreq->size - nreq->remaining_bytes);
+      len = nreq->remaining_bytes;
+   }
+   idx = len > 0 ? uring_fixed_index(buf, len) : -1;
+   sqe->fd        = module_data.peer_connections[peer];
+   sqe->addr      = (unsigned long)buf;
+   sqe->len       = len;
+   sqe->user_data = (unsigned long)nreq;
+   if (idx >= 0) {
+      /* read/write on the socket with the pinned pages */
+      sqe->opcode    = type == TYPE_RECV ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+      sqe->buf_index = idx;
+   } else {
+      sqe->opcode    = type == TYPE_RECV ? IORING_OP_RECV : IORING_OP_SEND;
+      /* let the kernel retry short stream transfers */
+      if (!module_data.udp) sqe->msg_flags = MSG_WAITALL;
+   }
+   uring_queue_sqe();
+   *busy = 1;
+   return 0;
+}
+
+/* handles the completion of a send or receive request */
+static int uring_complete(req_handle_t *nreq, int res) {
+   int peer = nreq->index;
+
+   if (nreq->type == TYPE_RECV) module_data.recv_busy[peer] = 0;
+   else module_data.send_busy[peer] = 0;
+
+   if (res < 0) {
+      if (res != -EAGAIN && res != -EINTR) {
+         ng_error("Mode uring %s peer %d failed: %s", nreq->type == TYPE_RECV ? "receive from" : "send to",
+                  peer, strerror(-res));
+         return -1;
+      }
+      /* nothing was transferred, submit the request again */
+      return uring_start(peer, nreq->type);
+   } else if (res == 0 && nreq->type == TYPE_RECV && !module_data.udp && nreq->remaining_bytes > 0) {
+      ng_error("Mode uring peer %d closed the connection", peer);
+      return -1;
+   }
+
+   /* a datagram is complete once it arrived (or was sent), stream data
+    * continues at the offset */
+   nreq->remaining_bytes -= res;
+   if ((module_data.udp && (res > 0 || nreq->size == 0)) || nreq->remaining_bytes <= 0) {
+      nreq->remaining_bytes = 0;
+      ng_reqqueue_pop(uring_get_queue(peer, nreq->type));
+   }
+   return uring_start(peer, nreq->type);
+}
+
+/* handles a completion of the multishot receive of peer */
+static int uring_complete_multishot(int peer, int res, unsigned flags) {
+   int bid;
+
+   if (!(flags & IORING_CQE_F_MORE) && module_data.armed[peer] == URING_ARMED)
+      module_data.armed[peer] = URING_IDLE;
+   if (res == -ENOBUFS) {
+      /* all provided buffers hold data - armed again when they drain */
+      ng_info(NG_VLEV2, "multishot receive of peer %d ran out of buffers", peer);
+      return 0;
+   }
+   if (res < 0) {
+      ng_error("Mode uring multishot receive from peer %d failed: %s", peer, strerror(-res));
+      return -1;
+   }
+   if (res == 0 && !module_data.udp) {
+      /* end of stream - the peer shut down */
+      module_data.armed[peer] = URING_CLOSED;
+      if (flags & IORING_CQE_F_BUFFER) {
+         module_data.pbuf_free--;
+         uring_recycle(flags >> IORING_CQE_BUFFER_SHIFT);
+      }
+      if (module_data.recvq[peer].head) {
+         ng_error("Mode uring peer %d closed the connection", peer);
+         return -1;
+      }
+      return 0;
+   }
+   if (!(flags & IORING_CQE_F_BUFFER)) return 0;
+
+   bid = flags >> IORING_CQE_BUFFER_SHIFT;
+   module_data.pbuf_free--;
+   module_data.chunks[bid].next = -1;
+   module_data.chunks[bid].off = 0;
+   module_data.chunks[bid].len = res;
+   if (module_data.chunk_tail[peer] >= 0) module_data.chunks[module_data.chunk_tail[peer]].next = bid;
+   else module_data.chunk_head[peer] = bid;
+   module_data.chunk_tail[peer] = bid;
+   uring_deliver(peer);
+   return 0;
+}
+
+/**
+ * Processes all completions in the CQ (no syscall).
+ *
+ * @return number of completions, < 0 on errors
+ */
+static int uring_reap(void) {
+   struct io_uring_cqe *cqe;
+   unsigned head, tail;
+   int n = 0, ret = 0;
+
+   head = *module_data.cq_head;
+   tail = __atomic_load_n(module_data.cq_tail, __ATOMIC_ACQUIRE);
+   while (head != tail && ret == 0) {
+      cqe = &module_data.cqes[head & *module_data.cq_mask];
+      if (cqe->user_data & URING_TAG_MULTISHOT)
+         ret = uring_complete_multishot((int)(cqe->user_data & ~URING_TAG_MULTISHOT), cqe->res, cqe->flags);
+      else
+         ret = uring_complete((req_handle_t *)(unsigned long)cqe->user_data, cqe->res);
+      head++;
+      n++;
+   }
+   __atomic_store_n(module_data.cq_head, head, __ATOMIC_RELEASE);
+   module_data.ncqes += n;
+   if (ret < 0) return ret;
+   return n;
+}
+
+/**
+ * The progress engine: submits new SQEs and processes completions.
+ * Waits for at least one completion if timeout is not 0.
+ *
+ * @return number of completions, < 0 on errors
+ */
+static int uring_progress(int timeout) {
+   int n;
+
+   if (uring_rearm() < 0 || uring_enter(0) < 0) return -1;
+   n = uring_reap();
+   if (n != 0 || timeout == 0) return n;
+   if (timeout > 0) {
+      /* io_uring_enter() can't time out the wait, the ring fd is
+       * readable as soon as a completion is there */
+      struct pollfd pfd = { .fd = module_data.ring_fd, .events = POLLIN };
+
+      if (poll(&pfd, 1, timeout) < 0 && errno != EINTR) {
+         ng_perror("Mode uring poll failed");
+         return -1;
+      }
+   } else if (uring_enter(1) < 0) {
+      return -1;
+   }
+   return uring_reap();
+}
+
+static int uring_post(int peer, int type, void *buffer, int size, NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = ng_reqpool_new(&module_data.reqpool, type, peer, buffer, size, req);
+   if (nreq == NULL) return -1;
+
+   /* empty datagrams are messages, empty stream transfers are not */
+   if (size > 0 || module_data.udp) {
+      if (size == 0) nreq->remaining_bytes = 1;
+      ng_reqqueue_push(uring_get_queue(peer, type), nreq);
+      if (uring_start(peer, type) < 0) return -1;
+   }
+   return uring_test(req);
+}
+
+static int uring_isendto(int dst, void *buffer, int size, NG_Request *req) {
+   return uring_post(dst, TYPE_SEND, buffer, size, req);
+}
+
+static int uring_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
+   return uring_post(src, TYPE_RECV, buffer, size, req);
+}
+
+static int uring_test(NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = (req_handle_t *)*req;
+   /* completed requests are back in the pool (like MPI_REQUEST_NULL) */
+   if (nreq == NULL)
+      return 0;
+
+   if (nreq->remaining_bytes > 0 && uring_progress(0) < 0) return -1;
+   return ng_reqpool_release(&module_data.reqpool, req);
+}
+
+/* waits in io_uring_enter (spins on the CQ with SQPOLL) until all
+ * requests are complete */
+static int uring_waitall(int count, NG_Request *reqs) {
+   return ng_reqpool_waitall(&module_data.reqpool, count, reqs, uring_progress,
+                             module_data.sqpoll ? 0 : -1, 0);
+}
+
+static int uring_testany(int count, NG_Request *reqs, int *index) {
+   return ng_reqpool_testany(&module_data.reqpool, count, reqs, index, uring_progress);
+}
+
+static int uring_sendto(int dst, void *buffer, int size) {
+   NG_Request req;
+
+   if (uring_isendto(dst, buffer, size, &req) < 0) return -1;
+   if (uring_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+static int uring_recvfrom(int src, void *buffer, int size) {
+   NG_Request req;
+
+   if (uring_irecvfrom(src, buffer, size, &req) < 0) return -1;
+   if (uring_waitall(1, &req) < 0) return -1;
+   return size;
+}
+
+/* creates the ring and maps the queues */
+static int uring_setup_ring(void) {
+   struct io_uring_params p;
+   unsigned *sq_array;
+   unsigned i;
+
+   memset(&p, 0, sizeof(p));
+   if (module_data.sqpoll) {
+      p.flags |= IORING_SETUP_SQPOLL;
+      p.sq_thread_idle = module_data.sqpoll;
+   }
+   module_data.ring_fd = syscall(__NR_io_uring_setup, module_data.depth, &p);
+   if (module_data.ring_fd < 0) {
+      ng_perror("Mode uring could not create a ring with %d entries", module_data.depth);
+      return 1;
+   }
+
+   module_data.sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+   module_data.cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+   if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      if (module_data.cq_ring_size > module_data.sq_ring_size) module_data.sq_ring_size = module_data.cq_ring_size;
+      module_data.cq_ring_size = module_data.sq_ring_size;
+   }
+   module_data.sq_ring = mmap(NULL, module_data.sq_ring_size, PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE, module_data.ring_fd, IORING_OFF_SQ_RING);
+   if (module_data.sq_ring == MAP_FAILED) {
+      ng_perror("Mode uring could not map the submission queue");
+      return 1;
+   }
+   if (p.features & IORING_FEAT_SINGLE_MMAP) {
+      module_data.cq_ring = module_data.sq_ring;
+   } else {
+      module_data.cq_ring = mmap(NULL, module_data.cq_ring_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, module_data.ring_fd, IORING_OFF_CQ_RING);
+      if (module_data.cq_ring == MAP_FAILED) {
+         ng_perror("Mode uring could not map the completion queue");
+         return 1;
+      }
+   }
+   module_data.sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+   module_data.sqes = mmap(NULL, module_data.sqes_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, module_data.ring_fd, IORING_OFF_SQES);
+   if (module_data.sqes == MAP_FAILED) {
+      ng_perror("Mode uring could not map the submission queue entries");
+      return 1;
+   }
+
+   module_data.sq_head = (unsigned *)((char *)module_data.sq_ring + p.sq_off.head);
+   module_data.sq_tail = (unsigned *)((char *)module_data.sq_ring + p.sq_off.tail);
+   module_data.sq_mask = (unsigned *)((char *)module_data.sq_ring + p.sq_off.ring_mask);
+   module_data.sq_flags = (unsigned *)((char *)module_data.sq_ring + p.sq_off.flags);
+   module_data.sq_entries = p.sq_entries;
+   module_data.sq_local_tail = *module_data.sq_tail;
+   /* SQE i always sits in slot i */
+   sq_array = (unsigned *)((char *)module_data.sq_ring + p.sq_off.array);
+   for (i = 0; i < p.sq_entries; i++) sq_array[i] = i;
+
+   module_data.cq_head = (unsigned *)((char *)module_data.cq_ring + p.cq_off.head);
+   module_data.cq_tail = (unsigned *)((char *)module_data.cq_ring + p.cq_off.tail);
+   module_data.cq_mask = (unsigned *)((char *)module_data.cq_ring + p.cq_off.ring_mask);
+   module_data.cqes = (struct io_uring_cqe *)((char *)module_data.cq_ring + p.cq_off.cqes);
+
+   ng_info(NG_VLEV1, "io_uring with %u SQ and %u CQ entries%s", p.sq_entries, p.cq_entries,
+           module_data.sqpoll ? " and SQ polling" : "");
+   return 0;
+}
+
+/* registers the provided buffer ring and arms the multishot receives */
+static int uring_setup_multishot(void) {
+   struct io_uring_buf_reg reg;
+   int i;
+
+   module_data.pbuf_ring_size = URING_PBUF_COUNT * sizeof(struct io_uring_buf);
+   module_data.pbuf_ring = mmap(NULL, module_data.pbuf_ring_size, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   module_data.pbufs = mmap(NULL, (size_t)URING_PBUF_COUNT * URING_PBUF_SIZE, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (module_data.pbuf_ring == MAP_FAILED || module_data.pbufs == MAP_FAILED) {
+      ng_perror("Mode uring could not allocate the provided buffers");
+      return 1;
+   }
+
+   memset(&reg, 0, sizeof(reg));
+   reg.ring_addr = (unsigned long)module_data.pbuf_ring;
+   reg.ring_entries = URING_PBUF_COUNT;
+   reg.bgid = URING_PBUF_GROUP;
+   if (syscall(__NR_io_uring_register, module_data.ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+      ng_perror("Mode uring could not register the provided buffer ring");
+      return 1;
+   }
+   module_data.pbuf_ring->tail = 0;
+   for (i = 0; i < URING_PBUF_COUNT; i++) uring_recycle(i);
+   module_data.armed = calloc(module_data.npeers, sizeof(char));
+
+   module_data.chunk_head = malloc(module_data.npeers * sizeof(int));
+   module_data.chunk_tail = malloc(module_data.npeers * sizeof(int));
+   for (i = 0; i < module_data.npeers; i++) {
+      module_data.chunk_head[i] = module_data.chunk_tail[i] = -1;
+      if (module_data.peer_connections[i] >= 0 && uring_arm(i) < 0) return 1;
+   }
+   ng_info(NG_VLEV1, "multishot receive with %d buffers of %d bytes", URING_PBUF_COUNT, URING_PBUF_SIZE);
+   return uring_enter(0) < 0;
+}
+
+/* module specific benchmark initialization */
+static int uring_init(struct ng_options *global_opts) {
+   int ret;
+
+   if (uring_setup_ring()) return 1;
+   ret = uring_setup_channels_MPI();
+   if (ret) return ret;
+
+   module_data.sendq = calloc(module_data.npeers, sizeof(struct ng_reqqueue));
+   module_data.recvq = calloc(module_data.npeers, sizeof(struct ng_reqqueue));
+   module_data.send_busy = calloc(module_data.npeers, sizeof(char));
+   module_data.recv_busy = calloc(module_data.npeers, sizeof(char));
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * module_data.npeers);
+
+   if (module_data.multishot) return uring_setup_multishot();
+   return 0;
+}
+
+/**
+ * Connects every pair of peers. TCP: all peers listen, peer i connects
+ * to peers (i+1) .. N-1 and sends its rank, then accepts the
+ * connections of the lower ranks. UDP: every peer binds one socket
+ * per peer, the addresses are exchanged with MPI_Alltoall and every
+ * socket is connected to its counterpart.
+ */
+static int uring_setup_channels_MPI() {
+#ifdef NG_MPI
+   const int peer_count = g_options.mpi_opts->worldsize;
+   const int rank = g_options.mpi_opts->worldrank;
+   struct sockaddr_in *addresses = malloc(peer_count * sizeof(struct sockaddr_in));
+   struct sockaddr_in *mine = calloc(peer_count, sizeof(struct sockaddr_in));
+   struct sockaddr_in addr;
+   socklen_t len;
+   int i, result, retries = 0, server = -1, peer;
+
+   module_data.npeers = peer_count;
+   module_data.peer_connections = malloc(sizeof(int) * peer_count);
+   for (i = 0; i < peer_count; i++) module_data.peer_connections[i] = -1;
+
+   if (module_data.udp) {
+      for (i = 0; i < peer_count; i++) {
+         if (i == rank) continue;
+         module_data.peer_connections[i] = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+         memset(&mine[i], 0, sizeof(struct sockaddr_in));
+         mine[i].sin_family = AF_INET;
+         mine[i].sin_addr = module_data.local_addr;
+         len = sizeof(struct sockaddr_in);
+         if (bind(module_data.peer_connections[i], (struct sockaddr *)&mine[i], len) < 0 ||
+             getsockname(module_data.peer_connections[i], (struct sockaddr *)&mine[i], &len) < 0) {
+            ng_perror("Mode uring could not bind UDP socket to %s", inet_ntoa(module_data.local_addr));
+            return 1;
+         }
+      }
+      /* addresses[i] is the socket peer i has for me */
+      if (MPI_Alltoall(mine, sizeof(struct sockaddr_in), MPI_CHAR,
+                       addresses, sizeof(struct sockaddr_in), MPI_CHAR,
+                       MPI_COMM_WORLD) != MPI_SUCCESS) {
+         ng_error("Could not distribute IP adresses.");
+         exit(1);
+      }
+      for (i = 0; i < peer_count; i++) {
+         if (i == rank) continue;
+         if (connect(module_data.peer_connections[i], (struct sockaddr *)&addresses[i],
+                     sizeof(struct sockaddr_in)) < 0) {
+            ng_perror("Mode uring could not connect UDP socket to %s:%d",
+                      inet_ntoa(addresses[i].sin_addr), ntohs(addresses[i].sin_port));
+            return 1;
+         }
+      }
+   } else {
+      server = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+      memset(&addr, 0, sizeof(struct sockaddr_in));
+      addr.sin_family = AF_INET;
+      addr.sin_addr = module_data.local_addr;
+      addr.sin_port = htons(module_data.port);
+      do {
+         result = bind(server, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
+         if (result < 0) {
+            /* try next port */
+            addr.sin_port = htons(++module_data.port);
+            ng_info(NG_VLEV1 | NG_VPALL, "Could not bind(), trying next port: %d", module_data.port);
+         }
+      } while ((result < 0) && (retries++ < 64));
+      if (result < 0 || listen(server, peer_count) < 0) {
+         ng_perror("Mode uring could not listen on %s:%d", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
+         return 1;
+      }
+
+      if (MPI_Allgather(&addr, sizeof(struct sockaddr_in), MPI_CHAR,
+                        addresses, sizeof(struct sockaddr_in), MPI_CHAR,
+                        MPI_COMM_WORLD) != MPI_SUCCESS) {
+         ng_error("Could not distribute IP adresses.");
+         exit(1);
+      }
+
+      /* the listen backlog takes the connections before we accept */
+      for (i = rank + 1; i < peer_count; i++) {
+         module_data.peer_connections[i] = socket(PF_INET, SOCK_STREAM, IPPROTO_TCP);
+         if (connect(module_data.peer_connections[i], (struct sockaddr *)&addresses[i],
+                     sizeof(struct sockaddr_in)) < 0 ||
+             send(module_data.peer_connections[i], &rank, sizeof(int), 0) != sizeof(int)) {
+            ng_perror("Mode uring could not connect socket to %s:%d",
+                      inet_ntoa(addresses[i].sin_addr), ntohs(addresses[i].sin_port));
+            return 1;
+         }
+      }
+      for (i = 0; i < rank; i++) {
+         int conn = accept(server, NULL, NULL);
+
+         if (conn < 0 || recv(conn, &peer, sizeof(int), MSG_WAITALL) != sizeof(int) ||
+             peer < 0 || peer >= rank) {
+            ng_perror("Mode uring could not accept connection");
+            return 1;
+         }
+         module_data.peer_connections[peer] = conn;
+      }
+      close(server);
+   }
+
+   free(addresses);
+   free(mine);
+
+   ng_info(NG_VLEV1, "Peer connections established.");
+
+   return 0;
+#else
+   return 1;
+#endif
+}
+
+/* module specific shutdown */
+static void uring_shutdown(struct ng_options *global_opts) {
+   int i;
+
+   if (module_data.nsqes > 0) {
+      ng_info(NG_VLEV1, "uring: %llu io_uring_enter calls for %llu submissions and %llu completions",
+              module_data.nenter, module_data.nsqes, module_data.ncqes);
+   }
+
+   /* the ring goes first - it cancels the outstanding operations */
+   if (module_data.ring_fd > 0) {
+      close(module_data.ring_fd);
+      if (module_data.sqes) munmap(module_data.sqes, module_data.sqes_size);
+      if (module_data.cq_ring && module_data.cq_ring != module_data.sq_ring)
+         munmap(module_data.cq_ring, module_data.cq_ring_size);
+      if (module_data.sq_ring) munmap(module_data.sq_ring, module_data.sq_ring_size);
+      /* buffers freed later are no longer registered */
+      module_data.ring_fd = 0;
+      module_data.nfixed = module_data.registered = 0;
+   }
+   if (module_data.peer_connections) {
+      for (i = 0; i < module_data.npeers; i++) {
+         if (module_data.peer_connections[i] >= 0) close(module_data.peer_connections[i]);
+      }
+      free(module_data.peer_connections);
+   }
+   if (module_data.pbufs) {
+      munmap(module_data.pbuf_ring, module_data.pbuf_ring_size);
+      munmap(module_data.pbufs, (size_t)URING_PBUF_COUNT * URING_PBUF_SIZE);
+   }
+
+   ng_reqpool_destroy(&module_data.reqpool);
+   free(module_data.sendq);
+   free(module_data.recvq);
+   free(module_data.send_busy);
+   free(module_data.recv_busy);
+   free(module_data.chunk_head);
+   free(module_data.chunk_tail);
+   free(module_data.armed);
+}
+
+/* module specific manpage information */
+static void uring_writemanpage(void) {
+   int i;
+
+   for (i=0; long_options_uring[i].name != NULL; i++) {
+      ng_manpage_module(
+         long_options_uring[i].val,
+         long_options_uring[i].name,
+         long_option_infos_uring[i].desc,
+         long_option_infos_uring[i].param
+      );
+   }
+}
+
+/* module specific usage information */
+static void uring_usage(void) {
+   int i;
+
+   for (i=0; long_options_uring[i].name != NULL; i++) {
+      ng_longoption_usage(
+         long_options_uring[i].val,
+         long_options_uring[i].name,
+         long_option_infos_uring[i].desc,
+         long_option_infos_uring[i].param
+      );
+   }
+}
+
+
+/* module registration */
+int register_uring(void) {
+   ng_register_module(&uring_module);
+   return 0;
+}
+#else
+
+/* dummy module registration */
+int register_uring(void) {
+   return 0;
+}
+
+#endif
@@ -0,0 +1,836 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+
+#include "netgauge.h"
+#if defined NG_MOD_XDP && !(defined HAVE_LINUX_IF_XDP_H && defined HAVE_LINUX_BPF_H)
+#error "mode xdp needs linux/if_xdp.h and linux/bpf.h"
+#endif
+#ifdef NG_MOD_XDP
+
+#include "eth_helpers.h"
+#include "ng_reqpool.h"
+#include "hrtimer/hrtimer.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <linux/if_ether.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/bpf.h>
+#include <getopt.h> /* getopt long */
+
+#define XDP_DEFAULT_ETHER_TYPE 0x8888
+/* umem frames - the first half is for rx, the second for tx */
+#define XDP_NUM_FRAMES 4096
+/* entries of each of the four rings */
+#define XDP_RING_SIZE 2048
+
+/* extern stuff */
+extern struct ng_options g_options;
+
+/* function prototypes */
+static int xdp_sendto(int dst, void *buffer, int size);
+static int xdp_recvfrom(int src, void *buffer, int size);
+static int xdp_init(struct ng_options *global_opts);
+static int xdp_getopt(int argc, char **argv, struct ng_options *global_opts);
+static void xdp_writemanpage(void);
+static void xdp_usage(void);
+static void xdp_shutdown(struct ng_options *global_opts);
+static int xdp_isendto(int dst, void *buffer, int size, NG_Request *req);
+static int xdp_irecvfrom(int src, void *buffer, int size, NG_Request *req);
+static int xdp_test(NG_Request *req);
+static int xdp_stats(long size, char *buf, int len);
+
+/* module registration data structure (AF_XDP) */
+struct ng_module xdp_module = {
+   .name         = "xdp",
+   .desc         = "Mode xdp sends raw ethernet frames through an AF_XDP socket.",
+   .flags        = 0,
+   .max_datasize = 65535 - ETH_HLEN,
+   .headerlen    = 0,         /*  no extra space needed for header */
+   .malloc       = NULL,
+   .getopt       = xdp_getopt,
+   .init         = xdp_init,
+   .shutdown     = xdp_shutdown,
+   .usage        = xdp_usage,
+   .writemanpage = xdp_writemanpage,
+   .sendto       = xdp_sendto,
+   .recvfrom     = xdp_recvfrom,
+   .isendto      = xdp_isendto,
+   .irecvfrom    = xdp_irecvfrom,
+   .test         = xdp_test,
+   .stats        = xdp_stats,
+};
+
+/**
+ * getopt long options for xdp
+ */
+static struct option long_options_xdp[]={
+   {"interface", required_argument, 0, 'I'},
+   {"protocol", required_argument, 0, 'P'},
+   {"queue", required_argument, 0, 'Q'},
+   {"attach", required_argument, 0, 'A'},
+   {"zerocopy", required_argument, 0, 'Z'},
+   {"batch", required_argument, 0, 'K'},
+   {"yield", required_argument, 0, 'Y'},
+   {0, 0, 0, 0}
+};
+
+/**
+ * array of descriptions for xdp
+ */
+static struct option_info long_option_infos_xdp[]={
+   {"network interface to use", "NAME"},
+   {"ethernet frame protocol field value", "VALUE"},
+   {"receive queue of the interface (default: 0)", "ID"},
+   {"attach the XDP program in generic (skb) or driver mode (default: skb)", "skb|drv"},
+   {"umem mode (default: auto - zero-copy if the driver can)", "copy|zerocopy|auto"},
+   {"tx frames queued before the kernel is kicked (default: 32)", "FRAMES"},
+   {"sched_yield() while polling (default: if there are more ranks than cores)", "on|off"},
+   {0, 0}
+};
+
+/* producer/consumer ring shared with the kernel */
+struct xdp_ring {
+   uint32_t *producer, *consumer, *flags;
+   void *desc;
+   void *map;
+   size_t map_size;
+   /** local copy of the index we advance */
+   uint32_t cached;
+};
+
+/* frames of one direction since the last report */
+struct xdp_stat {
+   unsigned long frames, first_frames;
+   HRT_TIMESTAMP_T first, last;
+};
+
+/* module private data */
+struct xdp_private_data {
+   char *interface;
+   unsigned short protocol;
+   int queue;
+   int attach_flags;
+   int bind_flags;
+   unsigned int tx_batch;
+   /** sched_yield() when idle, -1 decides at init */
+   int yield;
+   unsigned int ifindex, mtu;
+   int sock, map_fd, prog_fd, link_fd;
+   struct ether_addr local_addr, *addresses;
+   /** the packet buffers shared with the kernel */
+   char *umem;
+   unsigned int frame_size;
+   struct xdp_ring fill, comp, rx, tx;
+   /** free tx frames */
+   uint64_t *tx_free;
+   int tx_nfree;
+   /** frames queued and frames handed to the kernel so far */
+   unsigned int tx_queued, tx_kicked;
+   /** posted receive and bytes that came without one, per peer */
+   req_handle_t **requests;
+   unsigned int *rcvd_bytes;
+   int rx_last;
+   /** statistics */
+   struct xdp_stat tx_stat, rx_stat;
+   unsigned long kicks;
+   /** preallocated handles for isendto/irecvfrom */
+   struct ng_reqpool reqpool;
+};
+
+static struct xdp_private_data module_data;
+
+
+/* parse command line parameters for module-specific options */
+static int xdp_getopt(int argc, char **argv, struct ng_options *global_opts) {
+   int c;
+
+   char *optchars = "I:P:Q:A:Z:K:Y:";  /*  additional module options */
+
+   extern char *optarg;
+   int option_index = 0;
+   extern int optind, opterr, optopt;
+
+   int failure = 0;
+
+   /*  initialize module private information data structure */
+   memset(&module_data, 0, sizeof(module_data));
+   module_data.protocol = XDP_DEFAULT_ETHER_TYPE;
+   module_data.attach_flags = XDP_FLAGS_SKB_MODE;
+   module_data.tx_batch = 32;
+   module_data.yield = -1;
+   module_data.sock = module_data.map_fd = module_data.prog_fd = module_data.link_fd = -1;
+
+   /*  parse module-options */
+   while((c=getopt_long(argc, argv, optchars, long_options_xdp, &option_index))
+         >= 0 ) {
+      switch( c ) {
+      case '?':  /* unrecognized or badly used option */
+         if (!strchr(optchars, optopt))
+            continue;  /* unrecognized */
+         ng_error("Option %c requires an argument", optopt);
+         failure = 1;
+         break;
+      case 'I':  /* network interface */
+         module_data.interface = optarg;
+         break;
+      case 'P':  /* ethernet packet type */
+         module_data.protocol = atoi(optarg);
+         break;
+      case 'Q':  /* receive queue */
+         module_data.queue = atoi(optarg);
+         break;
+      case 'A':  /* XDP attach mode */
+         if (strcmp(optarg, "skb") == 0) module_data.attach_flags = XDP_FLAGS_SKB_MODE;
+         else if (strcmp(optarg, "drv") == 0) module_data.attach_flags = XDP_FLAGS_DRV_MODE;
+         else {
+            ng_error("Option -A expects skb or drv");
+            failure = 1;
+         }
+         break;
+      case 'Z':  /* umem mode */
+         if (strcmp(optarg, "copy") == 0) module_data.bind_flags = XDP_COPY;
+         else if (strcmp(optarg, "zerocopy") == 0) module_data.bind_flags = XDP_ZEROCOPY;
+         else if (strcmp(optarg, "auto") == 0) module_data.bind_flags = 0;
+         else {
+            ng_error("Option -Z expects copy, zerocopy or auto");
+            failure = 1;
+         }
+         break;
+      case 'K':  /* tx kick batch */
+         if (atoi(optarg) < 1) {
+            ng_error("Option -K needs at least 1 frame");
+            failure = 1;
+         } else module_data.tx_batch = atoi(optarg);
+         break;
+      case 'Y':  /* yield when idle */
+         if (strcmp(optarg, "on") == 0) module_data.yield = 1;
+         else if (strcmp(optarg, "off") == 0) module_data.yield = 0;
+         else {
+            ng_error("Option -Y expects on or off");
+            failure = 1;
+         }
+         break;
+      }
+   }
+
+   if (!failure && !module_data.interface) {
+      ng_error("No interface given for mode %s - use option -I", xdp_module.name);
+      failure = 1;
+   }
+   if (!failure && !global_opts->mpi) {
+      ng_error("Mode xdp needs MPI to exchange the ethernet addresses");
+      failure = 1;
+   }
+
+   /*  report success or failure */
+   return failure;
+}
+
+static int xdp_bpf(int cmd, union bpf_attr *attr) {
+   return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+#define XDP_INSN(c, d, s, o, i) \
+   ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+
+/**
+ * Loads and attaches a program that redirects frames of our protocol
+ * to the socket in the XSKMAP and passes everything else to the stack:
+ *
+ *   if (data + ETH_HLEN > data_end || eth->h_proto != proto) return XDP_PASS;
+ *   return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+ *
+ * The XSKMAP only has an entry for the bound queue, our frames that
+ * arrive on other queues go to the stack as well (see xdp_rx_queues).
+ */
+static int xdp_load_program(void) {
+   union bpf_attr attr;
+   char log[4096];
+   struct bpf_insn prog[] = {
+      XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_6, BPF_REG_1, 0, 0),
+      XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data), 0),
+      XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end), 0),
+      XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_X, BPF_REG_4, BPF_REG_2, 0, 0),
+      XDP_INSN(BPF_ALU64 | BPF_ADD | BPF_K, BPF_REG_4, 0, 0, ETH_HLEN),
+      XDP_INSN(BPF_JMP | BPF_JGT | BPF_X, BPF_REG_4, BPF_REG_3, 8, 0),
+      XDP_INSN(BPF_LDX | BPF_MEM | BPF_H, BPF_REG_4, BPF_REG_2, offsetof(struct ethhdr, h_proto), 0),
+      XDP_INSN(BPF_JMP | BPF_JNE | BPF_K, BPF_REG_4, 0, 6, htons(module_data.protocol)),
+      XDP_INSN(BPF_LDX | BPF_MEM | BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index), 0),
+      XDP_INSN(BPF_LD | BPF_DW | BPF_IMM, BPF_REG_1, BPF_PSEUDO_MAP_FD, 0, module_data.map_fd),
+      XDP_INSN(0, 0, 0, 0, 0),
+      XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_3, 0, 0, XDP_PASS),
+      XDP_INSN(BPF_JMP | BPF_CALL, 0, 0, 0, BPF_FUNC_redirect_map),
+      XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+      XDP_INSN(BPF_ALU64 | BPF_MOV | BPF_K, BPF_REG_0, 0, 0, XDP_PASS),
+      XDP_INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0),
+   };
+
+   memset(&attr, 0, sizeof(attr));
+   attr.map_type = BPF_MAP_TYPE_XSKMAP;
+   attr.key_size = sizeof(int);
+   attr.value_size = sizeof(int);
+   attr.max_entries = module_data.queue + 1;
+   module_data.map_fd = xdp_bpf(BPF_MAP_CREATE, &attr);
+   if (module_data.map_fd < 0) {
+      ng_perror("Mode %s could not create the XSKMAP", xdp_module.name);
+      return 1;
+   }
+   prog[9].imm = module_data.map_fd;
+
+   memset(&attr, 0, sizeof(attr));
+   log[0] = '\0';
+   attr.prog_type = BPF_PROG_TYPE_XDP;
+   attr.expected_attach_type = BPF_XDP;
+   attr.insns = (uintptr_t)prog;
+   attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+   attr.license = (uintptr_t)"Dual BSD/GPL";
+   attr.log_buf = (uintptr_t)log;
+   attr.log_size = sizeof(log);
+   attr.log_level = 1;
+   module_data.prog_fd = xdp_bpf(BPF_PROG_LOAD, &attr);
+   if (module_data.prog_fd < 0) {
+      ng_perror("Mode %s could not load the XDP program", xdp_module.name);
+      ng_error("%s", log);
+      return 1;
+   }
+
+   /* the link goes away with us */
+   memset(&attr, 0, sizeof(attr));
+   attr.link_create.prog_fd = module_data.prog_fd;
+   attr.link_create.target_ifindex = module_data.ifindex;
+   attr.link_create.attach_type = BPF_XDP;
+   attr.link_create.flags = module_data.attach_flags;
+   module_data.link_fd = xdp_bpf(BPF_LINK_CREATE, &attr);
+   if (module_data.link_fd < 0) {
+      ng_perror("Mode %s could not attach the XDP program to %s in %s mode", xdp_module.name,
+                module_data.interface, module_data.attach_flags == XDP_FLAGS_SKB_MODE ? "skb" : "drv");
+      return 1;
+   }
+   return 0;
+}
+
+/* maps one of the four rings */
+static int xdp_map_ring(struct xdp_ring *ring, struct xdp_ring_offset *off, off_t pgoff, size_t entry) {
+   ring->map_size = off->desc + XDP_RING_SIZE * entry;
+   ring->map = mmap(NULL, ring->map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, module_data.sock, pgoff);
+   if (ring->map == MAP_FAILED) {
+      ring->map = NULL;
+      ng_perror("Mode %s could not map a ring", xdp_module.name);
+      return 1;
+   }
+   ring->producer = (uint32_t *)((char *)ring->map + off->producer);
+   ring->consumer = (uint32_t *)((char *)ring->map + off->consumer);
+   ring->flags = (uint32_t *)((char *)ring->map + off->flags);
+   ring->desc = (char *)ring->map + off->desc;
+   return 0;
+}
+
+/* registers the umem, creates and maps the rings and binds the socket */
+static int xdp_setup_socket(void) {
+   struct xdp_umem_reg reg;
+   struct xdp_mmap_offsets off;
+   struct sockaddr_xdp sxdp;
+   struct xdp_options opts;
+   socklen_t optlen;
+   int size = XDP_RING_SIZE, i;
+   uint64_t *fill;
+
+   module_data.sock = socket(AF_XDP, SOCK_RAW, 0);
+   if (module_data.sock < 0) {
+      ng_perror("Mode %s could not create an AF_XDP socket", xdp_module.name);
+      return 1;
+   }
+
+   if (posix_memalign((void **)&module_data.umem, sysconf(_SC_PAGESIZE), (size_t)XDP_NUM_FRAMES * module_data.frame_size)) {
+      ng_error("Mode %s could not allocate the umem", xdp_module.name);
+      return 1;
+   }
+   memset(&reg, 0, sizeof(reg));
+   reg.addr = (uintptr_t)module_data.umem;
+   reg.len = (uint64_t)XDP_NUM_FRAMES * module_data.frame_size;
+   reg.chunk_size = module_data.frame_size;
+   if (setsockopt(module_data.sock, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0 ||
+       setsockopt(module_data.sock, SOL_XDP, XDP_UMEM_FILL_RING, &size, sizeof(size)) < 0 ||
+       setsockopt(module_data.sock, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size, sizeof(size)) < 0 ||
+       setsockopt(module_data.sock, SOL_XDP, XDP_RX_RING, &size, sizeof(size)) < 0 ||
+       setsockopt(module_data.sock, SOL_XDP, XDP_TX_RING, &size, sizeof(size)) < 0) {
+      ng_perror("Mode %s could not set up the umem and its rings", xdp_module.name);
+      return 1;
+   }
+
+   optlen = sizeof(off);
+   if (getsockopt(module_data.sock, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+      ng_perror("Mode %s could not get the ring offsets", xdp_module.name);
+      return 1;
+   }
+   if (xdp_map_ring(&module_data.fill, &off.fr, XDP_UMEM_PGOFF_FILL_RING, sizeof(uint64_t)) ||
+       xdp_map_ring(&module_data.comp, &off.cr, XDP_UMEM_PGOFF_COMPLETION_RING, sizeof(uint64_t)) ||
+       xdp_map_ring(&module_data.rx, &off.rx, XDP_PGOFF_RX_RING, sizeof(struct xdp_desc)) ||
+       xdp_map_ring(&module_data.tx, &off.tx, XDP_PGOFF_TX_RING, sizeof(struct xdp_desc)))
+      return 1;
+
+   /* the first half of the frames waits for packets, the second for sends */
+   fill = module_data.fill.desc;
+   for (i = 0; i < XDP_NUM_FRAMES / 2; i++)
+      fill[i] = (uint64_t)i * module_data.frame_size;
+   module_data.fill.cached = XDP_NUM_FRAMES / 2;
+   __atomic_store_n(module_data.fill.producer, module_data.fill.cached, __ATOMIC_RELEASE);
+   module_data.tx_free = malloc(XDP_NUM_FRAMES / 2 * sizeof(uint64_t));
+   for (i = 0; i < XDP_NUM_FRAMES / 2; i++)
+      module_data.tx_free[module_data.tx_nfree++] = (uint64_t)(XDP_NUM_FRAMES / 2 + i) * module_data.frame_size;
+
+   memset(&sxdp, 0, sizeof(sxdp));
+   sxdp.sxdp_family = AF_XDP;
+   sxdp.sxdp_ifindex = module_data.ifindex;
+   sxdp.sxdp_queue_id = module_data.queue;
+   sxdp.sxdp_flags = module_data.bind_flags | XDP_USE_NEED_WAKEUP;
+   if (bind(module_data.sock, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+      ng_perror("Mode %s could not bind to %s queue %d", xdp_module.name, module_data.interface, module_data.queue);
+      return 1;
+   }
+
+   optlen = sizeof(opts);
+   memset(&opts, 0, sizeof(opts));
+   getsockopt(module_data.sock, SOL_XDP, XDP_OPTIONS, &opts, &optlen);
+   ng_info(NG_VLEV1 | NG_VPALL, "AF_XDP socket on %s queue %d in %s mode, %d frames of %u bytes",
+           module_data.interface, module_data.queue,
+           opts.flags & XDP_OPTIONS_ZEROCOPY ? "zero-copy" : "copy", XDP_NUM_FRAMES, module_data.frame_size);
+   return 0;
+}
+
+/* counts frames for the statistics, the first batch only starts the clock */
+static void xdp_count(struct xdp_stat *st, unsigned long frames) {
+   if (st->frames == 0) {
+      HRT_GET_TIMESTAMP(st->first);
+      st->first_frames = frames;
+   }
+   HRT_GET_TIMESTAMP(st->last);
+   st->frames += frames;
+}
+
+/* frames/s from the first to the last batch */
+static double xdp_rate(struct xdp_stat *st) {
+   unsigned long long ticks;
+   double usecs;
+
+   HRT_GET_ELAPSED_TICKS(st->first, st->last, &ticks);
+   usecs = HRT_GET_USEC(ticks);
+   return usecs > 0 ? (st->frames - st->first_frames) * 1e6 / usecs : 0.0;
+}
+
+/* hands the queued tx descriptors to the kernel */
+static void xdp_kick(void) {
+   if (module_data.tx_kicked == module_data.tx_queued) return;
+   xdp_count(&module_data.tx_stat, module_data.tx_queued - module_data.tx_kicked);
+   module_data.tx_kicked = module_data.tx_queued;
+   if (!(__atomic_load_n(module_data.tx.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)) return;
+   if (sendto(module_data.sock, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 &&
+       errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN)
+      ng_perror("Mode %s could not kick the tx ring", xdp_module.name);
+   module_data.kicks++;
+}
+
+/* takes the sent frames back from the completion ring */
+static void xdp_reclaim(void) {
+   uint64_t *comp = module_data.comp.desc;
+   uint32_t prod = __atomic_load_n(module_data.comp.producer, __ATOMIC_ACQUIRE);
+
+   while (module_data.comp.cached != prod)
+      module_data.tx_free[module_data.tx_nfree++] = comp[module_data.comp.cached++ & (XDP_RING_SIZE - 1)];
+   __atomic_store_n(module_data.comp.consumer, module_data.comp.cached, __ATOMIC_RELEASE);
+}
+
+/* builds frames to dst from buffer in free tx frames, returns the bytes queued */
+static int xdp_queue(int dst, char *buffer, int size) {
+   struct xdp_desc *desc = module_data.tx.desc;
+   struct ethhdr *eth;
+   uint64_t addr;
+   int n, queued = 0;
+
+   xdp_reclaim();
+   while (queued < size) {
+      if (module_data.tx_nfree == 0 ||
+          module_data.tx.cached - __atomic_load_n(module_data.tx.consumer, __ATOMIC_ACQUIRE) >= XDP_RING_SIZE) {
+         /* out of frames - let the kernel send some */
+         xdp_kick();
+         break;
+      }
+      addr = module_data.tx_free[--module_data.tx_nfree];
+      eth = (struct ethhdr *)(module_data.umem + addr);
+      memcpy(eth->h_dest, &module_data.addresses[dst], ETH_ALEN);
+      memcpy(eth->h_source, &module_data.local_addr, ETH_ALEN);
+      eth->h_proto = htons(module_data.protocol);
+      n = ng_min(size - queued, (int)module_data.mtu);
+      memcpy(eth + 1, buffer + queued, n);
+
+      desc[module_data.tx.cached & (XDP_RING_SIZE - 1)].addr = addr;
+      desc[module_data.tx.cached & (XDP_RING_SIZE - 1)].len = ETH_HLEN + n;
+      desc[module_data.tx.cached & (XDP_RING_SIZE - 1)].options = 0;
+      module_data.tx.cached++;
+      __atomic_store_n(module_data.tx.producer, module_data.tx.cached, __ATOMIC_RELEASE);
+      module_data.tx_queued++;
+      queued += n;
+      if (module_data.tx_queued - module_data.tx_kicked >= module_data.tx_batch)
+         xdp_kick();
+   }
+   return queued;
+}
+
+/* the rank with the source address of a received frame */
+static int xdp_src(struct ethhdr *eth) {
+   int i;
+
+   if (!memcmp(eth->h_source, &module_data.addresses[module_data.rx_last], ETH_ALEN))
+      return module_data.rx_last;
+   for (i = 0; i < g_options.mpi_opts->worldsize; i++) {
+      if (!memcmp(eth->h_source, &module_data.addresses[i], ETH_ALEN))
+         return module_data.rx_last = i;
+   }
+   return -1;
+}
+
+/* hands the received frames to the posted receive of their sender (or
+ * counts them for later like mode eth) and refills the fill ring */
+static int xdp_poll(void) {
+   struct xdp_desc *desc = module_data.rx.desc;
+   uint64_t *fill = module_data.fill.desc;
+   uint32_t prod, frames;
+   req_handle_t *nreq;
+   struct xdp_desc *d;
+   struct ethhdr *eth;
+   int src, len, n;
+
+   prod = __atomic_load_n(module_data.rx.producer, __ATOMIC_ACQUIRE);
+   frames = prod - module_data.rx.cached;
+   if (frames == 0) {
+      /* the driver may sleep until we refill */
+      if (__atomic_load_n(module_data.fill.flags, __ATOMIC_RELAXED) & XDP_RING_NEED_WAKEUP)
+         recvfrom(module_data.sock, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+      return 0;
+   }
+
+   while (module_data.rx.cached != prod) {
+      d = &desc[module_data.rx.cached++ & (XDP_RING_SIZE - 1)];
+      eth = (struct ethhdr *)(module_data.umem + d->addr);
+      len = d->len - ETH_HLEN;
+      src = len >= 0 ? xdp_src(eth) : -1;
+      if (src >= 0) {
+         nreq = module_data.requests[src];
+         if (nreq && nreq->remaining_bytes > 0) {
+            n = ng_min(len, nreq->remaining_bytes);
+            memcpy((char *)nreq->buffer + nreq->size - nreq->remaining_bytes, eth + 1, n);
+            nreq->remaining_bytes -= n;
+         } else {
+            module_data.rcvd_bytes[src] += len;
+         }
+      }
+      /* back to the kernel - the frame starts at its chunk */
+      fill[module_data.fill.cached++ & (XDP_RING_SIZE - 1)] = d->addr & ~(uint64_t)(module_data.frame_size - 1);
+   }
+   __atomic_store_n(module_data.rx.consumer, module_data.rx.cached, __ATOMIC_RELEASE);
+   __atomic_store_n(module_data.fill.producer, module_data.fill.cached, __ATOMIC_RELEASE);
+
+   xdp_count(&module_data.rx_stat, frames);
+   return frames;
+}
+
+/* receives counted earlier go to the new receive first */
+static void xdp_post_recv(int src, req_handle_t *rreq) {
+   int n = ng_min(module_data.rcvd_bytes[src], (unsigned int)rreq->remaining_bytes);
+
+   module_data.rcvd_bytes[src] -= n;
+   rreq->remaining_bytes -= n;
+   module_data.requests[src] = rreq;
+}
+
+static int xdp_isendto(int dst, void *buffer, int size, NG_Request *req) {
+   req_handle_t *sreq;
+   int ret;
+
+   sreq = ng_reqpool_get(&module_data.reqpool);
+   if (sreq == NULL) return -1;
+   sreq->type = TYPE_SEND;
+   sreq->index = dst;
+   sreq->buffer = buffer;
+   sreq->size = size;
+   sreq->remaining_bytes = size;
+   *req = (NG_Request *) sreq;
+
+   /* only queue the frames, xdp_test() kicks the kernel */
+   ret = xdp_queue(dst, buffer, size);
+   sreq->remaining_bytes -= ret;
+   sreq->seq = module_data.tx_queued;
+   return ret;
+}
+
+static int xdp_irecvfrom(int src, void *buffer, int size, NG_Request *req) {
+   req_handle_t *rreq;
+
+   rreq = ng_reqpool_get(&module_data.reqpool);
+   if (rreq == NULL) return -1;
+   rreq->type = TYPE_RECV;
+   rreq->index = src;
+   rreq->buffer = buffer;
+   rreq->size = size;
+   rreq->remaining_bytes = size;
+   *req = (NG_Request *) rreq;
+   xdp_post_recv(src, rreq);
+   return 0;
+}
+
+/* sends are done once their frames are with the kernel, receives are
+ * filled by xdp_poll() */
+static int xdp_test(NG_Request *req) {
+   req_handle_t *nreq;
+
+   nreq = (req_handle_t *)*req;
+   /* completed requests are back in the pool (like MPI_REQUEST_NULL) */
+   if (nreq == NULL)
+      return 0;
+
+   if (nreq->type == TYPE_RECV) {
+      if (nreq->remaining_bytes > 0) {
+         xdp_kick();
+         if (xdp_poll() == 0 && module_data.yield) sched_yield();
+         if (nreq->remaining_bytes > 0)
+            return nreq->remaining_bytes;
+      }
+      if (module_data.requests[nreq->index] == nreq)
+         module_data.requests[nreq->index] = NULL;
+   } else {
+      if (nreq->remaining_bytes > 0) {
+         nreq->remaining_bytes -= xdp_queue(nreq->index, (char *)nreq->buffer + nreq->size - nreq->remaining_bytes,
+                                            nreq->remaining_bytes);
+         nreq->seq = module_data.tx_queued;
+         if (nreq->remaining_bytes > 0)
+            return nreq->remaining_bytes;
+      }
+      if ((int)(nreq->seq - module_data.tx_kicked) > 0)
+         xdp_kick();
+   }
+
+   /* done - release the request */
+   ng_reqpool_put(&module_data.reqpool, nreq);
+   *req = NULL;
+   return 0;
+}
+
+static int xdp_sendto(int dst, void *buffer, int size) {
+   int sent = 0;
+
+   while (sent < size) {
+      sent += xdp_queue(dst, (char *)buffer + sent, size - sent);
+      if (g_stop_tests) {
+         ng_error("sendto() interrupted at %d bytes", sent);
+         return -1;
+      }
+   }
+   xdp_kick();
+   return size;
+}
+
+static int xdp_recvfrom(int src, void *buffer, int size) {
+   req_handle_t rreq;
+
+   memset(&rreq, 0, sizeof(rreq));
+   rreq.buffer = buffer;
+   rreq.size = size;
+   rreq.remaining_bytes = size;
+   xdp_post_recv(src, &rreq);
+   /* nobody may wait for our frames while we wait */
+   xdp_kick();
+
+   while (rreq.remaining_bytes > 0) {
+      /* give the sender the core if we share it */
+      if (xdp_poll() == 0 && module_data.yield) sched_yield();
+      if (g_stop_tests) {
+         ng_error("recvfrom() interrupted at %d bytes", size - rreq.remaining_bytes);
+         module_data.requests[src] = NULL;
+         return -1;
+      }
+   }
+   module_data.requests[src] = NULL;
+   return size;
+}
+
+/* number of rx queues of the interface, -1 if unknown */
+static int xdp_rx_queues(void) {
+   char path[128];
+   struct dirent *d;
+   DIR *dir;
+   int n = 0;
+
+   snprintf(path, sizeof(path), "/sys/class/net/%s/queues", module_data.interface);
+   if ((dir = opendir(path)) == NULL) return -1;
+   while ((d = readdir(dir)) != NULL) {
+      if (strncmp(d->d_name, "rx-", 3) == 0) n++;
+   }
+   closedir(dir);
+   return n;
+}
+
+/* module specific benchmark initialization */
+static int xdp_init(struct ng_options *global_opts) {
+#ifdef NG_MPI
+   const int peer_count = g_options.mpi_opts->worldsize;
+   struct ifreq if_data;
+   union bpf_attr attr;
+   int fd, queues;
+
+   module_data.addresses = calloc(peer_count, sizeof(struct ether_addr));
+   module_data.requests = calloc(peer_count, sizeof(req_handle_t *));
+   module_data.rcvd_bytes = calloc(peer_count, sizeof(unsigned int));
+   /* one send and one receive per peer */
+   ng_reqpool_init(&module_data.reqpool, 2 * peer_count);
+
+   module_data.ifindex = if_nametoindex(module_data.interface);
+   if (module_data.ifindex == 0) {
+      ng_perror("Mode %s could not determine index of local interface %s", xdp_module.name, module_data.interface);
+      return 1;
+   }
+
+   /* AF_XDP sockets do not do interface ioctls */
+   fd = socket(AF_INET, SOCK_DGRAM, 0);
+   if (fd < 0 || get_if_addr(fd, module_data.interface, &module_data.local_addr)) {
+      ng_perror("Mode %s could not determine the address of %s", xdp_module.name, module_data.interface);
+      return 1;
+   }
+   memset(&if_data, 0, sizeof(if_data));
+   strncpy(if_data.ifr_name, module_data.interface, IF_NAMESIZE - 1);
+   if (ioctl(fd, SIOCGIFMTU, &if_data) < 0) {
+      ng_perror("Mode %s could not determine mtu of local interface %s", xdp_module.name, module_data.interface);
+      close(fd);
+      return 1;
+   }
+   close(fd);
+
+   /* a frame is a chunk with the kernel headroom in front */
+   module_data.frame_size = if_data.ifr_mtu + ETH_HLEN + XDP_PACKET_HEADROOM > 2048 ? 4096 : 2048;
+   module_data.mtu = ng_min(if_data.ifr_mtu, (int)(module_data.frame_size - XDP_PACKET_HEADROOM - ETH_HLEN));
+
+   if (xdp_setup_socket() || xdp_load_program())
+      return 1;
+   memset(&attr, 0, sizeof(attr));
+   attr.map_fd = module_data.map_fd;
+   attr.key = (uintptr_t)&module_data.queue;
+   attr.value = (uintptr_t)&module_data.sock;
+   if (xdp_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+      ng_perror("Mode %s could not put the socket into the XSKMAP", xdp_module.name);
+      return 1;
+   }
+   /* an AF_XDP socket serves one queue, frames of the others are lost */
+   if ((queues = xdp_rx_queues()) > 1) {
+      ng_info(NG_VNORM | NG_VPALL, "Mode %s: %s has %d rx queues but only queue %d is redirected - "
+              "steer the benchmark frames to it (ethtool -N/-L) or they are lost",
+              xdp_module.name, module_data.interface, queues, module_data.queue);
+   }
+
+   if (MPI_Allgather(&module_data.local_addr, sizeof(struct ether_addr), MPI_CHAR,
+                     module_data.addresses, sizeof(struct ether_addr), MPI_CHAR,
+                     MPI_COMM_WORLD) != MPI_SUCCESS) {
+      ng_error("Could not distribute ethernet address");
+      return 1;
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   if (module_data.yield < 0) module_data.yield = peer_count > sysconf(_SC_NPROCESSORS_ONLN);
+   return 0;
+#else
+   return 1;
+#endif
+}
+
+/**
+ * Formats the frames sent and received since the last call (the
+ * patterns call it after each size) and clears the counters.
+ */
+static int xdp_stats(long size, char *buf, int len) {
+   struct xdp_stat *tx = &module_data.tx_stat, *rx = &module_data.rx_stat;
+   int ret = 1;
+
+   if (tx->frames + rx->frames > 0) {
+      snprintf(buf, len, "frames sent %lu (%.0f frames/s, %lu kicks) received %lu (%.0f frames/s)",
+               tx->frames, xdp_rate(tx), module_data.kicks, rx->frames, xdp_rate(rx));
+      ret = 0;
+   }
+   memset(tx, 0, sizeof(*tx));
+   memset(rx, 0, sizeof(*rx));
+   module_data.kicks = 0;
+   return ret;
+}
+
+/* module specific shutdown */
+static void xdp_shutdown(struct ng_options *global_opts) {
+   if (module_data.link_fd >= 0) close(module_data.link_fd);
+   if (module_data.prog_fd >= 0) close(module_data.prog_fd);
+   if (module_data.map_fd >= 0) close(module_data.map_fd);
+   if (module_data.fill.map) munmap(module_data.fill.map, module_data.fill.map_size);
+   if (module_data.comp.map) munmap(module_data.comp.map, module_data.comp.map_size);
+   if (module_data.rx.map) munmap(module_data.rx.map, module_data.rx.map_size);
+   if (module_data.tx.map) munmap(module_data.tx.map, module_data.tx.map_size);
+   if (module_data.sock >= 0) close(module_data.sock);
+   free(module_data.umem);
+   free(module_data.tx_free);
+   free(module_data.addresses);
+   free(module_data.requests);
+   free(module_data.rcvd_bytes);
+   ng_reqpool_destroy(&module_data.reqpool);
+}
+
+/* module specific manpage information */
+static void xdp_writemanpage(void) {
+   int i;
+
+   for (i=0; long_options_xdp[i].name != NULL; i++) {
+      ng_manpage_module(
+         long_options_xdp[i].val,
+         long_options_xdp[i].name,
+         long_option_infos_xdp[i].desc,
+         long_option_infos_xdp[i].param
+      );
+   }
+}
+
+/* module specific usage information */
+static void xdp_usage(void) {
+   int i;
+
+   for (i=0; long_options_xdp[i].name != NULL; i++) {
+      ng_longoption_usage(
+         long_options_xdp[i].val,
+         long_options_xdp[i].name,
+         long_option_infos_xdp[i].desc,
+         long_option_infos_xdp[i].param
+      );
+   }
+}
+
+
+/* module registration */
+int register_xdp(void) {
+   ng_register_module(&xdp_module);
+   return 0;
+}
+#else
+
+/* dummy module registration */
+int register_xdp(void) {
+   return 0;
+}
+
+#endif
@@ -11,6 +11,9 @@
 #include "netgauge.h"
 #include "hrtimer/hrtimer.h"
 #include "netgauge_cmdline.h"
+#include "ng_calibrate.h"
+#include "ng_schedule.h"
+#include "ng_result.h"
 #include <signal.h>  /* signal interception */
 #include <string.h>  /* memset & co. */
 #include <stdarg.h>	/* variable arguments functions */
@@ -22,6 +25,11 @@
 
 double g_hrttimer_startvalue;
 unsigned long long g_timerfreq;
+#if HRT_ARCH==2
+int g_hrt_backend = HRT_BACKEND_LFENCE;
+UINT64_T g_hrt_overhead = 0;
+unsigned long g_hrt_migrations = 0;
+#endif
 
 /**
  * user supplied options
@@ -37,7 +45,6 @@ static struct option long_options[]={
 	{"writemanpage",           no_argument, 0, 'w'},
 	{"init-thread",            no_argument, 0, 'i'},
 	{"verbosity level",        no_argument, 0, 'v'},
-	{"nooutput",               no_argument, 0, 'n'},
 	{"output",           required_argument, 0, 'o'},
 	{"fulltestresults",  required_argument, 0, 'f'},
 	{"servermode",             no_argument, 0, 'a'},
@@ -47,6 +54,17 @@ static struct option long_options[]={
 	{"gradation",        required_argument, 0, 'g'},
 	{"sanity-check",     required_argument, 0, 'q'},
 	{"hostnames",     required_argument, 0, '-'},
+	{"format",           required_argument, 0, 'F'},
+	{"trace",            required_argument, 0, 'T'},
+	{"trace-records",    required_argument, 0, 'N'},
+	{"timer",            required_argument, 0, 'k'},
+	{"sizes",            required_argument, 0, 'z'},
+	{"adaptive",               no_argument, 0, 'y'},
+	{"ci-target",        required_argument, 0, 'e'},
+	{"ci-quantile",      required_argument, 0, 'j'},
+	{"min-tests",        required_argument, 0, 'l'},
+	{"budget",           required_argument, 0, 'b'},
+	{"warmup",           required_argument, 0, 'n'},
 	{"com_pattern",	   required_argument, 0, 'x'},
 	{"mode",             required_argument, 0, 'm'}, /* must be last entry! */
 	{0, 0, 0, 0}
@@ -63,7 +81,6 @@ static struct option_info long_option_infos[]={
   {"create a new manpage based on current code and print it to STDOUT", NULL},
   {"initialize with MPI_THREAD_MULTIPLE instead of MPI_THREAD_SINGLE", NULL},
   {"verbose output", NULL},
-  {"no output, but benchmark results", NULL},
   {"write output to this file", "FILENAME"},
   {"write all/full testresults to files begining with the given filename", "FILENAME"},
   {"operate in server mode", NULL},
@@ -73,6 +90,17 @@ static struct option_info long_option_infos[]={
   {"gradation of the geometrical data size growth", "GRADATION"},
   {"perform timer sanity check", NULL},
   {"print hostnames", NULL},
+  {"result format of the output file: text, csv, json or binary", "FORMAT"},
+  {"write every raw sample to the mmap'd trace file FILENAME.<rank>", "FILENAME"},
+  {"trace ring capacity in samples per rank (default 1048576)", "NUMBER"},
+  {"timer backend: auto, rdtsc, lfence, rdtscp or clock", "TIMER"},
+  {"comma separated list of message sizes (replaces -s/-g)", "BYTE,..."},
+  {"bisect between sizes where the latency slope changes (protocol switches)", NULL},
+  {"sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests)", "FRACTION"},
+  {"quantile for --ci-target (default 0.5 = median)", "QUANTILE"},
+  {"minimum number of tests per size with --ci-target (default 10)", "NUMBER"},
+  {"time budget per size (0 = none)", "MS"},
+  {"maximum number of warmup tests per size, ends early once the latency is steady (default 500)", "NUMBER"},
   {"communication pattern, defaults to \"one_one\". See list of available patterns below.", "NAME"},
   {"specifies the mode (required). For further information of available modes see list below.", "NAME"}
 };
@@ -99,7 +127,11 @@ unsigned char g_stop_tests;
 extern void register_tcp(void);
 extern void register_ip(void);
 extern void register_udp(void);
+extern void register_uring(void);
+extern void register_shm(void);
+extern void register_cma(void);
 extern void register_eth(void);
+extern void register_xdp(void);
 extern void register_enet_edp(void);
 extern void register_enet_esp(void);
 extern void register_mpi(void);
@@ -137,7 +169,11 @@ int main(int argc, char **argv) {
   register_dummy();    /* dummy module if no MPI is present */
   register_tcp();    /* internet protocol - transmission control protocol */
   register_udp();    /* internet protocol - user datagram protocol */
+  register_uring();    /* TCP/UDP sockets driven by io_uring */
+  register_shm();    /* shared memory between local ranks */
+  register_cma();    /* single copy between local ranks */
   register_eth();    /* raw ethernet */
+  register_xdp();    /* raw ethernet through AF_XDP */
   register_enet_edp();   /* ethernet protocol EDP */
   register_enet_esp();   /* ethernet protocol ESP */
   register_mpi();    /* mpi send/receive (no effect if NG_MPI is not defined) */
@@ -152,6 +188,9 @@ int main(int argc, char **argv) {
 
   /* register communication pattern modules */
   register_pattern_overlap();
+  register_pattern_loss();
+  register_pattern_msgrate();
+  register_pattern_stream();
   register_pattern_one_one();
   register_pattern_one_one_all();
   register_pattern_one_one_mpi_bidirect();
@@ -235,7 +274,10 @@ int main(int argc, char **argv) {
        (strstr(g_options.modeopts,  "--help")  == NULL) ) {
     /* initialize HR TIMER - only rank 0 prints */
     if(!g_options.mpi_opts->worldrank) {
+      int calib_source;
       HRT_INIT(1 /* print */, g_timerfreq);
+      ng_timer_calibrate(&calib_source);
+      printf("# timer frequency: %llu Hz (%s)\n", g_timerfreq, ng_timer_calibrate_source(calib_source));
       if(g_options.do_sanity_check) sanity_check(1 /* print */); 
     } else {
       HRT_INIT(0 /* print */, g_timerfreq);
@@ -336,6 +378,11 @@ int main(int argc, char **argv) {
    /* start the benchmarking using the selected module */
    pattern->do_benchmarks(module);
 
+#if HRT_ARCH==2
+   if(g_hrt_migrations > 0)
+     ng_info(NG_VNORM | NG_VPALL, "%lu measured intervals started and ended on different CPUs (rdtscp), the results may be skewed - consider pinning the ranks", g_hrt_migrations);
+#endif
+
   shutdown:
    /* clean up */
    if (module_was_init) {
@@ -561,6 +608,10 @@ int ng_get_options(int *argc, char ***argv, struct ng_options *options) {
    
   /* we have MPI on by default */
 	options->mpi = 1;
+#ifndef NG_MPI
+  /* client and server (-a) connect directly */
+  options->mpi = 0;
+#endif
 	options->mpi_opts = (struct ng_mpi_options *)calloc(1,sizeof(struct ng_mpi_options));
 	if (!options->mpi_opts) {
 	  ng_abort("Could not allocate memory for the MPI specific options");
@@ -597,6 +648,25 @@ int ng_get_options(int *argc, char ***argv, struct ng_options *options) {
   options->output_file = args_info.output_arg;
   /* detailed outfile name */
   options->full_output_file = args_info.full_output_arg;
+  /* result format */
+  options->result_format = ng_result_parse_format(args_info.format_arg);
+  if(options->result_format < 0) {
+    ng_error("unknown result format \"%s\" (text, csv, json or binary)", args_info.format_arg);
+    ng_exit(EXIT_FAILURE);
+  }
+  /* raw sample trace */
+  options->trace_file = args_info.trace_given ? args_info.trace_arg : NULL;
+  if(args_info.trace_records_arg < 1) {
+    ng_error("the trace needs room for at least one sample");
+    ng_exit(EXIT_FAILURE);
+  }
+  options->trace_records = args_info.trace_records_arg;
+  /* timer backend */
+  options->timer = args_info.timer_arg;
+  if(ng_timer_backend(options->timer)) {
+    ng_error("unknown or unsupported timer backend \"%s\" (auto, rdtsc, lfence, rdtscp or clock)", options->timer);
+    ng_exit(EXIT_FAILURE);
+  }
   /* testcount */
   options->testcount = args_info.tests_arg;
   /* testime */
@@ -606,6 +676,33 @@ int ng_get_options(int *argc, char ***argv, struct ng_options *options) {
   options->size_given = args_info.size_given;
   /* gradation */
   options->grad_datasize = args_info.grad_arg;
+  /* size schedule */
+  options->size_list = NULL;
+  options->size_count = 0;
+  if(args_info.sizes_given) {
+    if(ng_schedule_parse(args_info.sizes_arg, options)) {
+      ng_error("bad size list \"%s\" (expected comma separated sizes, e.g. 1,64,1500)", args_info.sizes_arg);
+      ng_exit(EXIT_FAILURE);
+    }
+    options->size_given = 1;
+  }
+  options->adaptive = args_info.adaptive_flag;
+  /* convergence based stopping */
+  options->ci_target = atof(args_info.ci_target_arg);
+  options->ci_quantile = atof(args_info.ci_quantile_arg);
+  if(options->ci_target < 0 || options->ci_quantile <= 0 || options->ci_quantile >= 1 ||
+     args_info.min_tests_arg < 2 || args_info.budget_arg < 0) {
+    ng_error("bad convergence options (--ci-target >= 0, 0 < --ci-quantile < 1, --min-tests >= 2, --budget >= 0)");
+    ng_exit(EXIT_FAILURE);
+  }
+  options->min_tests = args_info.min_tests_arg;
+  options->budget = args_info.budget_arg;
+  /* warmup detection */
+  options->warmup = args_info.warmup_arg;
+  if(options->warmup < 1) {
+    ng_error("there has to be at least one warmup test (--warmup)");
+    ng_exit(EXIT_FAILURE);
+  }
   /* sanity check? */
   options->do_sanity_check = args_info.sanity_check_flag;
   /* print hostname */
@@ -1075,22 +1172,14 @@ void get_next_testparams(long *data_size,
 			 struct ng_options *options, 
           struct ng_module *module) {
    
-   int max_datasize = ng_min(options->max_datasize, module->max_datasize);
-   
-   /* after the maximum size has been
-    * reached a negative value will be set
-    */
-   if (*data_size < max_datasize) {
-      int x, data_inc;
-      
-      frexp(*data_size * pow(0.5, options->grad_datasize-1), &x);
-      data_inc = pow(2.0, --x);
-      /* ensure a data size increment at least of 1 and
-       * at most of the difference to the maximum data size
-       */
-      *data_size += ng_min(ng_max(data_inc, 1), max_datasize - *data_size);
-   }
-   else *data_size = -1;
+   long max_datasize = options->max_datasize;
+
+   if (module->max_datasize > 0) max_datasize = ng_min(max_datasize, module->max_datasize);
+   *data_size = ng_schedule_next(*data_size, options, max_datasize);
+#ifdef NG_MPI
+   /* the adaptive schedule depends on the results of rank 0 */
+   if (options->adaptive && options->mpi) MPI_Bcast(data_size, 1, MPI_LONG, 0, MPI_COMM_WORLD);
+#endif
 }
 
 /**
@@ -1140,6 +1229,70 @@ int ng_recv_all(int src, void *buffer, int size, const struct ng_module *module)
    return 0;
 }
 
+/**
+ * Waits for all requests - uses the module's waitall(...) if it has
+ * one, otherwise it tests all requests until they are complete and
+ * lets the module's progress engine (if any) sleep in between.
+ */
+int ng_waitall(struct ng_module *module, int count, NG_Request *reqs) {
+   int i, ret, pending;
+
+   if (module->waitall) return module->waitall(count, reqs);
+
+   do {
+      pending = 0;
+      for (i = 0; i < count; i++) {
+         if (reqs[i] == NULL) continue;
+         ret = module->test(&reqs[i]);
+         if (ret < 0) return ret;
+         if (ret > 0) pending++;
+      }
+      if (pending && module->progress && module->progress(-1) < 0) return -1;
+      if (g_stop_tests) return -1;
+   } while (pending);
+
+   return 0;
+}
+
+int ng_testany(struct ng_module *module, int count, NG_Request *reqs, int *index) {
+   int i, ret, active = 0;
+
+   if (module->testany) return module->testany(count, reqs, index);
+
+   for (i = 0; i < count; i++) {
+      if (reqs[i] == NULL) continue;
+      active++;
+      ret = module->test(&reqs[i]);
+      if (ret <= 0) {
+         *index = i;
+         return ret;
+      }
+   }
+   if (!active) {
+      *index = -1;
+      return 0;
+   }
+   return 1;
+}
+
+/* writes the "#S" line (syscalls per message of size) and the "#M"
+ * line (module statistics) to fp and at -v to stdout, the module
+ * forgets its counters either way */
+void ng_syscalls_write(FILE *fp, long size, struct ng_module *module) {
+   double sends, recvs;
+   char stats[256];
+
+   if (module->syscalls != NULL && !module->syscalls(size, &sends, &recvs)) {
+      if (fp) fprintf(fp, "#S %ld syscalls per message send %.2lf recv %.2lf\n", size, sends, recvs);
+      if (NG_VLEV1 & g_options.verbose)
+         printf("#S %ld syscalls per message send %.2lf recv %.2lf\n", size, sends, recvs);
+   }
+   if (module->stats != NULL && !module->stats(size, stats, sizeof(stats))) {
+      if (fp) fprintf(fp, "#M %ld %s\n", size, stats);
+      if (NG_VLEV1 & g_options.verbose) printf("#M %ld %s\n", size, stats);
+   }
+}
+
 void ng_exit(int retcode) {
 
 #ifdef NG_MPI
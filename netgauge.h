@@ -148,8 +148,16 @@ struct ng_options {
 
    /** output file name */
    char                  *output_file;
+   /** result format of the output file (NG_FMT_*, see ng_result.h) */
+   int                   result_format;
    /** output file for full output e.g. every single measured value */
    char				   *full_output_file; 
+   /** raw sample trace file prefix (NULL if disabled) */
+   char                  *trace_file;
+   /** trace ring capacity in samples */
+   unsigned long         trace_records;
+   /** timer backend name (see ng_timer_backend()) */
+   char                  *timer;
    /** count of tests per packet size */
    unsigned long         testcount;
    /** max number of seconds after which the test is to be interrupted */
@@ -162,6 +170,21 @@ struct ng_options {
 	 char size_given;
    /** gradation of the geometrical data size growth */
    unsigned int          grad_datasize;
+   /** explicit (sorted) message sizes, NULL for the geometric progression */
+   unsigned long         *size_list;
+   int                   size_count;
+   /** bisect knees of the size schedule (see ng_schedule.h) */
+   char                  adaptive;
+   /** relative confidence interval target, 0 runs testcount tests (see ng_converge.h) */
+   double                ci_target;
+   /** quantile whose interval is checked (0.5 = median) */
+   double                ci_quantile;
+   /** minimum number of tests per size before the interval counts */
+   unsigned long         min_tests;
+   /** time budget per size in ms, 0 = none */
+   unsigned long         budget;
+   /** maximum number of warmup tests per size (see ng_warmup.h) */
+   int                   warmup;
    /** parallel execution via MPI */
    unsigned int          mpi;
    /** pointer to mpi data structure */
@@ -227,6 +250,18 @@ struct ng_comm_pattern {
     */
 };
 
+/**
+ * Kernel (SO_TIMESTAMPING) timestamps of the most recent message
+ * exchanged with a peer in ns since the epoch (CLOCK_REALTIME, like
+ * ng_tstamp_now()). Fields the kernel or the NIC did not provide are 0.
+ */
+struct ng_timestamps {
+   /** send: entered the qdisc, left the driver, left the NIC */
+   unsigned long long sched, sw_tx, hw_tx;
+   /** receive: arrived at the stack, arrived at the NIC */
+   unsigned long long sw_rx, hw_rx;
+};
+
 /**
  * Module registration data structure. This struct has to be filled
  * by each communication module and passed to the ng_register_module(...)
@@ -295,6 +330,13 @@ struct ng_module {
     */
    void* (*malloc)(size_t size);
 
+   /**
+    * Frees memory allocated with the malloc function of the module.
+    * May be null if malloc is null or the memory needs no special
+    * treatment.
+    */
+   void  (*free)(void *buf);
+
    /**
     * Module initialization function. MTU and headerlen MUST be set after
     * this function has been called. This pointer my be void if unneeded.
@@ -384,6 +426,61 @@ struct ng_module {
     */
    int (*test)(NG_Request *req);
 
+   /**
+    * Waits until all count requests are complete. NULL handles (already
+    * completed requests) are ignored. May be NULL, ng_waitall(...)
+    * falls back to test(...) in this case.
+    *
+    * @return 0 when all are complete, values < 0 indicate errors
+    */
+   int (*waitall)(int count, NG_Request *reqs);
+
+   /**
+    * Progresses all count requests and reports one that completed.
+    * May be NULL, ng_testany(...) falls back to test(...).
+    *
+    * @return 0 if reqs[*index] completed (*index is -1 if all handles
+    *    are NULL), > 0 if none completed yet, values < 0 indicate errors
+    */
+   int (*testany)(int count, NG_Request *reqs, int *index);
+
+   /**
+    * Progress engine of the module: moves data for outstanding
+    * non-blocking requests on all connections that are ready and
+    * waits up to timeout ms (0 = poll, -1 = forever) if none is. May
+    * be NULL for modules without asynchronous progress.
+    *
+    * @return values < 0 indicate errors
+    */
+   int (*progress)(int timeout);
+
+   /**
+    * Returns the kernel timestamps of the last send to and the last
+    * receive from peer and clears them. May be NULL, modules that
+    * support it enable timestamping with a module option.
+    *
+    * @return 0 if ts was filled, non-zero if timestamping is off
+    */
+   int (*timestamps)(int peer, struct ng_timestamps *ts);
+
+   /**
+    * Returns the system calls per sent and per received message of
+    * size bytes since the last call and clears the counters of all
+    * sizes. May be NULL.
+    *
+    * @return 0 if there were messages of that size
+    */
+   int (*syscalls)(long size, double *sends, double *recvs);
+
+   /**
+    * Formats module specific statistics of the messages of size bytes
+    * since the last call (zero-copy sends, frame rates, ...) into buf
+    * (len bytes) and clears them. May be NULL.
+    *
+    * @return 0 if there is something to report
+    */
+   int (*stats)(long size, char *buf, int len);
+
    /**
     * TODO: some needful things:
     *   - generic address parsing function
@@ -421,11 +518,17 @@ void get_next_testparams(long *data_size,
 			 long *test_count,
 			 struct ng_options *options, struct ng_module *module);
 int ng_readminmax(char *buf, unsigned long *min, unsigned long  *max);
+int ng_waitall(struct ng_module *module, int count, NG_Request *reqs);
+int ng_testany(struct ng_module *module, int count, NG_Request *reqs, int *index);
+void ng_syscalls_write(FILE *fp, long size, struct ng_module *module);
 void write_host_information(FILE *fd);
 FILE *open_output_file(char *filename);
 
 /* pattern function prototypes */
 int register_pattern_overlap();
+int register_pattern_loss();
+int register_pattern_msgrate();
+int register_pattern_stream();
 int register_pattern_Nto1();
 int register_pattern_noise();
 int register_pattern_1toN();
@@ -511,6 +614,15 @@ void ng_manpage_module(const char, const char *, const char *, const char *);
     ng_exit(10);                             \
   }                                         \
 }
+
+/* Netgauge Free macro - releases memory allocated with NG_MALLOC */
+#define NG_FREE(module, buf)                \
+{                                           \
+  if(NULL == module->free)                  \
+    free(buf);                              \
+  else                                      \
+    module->free(buf);                      \
+}
   
 
 
@@ -520,6 +632,8 @@ typedef struct req_handle {
    int size;            /* size of request */
    void *buffer;        /* buffer to transfer */
    int remaining_bytes; /* number of remaining bytes */
+   struct req_handle *next; /* free list of the request pool */
+   unsigned int seq;    /* id after the last zero-copy send (mod_tcp) */
 } req_handle_t;
 
 #define get_req_type(req) ((req_handle_t*)*req)->type
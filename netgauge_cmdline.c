@@ -44,6 +44,17 @@ const char *netgauge_cmd_struct_help[] = {
   "  -w, --manpage              write manpage to stdout  (default=off)",
   "  -i, --init-thread          initialize with MPI_THREAD_MULTIPLE instead of \n                               MPI_THREAD_SINGLE  (default=off)",
   "  -q, --sanity-check         perform sanity check of timer  (default=off)",
+  "  -F, --format=STRING        result format (text, csv, json or binary)  (default=`text')",
+  "  -T, --trace=STRING         write every raw sample to this mmap'd trace file",
+  "  -N, --trace-records=INT    trace ring capacity in samples (per rank)  (default=`1048576')",
+  "  -k, --timer=STRING         timer backend: auto, rdtsc, lfence, rdtscp or clock  (default=`auto')",
+  "  -z, --sizes=STRING         comma separated list of message sizes (replaces -s/-g)  (default=`')",
+  "  -y, --adaptive             bisect between sizes where the latency slope changes (protocol switches)  (default=off)",
+  "  -e, --ci-target=STRING     sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests)  (default=`0')",
+  "  -j, --ci-quantile=STRING   quantile for --ci-target (0.5 = median)  (default=`0.5')",
+  "  -l, --min-tests=INT        minimum number of tests per size with --ci-target  (default=`10')",
+  "  -b, --budget=INT           time budget per size in ms (0 = none)  (default=`0')",
+  "  -n, --warmup=INT           maximum number of warmup tests per size, the warmup ends as soon as the latency is steady (1 = a single warmup test)  (default=`500')",
     0
 };
 
@@ -109,6 +120,17 @@ void clear_given (struct netgauge_cmd_struct *args_info)
   args_info->manpage_given = 0 ;
   args_info->init_thread_given = 0 ;
   args_info->sanity_check_given = 0 ;
+  args_info->format_given = 0 ;
+  args_info->trace_given = 0 ;
+  args_info->trace_records_given = 0 ;
+  args_info->timer_given = 0 ;
+  args_info->sizes_given = 0 ;
+  args_info->adaptive_given = 0 ;
+  args_info->ci_target_given = 0 ;
+  args_info->ci_quantile_given = 0 ;
+  args_info->min_tests_given = 0 ;
+  args_info->budget_given = 0 ;
+  args_info->warmup_given = 0 ;
 }
 
 static
@@ -138,6 +160,27 @@ void clear_args (struct netgauge_cmd_struct *args_info)
   args_info->manpage_flag = 0;
   args_info->init_thread_flag = 0;
   args_info->sanity_check_flag = 0;
+  args_info->format_arg = gengetopt_strdup ("text");
+  args_info->format_orig = NULL;
+  args_info->trace_arg = NULL;
+  args_info->trace_orig = NULL;
+  args_info->trace_records_arg = 1048576;
+  args_info->trace_records_orig = NULL;
+  args_info->timer_arg = gengetopt_strdup ("auto");
+  args_info->timer_orig = NULL;
+  args_info->sizes_arg = NULL;
+  args_info->sizes_orig = NULL;
+  args_info->adaptive_flag = 0;
+  args_info->ci_target_arg = gengetopt_strdup ("0");
+  args_info->ci_target_orig = NULL;
+  args_info->ci_quantile_arg = gengetopt_strdup ("0.5");
+  args_info->ci_quantile_orig = NULL;
+  args_info->min_tests_arg = 10;
+  args_info->min_tests_orig = NULL;
+  args_info->budget_arg = 0;
+  args_info->budget_orig = NULL;
+  args_info->warmup_arg = 500;
+  args_info->warmup_orig = NULL;
   
 }
 
@@ -162,6 +205,17 @@ void init_args_info(struct netgauge_cmd_struct *args_info)
   args_info->manpage_help = netgauge_cmd_struct_help[13] ;
   args_info->init_thread_help = netgauge_cmd_struct_help[14] ;
   args_info->sanity_check_help = netgauge_cmd_struct_help[15] ;
+  args_info->format_help = netgauge_cmd_struct_help[16] ;
+  args_info->trace_help = netgauge_cmd_struct_help[17] ;
+  args_info->trace_records_help = netgauge_cmd_struct_help[18] ;
+  args_info->timer_help = netgauge_cmd_struct_help[19] ;
+  args_info->sizes_help = netgauge_cmd_struct_help[20] ;
+  args_info->adaptive_help = netgauge_cmd_struct_help[21] ;
+  args_info->ci_target_help = netgauge_cmd_struct_help[22] ;
+  args_info->ci_quantile_help = netgauge_cmd_struct_help[23] ;
+  args_info->min_tests_help = netgauge_cmd_struct_help[24] ;
+  args_info->budget_help = netgauge_cmd_struct_help[25] ;
+  args_info->warmup_help = netgauge_cmd_struct_help[26] ;
   
 }
 
@@ -254,6 +308,22 @@ netgauge_parser_release (struct netgauge_cmd_struct *args_info)
   free_string_field (&(args_info->comm_pattern_arg));
   free_string_field (&(args_info->comm_pattern_orig));
   free_string_field (&(args_info->grad_orig));
+  free_string_field (&(args_info->format_arg));
+  free_string_field (&(args_info->format_orig));
+  free_string_field (&(args_info->trace_arg));
+  free_string_field (&(args_info->trace_orig));
+  free_string_field (&(args_info->trace_records_orig));
+  free_string_field (&(args_info->timer_arg));
+  free_string_field (&(args_info->timer_orig));
+  free_string_field (&(args_info->sizes_arg));
+  free_string_field (&(args_info->sizes_orig));
+  free_string_field (&(args_info->ci_target_arg));
+  free_string_field (&(args_info->ci_target_orig));
+  free_string_field (&(args_info->ci_quantile_arg));
+  free_string_field (&(args_info->ci_quantile_orig));
+  free_string_field (&(args_info->min_tests_orig));
+  free_string_field (&(args_info->budget_orig));
+  free_string_field (&(args_info->warmup_orig));
   
   
 
@@ -315,6 +385,28 @@ netgauge_parser_dump(FILE *outfile, struct netgauge_cmd_struct *args_info)
     write_into_file(outfile, "init-thread", 0, 0 );
   if (args_info->sanity_check_given)
     write_into_file(outfile, "sanity-check", 0, 0 );
+  if (args_info->format_given)
+    write_into_file(outfile, "format", args_info->format_orig, 0);
+  if (args_info->trace_given)
+    write_into_file(outfile, "trace", args_info->trace_orig, 0);
+  if (args_info->trace_records_given)
+    write_into_file(outfile, "trace-records", args_info->trace_records_orig, 0);
+  if (args_info->timer_given)
+    write_into_file(outfile, "timer", args_info->timer_orig, 0);
+  if (args_info->sizes_given)
+    write_into_file(outfile, "sizes", args_info->sizes_orig, 0);
+  if (args_info->adaptive_given)
+    write_into_file(outfile, "adaptive", 0, 0 );
+  if (args_info->ci_target_given)
+    write_into_file(outfile, "ci-target", args_info->ci_target_orig, 0);
+  if (args_info->ci_quantile_given)
+    write_into_file(outfile, "ci-quantile", args_info->ci_quantile_orig, 0);
+  if (args_info->min_tests_given)
+    write_into_file(outfile, "min-tests", args_info->min_tests_orig, 0);
+  if (args_info->budget_given)
+    write_into_file(outfile, "budget", args_info->budget_orig, 0);
+  if (args_info->warmup_given)
+    write_into_file(outfile, "warmup", args_info->warmup_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -579,10 +671,21 @@ netgauge_parser_internal (int argc, char * const *argv, struct netgauge_cmd_stru
         { "manpage",	0, NULL, 'w' },
         { "init-thread",	0, NULL, 'i' },
         { "sanity-check",	0, NULL, 'q' },
+        { "format",	1, NULL, 'F' },
+        { "trace",	1, NULL, 'T' },
+        { "trace-records",	1, NULL, 'N' },
+        { "timer",	1, NULL, 'k' },
+        { "sizes",	1, NULL, 'z' },
+        { "adaptive",	0, NULL, 'y' },
+        { "ci-target",	1, NULL, 'e' },
+        { "ci-quantile",	1, NULL, 'j' },
+        { "min-tests",	1, NULL, 'l' },
+        { "budget",	1, NULL, 'b' },
+        { "warmup",	1, NULL, 'n' },
         { NULL,	0, NULL, 0 }
       };
 
-      c = getopt_long (argc, argv, "Vhv:ao:f:c:t:s:m:x:g:wiq", long_options, &option_index);
+      c = getopt_long (argc, argv, "Vhv:ao:f:c:t:s:m:x:g:wiqF:T:N:k:z:ye:j:l:b:n:", long_options, &option_index);
 
       if (c == -1) break;	/* Exit from `while (1)' loop.  */
 
@@ -751,6 +854,136 @@ netgauge_parser_internal (int argc, char * const *argv, struct netgauge_cmd_stru
             goto failure;
         
           break;
+        case 'F':	/* result format (text, csv, json or binary).  */
+        
+        
+          if (update_arg( (void *)&(args_info->format_arg), 
+               &(args_info->format_orig), &(args_info->format_given),
+              &(local_args_info.format_given), optarg, 0, "text", ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "format", 'F',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'T':	/* write every raw sample to this mmap'd trace file.  */
+        
+        
+          if (update_arg( (void *)&(args_info->trace_arg), 
+               &(args_info->trace_orig), &(args_info->trace_given),
+              &(local_args_info.trace_given), optarg, 0, 0, ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "trace", 'T',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'N':	/* trace ring capacity in samples (per rank).  */
+        
+        
+          if (update_arg( (void *)&(args_info->trace_records_arg), 
+               &(args_info->trace_records_orig), &(args_info->trace_records_given),
+              &(local_args_info.trace_records_given), optarg, 0, "1048576", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "trace-records", 'N',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'k':	/* timer backend: auto, rdtsc, lfence, rdtscp or clock.  */
+        
+        
+          if (update_arg( (void *)&(args_info->timer_arg), 
+               &(args_info->timer_orig), &(args_info->timer_given),
+              &(local_args_info.timer_given), optarg, 0, "auto", ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "timer", 'k',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'z':	/* comma separated list of message sizes (replaces -s/-g).  */
+        
+        
+          if (update_arg( (void *)&(args_info->sizes_arg), 
+               &(args_info->sizes_orig), &(args_info->sizes_given),
+              &(local_args_info.sizes_given), optarg, 0, 0, ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "sizes", 'z',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'y':	/* bisect between sizes where the latency slope changes (protocol switches).  */
+        
+        
+          if (update_arg((void *)&(args_info->adaptive_flag), 0, &(args_info->adaptive_given),
+              &(local_args_info.adaptive_given), optarg, 0, 0, ARG_FLAG,
+              check_ambiguity, override, 1, 0, "adaptive", 'y',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'e':	/* sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests).  */
+        
+        
+          if (update_arg( (void *)&(args_info->ci_target_arg), 
+               &(args_info->ci_target_orig), &(args_info->ci_target_given),
+              &(local_args_info.ci_target_given), optarg, 0, "0", ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "ci-target", 'e',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'j':	/* quantile for --ci-target (0.5 = median).  */
+        
+        
+          if (update_arg( (void *)&(args_info->ci_quantile_arg), 
+               &(args_info->ci_quantile_orig), &(args_info->ci_quantile_given),
+              &(local_args_info.ci_quantile_given), optarg, 0, "0.5", ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "ci-quantile", 'j',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'l':	/* minimum number of tests per size with --ci-target.  */
+        
+        
+          if (update_arg( (void *)&(args_info->min_tests_arg), 
+               &(args_info->min_tests_orig), &(args_info->min_tests_given),
+              &(local_args_info.min_tests_given), optarg, 0, "10", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "min-tests", 'l',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'b':	/* time budget per size in ms (0 = none).  */
+        
+        
+          if (update_arg( (void *)&(args_info->budget_arg), 
+               &(args_info->budget_orig), &(args_info->budget_given),
+              &(local_args_info.budget_given), optarg, 0, "0", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "budget", 'b',
+              additional_error))
+            goto failure;
+        
+          break;
+        case 'n':	/* maximum number of warmup tests per size, the warmup ends as soon as the latency is steady (1 = a single warmup test).  */
+        
+        
+          if (update_arg( (void *)&(args_info->warmup_arg), 
+               &(args_info->warmup_orig), &(args_info->warmup_given),
+              &(local_args_info.warmup_given), optarg, 0, "500", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "warmup", 'n',
+              additional_error))
+            goto failure;
+        
+          break;
 
         case 0:	/* Long option with no short option */
           /* print hostnames.  */
@@ -72,6 +72,38 @@ struct netgauge_cmd_struct
   const char *init_thread_help; /**< @brief initialize with MPI_THREAD_MULTIPLE instead of MPI_THREAD_SINGLE help description.  */
   int sanity_check_flag;	/**< @brief perform sanity check of timer (default=off).  */
   const char *sanity_check_help; /**< @brief perform sanity check of timer help description.  */
+  char * format_arg;	/**< @brief result format (text, csv, json or binary) (default='text').  */
+  char * format_orig;	/**< @brief result format (text, csv, json or binary) original value given at command line.  */
+  const char *format_help; /**< @brief result format (text, csv, json or binary) help description.  */
+  char * trace_arg;	/**< @brief write every raw sample to this mmap'd trace file.  */
+  char * trace_orig;	/**< @brief write every raw sample to this mmap'd trace file original value given at command line.  */
+  const char *trace_help; /**< @brief write every raw sample to this mmap'd trace file help description.  */
+  int trace_records_arg;	/**< @brief trace ring capacity in samples (per rank) (default='1048576').  */
+  char * trace_records_orig;	/**< @brief trace ring capacity in samples (per rank) original value given at command line.  */
+  const char *trace_records_help; /**< @brief trace ring capacity in samples (per rank) help description.  */
+  char * timer_arg;	/**< @brief timer backend: auto, rdtsc, lfence, rdtscp or clock (default='auto').  */
+  char * timer_orig;	/**< @brief timer backend: auto, rdtsc, lfence, rdtscp or clock original value given at command line.  */
+  const char *timer_help; /**< @brief timer backend: auto, rdtsc, lfence, rdtscp or clock help description.  */
+  char * sizes_arg;	/**< @brief comma separated list of message sizes (replaces -s/-g) (default='').  */
+  char * sizes_orig;	/**< @brief comma separated list of message sizes (replaces -s/-g) original value given at command line.  */
+  const char *sizes_help; /**< @brief comma separated list of message sizes (replaces -s/-g) help description.  */
+  int adaptive_flag;	/**< @brief bisect between sizes where the latency slope changes (protocol switches) (default=off).  */
+  const char *adaptive_help; /**< @brief bisect between sizes where the latency slope changes (protocol switches) help description.  */
+  char * ci_target_arg;	/**< @brief sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests) (default='0').  */
+  char * ci_target_orig;	/**< @brief sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests) original value given at command line.  */
+  const char *ci_target_help; /**< @brief sample until the confidence interval half-width of the --ci-quantile is within this fraction of it (0 = always -c tests) help description.  */
+  char * ci_quantile_arg;	/**< @brief quantile for --ci-target (0.5 = median) (default='0.5').  */
+  char * ci_quantile_orig;	/**< @brief quantile for --ci-target (0.5 = median) original value given at command line.  */
+  const char *ci_quantile_help; /**< @brief quantile for --ci-target (0.5 = median) help description.  */
+  int min_tests_arg;	/**< @brief minimum number of tests per size with --ci-target (default='10').  */
+  char * min_tests_orig;	/**< @brief minimum number of tests per size with --ci-target original value given at command line.  */
+  const char *min_tests_help; /**< @brief minimum number of tests per size with --ci-target help description.  */
+  int budget_arg;	/**< @brief time budget per size in ms (0 = none) (default='0').  */
+  char * budget_orig;	/**< @brief time budget per size in ms (0 = none) original value given at command line.  */
+  const char *budget_help; /**< @brief time budget per size in ms (0 = none) help description.  */
+  int warmup_arg;	/**< @brief maximum number of warmup tests per size, the warmup ends as soon as the latency is steady (1 = a single warmup test) (default='500').  */
+  char * warmup_orig;	/**< @brief maximum number of warmup tests per size, the warmup ends as soon as the latency is steady (1 = a single warmup test) original value given at command line.  */
+  const char *warmup_help; /**< @brief maximum number of warmup tests per size, the warmup ends as soon as the latency is steady (1 = a single warmup test) help description.  */
   
   unsigned int version_given ;	/**< @brief Whether version was given.  */
   unsigned int help_given ;	/**< @brief Whether help was given.  */
@@ -89,6 +121,17 @@ struct netgauge_cmd_struct
   unsigned int manpage_given ;	/**< @brief Whether manpage was given.  */
   unsigned int init_thread_given ;	/**< @brief Whether init-thread was given.  */
   unsigned int sanity_check_given ;	/**< @brief Whether sanity-check was given.  */
+  unsigned int format_given ;	/**< @brief Whether format was given.  */
+  unsigned int trace_given ;	/**< @brief Whether trace was given.  */
+  unsigned int trace_records_given ;	/**< @brief Whether trace-records was given.  */
+  unsigned int timer_given ;	/**< @brief Whether timer was given.  */
+  unsigned int sizes_given ;	/**< @brief Whether sizes was given.  */
+  unsigned int adaptive_given ;	/**< @brief Whether adaptive was given.  */
+  unsigned int ci_target_given ;	/**< @brief Whether ci-target was given.  */
+  unsigned int ci_quantile_given ;	/**< @brief Whether ci-quantile was given.  */
+  unsigned int min_tests_given ;	/**< @brief Whether min-tests was given.  */
+  unsigned int budget_given ;	/**< @brief Whether budget was given.  */
+  unsigned int warmup_given ;	/**< @brief Whether warmup was given.  */
 
 } ;
 
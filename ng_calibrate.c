@@ -0,0 +1,312 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+#include "netgauge.h"
+#include "hrtimer/hrtimer.h"
+#include "ng_calibrate.h"
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+#if (HRT_ARCH==1 || HRT_ARCH==2) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#define NG_CALIB_HAVE_CPUID
+#endif
+
+const char *ng_timer_calibrate_source(int source) {
+  switch(source) {
+    case NG_CALIB_CACHE: return "cache";
+    case NG_CALIB_CPUID: return "cpuid";
+    case NG_CALIB_KERNEL: return "tsc_khz";
+    case NG_CALIB_REGRESSION: return "clock_gettime regression";
+    case NG_CALIB_SLEEP: return "sleep loop";
+    case NG_CALIB_CLOCK: return "clock_gettime";
+  }
+  return "unknown";
+}
+
+/* reads the first line of a file into buf and strips the newline */
+static int read_line(const char *path, const char *prefix, char *buf, int len) {
+  FILE *fp = fopen(path, "r");
+  char line[256];
+  int n, found = 0;
+
+  if(fp == NULL) return 0;
+  while(fgets(line, sizeof(line), fp)) {
+    char *val = line;
+    if(prefix) {
+      if(strncmp(line, prefix, strlen(prefix))) continue;
+      /* "model name	: Intel(R) ..." */
+      val = strchr(line, ':');
+      if(val == NULL) continue;
+      val++;
+      while(*val == ' ' || *val == '\t') val++;
+    }
+    /* the value without the newline, cut to fit */
+    n = strcspn(val, "\n");
+    if(n > len - 1) n = len - 1;
+    memcpy(buf, val, n);
+    buf[n] = '\0';
+    found = 1;
+    break;
+  }
+  fclose(fp);
+  return found;
+}
+
+/* builds the cache key - the frequency is only valid for the same
+ * timer on the same CPU model until the next reboot */
+static void cache_key(char *key, int len) {
+  char model[128] = "unknown", bootid[64] = "unknown";
+  int i;
+
+  read_line("/proc/cpuinfo", "model name", model, sizeof(model));
+  read_line("/proc/sys/kernel/random/boot_id", NULL, bootid, sizeof(bootid));
+  /* the key is the first (whitespace separated) field in the file */
+  for(i=0; model[i]; i++) if(model[i] == ' ' || model[i] == '\t') model[i] = '_';
+  snprintf(key, len, "%i:%s:%s", HRT_ARCH, bootid, model);
+}
+
+/* $NG_TIMER_CACHE or the user's cache directory - not a fixed name in
+ * /tmp, where other users could plant the file or a symlink */
+static void cache_path(char *path, int len) {
+  char *env = getenv(NG_CALIB_CACHE_ENV), *dir;
+  int n;
+
+  path[0] = '\0';
+  if(env != NULL) {
+    snprintf(path, len, "%s", env);
+    return;
+  }
+  if((dir = getenv("XDG_CACHE_HOME")) != NULL && *dir) snprintf(path, len, "%s", dir);
+  else if((dir = getenv("HOME")) != NULL && *dir) snprintf(path, len, "%s/.cache", dir);
+  else return;
+  mkdir(path, 0700); /* fails if it exists */
+  n = strlen(path);
+  /* no cache rather than a truncated name */
+  if(n + sizeof("/" NG_CALIB_CACHE_FILE) > (size_t)len) {
+    path[0] = '\0';
+    return;
+  }
+  snprintf(path + n, len - n, "/%s", NG_CALIB_CACHE_FILE);
+}
+
+static unsigned long long cache_lookup(const char *path, const char *key) {
+  FILE *fp;
+  char line[512], fkey[384];
+  unsigned long long freq, res = 0;
+
+  if(!strlen(path)) return 0;
+  fp = fopen(path, "r");
+  if(fp == NULL) return 0;
+  while(fgets(line, sizeof(line), fp)) {
+    if(sscanf(line, "%383s %llu", fkey, &freq) != 2) continue;
+    /* the last matching entry wins */
+    if(!strcmp(fkey, key)) res = freq;
+  }
+  fclose(fp);
+  return res;
+}
+
+static void cache_store(const char *path, const char *key, unsigned long long freq, int source) {
+  FILE *fp;
+
+  if(!strlen(path)) return;
+  /* one short line per append - concurrent ranks on the same host don't
+   * interleave their entries */
+  fp = fopen(path, "a");
+  if(fp == NULL) return;
+  fprintf(fp, "%s %llu %s\n", key, freq, ng_timer_calibrate_source(source));
+  fclose(fp);
+}
+
+/* CPUID leaf 0x15 (TSC/crystal ratio), only if the TSC is invariant */
+static unsigned long long calibrate_cpuid(void) {
+#ifdef NG_CALIB_HAVE_CPUID
+  unsigned int eax, ebx, ecx, edx, max;
+
+  if(!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) return 0;
+  if(!(edx & (1 << 8))) return 0; /* no invariant TSC */
+
+  max = __get_cpuid_max(0, NULL);
+  if(max >= 0x15) {
+    __cpuid(0x15, eax, ebx, ecx, edx);
+    /* eax = denominator, ebx = numerator, ecx = crystal clock in Hz */
+    if(eax && ebx && ecx) return (unsigned long long)ecx * ebx / eax;
+  }
+#endif
+  return 0;
+}
+
+/* CPUID leaf 0x16 is the base clock, not the TSC frequency - it only
+ * bounds the other sources. @return 0 if freq is off by more than
+ * NG_CALIB_BASE_FACTOR (or freq is 0) */
+static int calibrate_sane(unsigned long long freq) {
+#ifdef NG_CALIB_HAVE_CPUID
+  unsigned int eax, ebx, ecx, edx;
+  unsigned long long base;
+
+  if(freq == 0) return 0;
+  if(__get_cpuid_max(0, NULL) < 0x16) return 1;
+  __cpuid(0x16, eax, ebx, ecx, edx);
+  /* eax = base frequency in MHz */
+  base = (unsigned long long)(eax & 0xffff) * 1000000ULL;
+  if(base == 0) return 1;
+  return freq * NG_CALIB_BASE_FACTOR >= base && freq <= base * NG_CALIB_BASE_FACTOR;
+#else
+  return freq > 0;
+#endif
+}
+
+/* the kernel's tsc_khz (exported by some kernels) */
+static unsigned long long calibrate_kernel(void) {
+#if HRT_ARCH==1 || HRT_ARCH==2
+  char buf[64];
+  unsigned long long khz;
+
+  if(!read_line("/sys/devices/system/cpu/cpu0/tsc_freq_khz", NULL, buf, sizeof(buf))) return 0;
+  khz = strtoull(buf, NULL, 10);
+  return khz * 1000ULL;
+#else
+  return 0;
+#endif
+}
+
+/* least-squares fit of timer ticks against CLOCK_MONOTONIC_RAW over
+ * NG_CALIB_REGRESSION_NS nanoseconds */
+static unsigned long long calibrate_regression(void) {
+#ifdef CLOCK_MONOTONIC_RAW
+  #define NG_CALIB_SAMPLES 64
+  double x[NG_CALIB_SAMPLES], y[NG_CALIB_SAMPLES];
+  double xavg=0, yavg=0, sxy=0, sxx=0;
+  unsigned long long t0=0, tick0=0, ticks;
+  int i, n;
+
+  for(n=0; n<NG_CALIB_SAMPLES; n++) {
+    struct timespec ts1, ts2;
+    HRT_TIMESTAMP_T t;
+    unsigned long long ns, target;
+
+    /* spread the samples evenly across the regression window */
+    target = t0 + (NG_CALIB_REGRESSION_NS / (NG_CALIB_SAMPLES-1)) * n;
+    do {
+      if(clock_gettime(CLOCK_MONOTONIC_RAW, &ts1)) return 0;
+      ns = (unsigned long long)ts1.tv_sec * 1000000000ULL + ts1.tv_nsec;
+    } while(n > 0 && ns < target);
+
+    /* take the timer reading in between two clock reads and use the
+     * midpoint to reduce the error */
+    HRT_GET_TIMESTAMP(t);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts2);
+    ns = (ns + (unsigned long long)ts2.tv_sec * 1000000000ULL + ts2.tv_nsec) / 2;
+    HRT_GET_TIME(t, ticks);
+
+    if(n == 0) {
+      t0 = ns;
+      tick0 = ticks;
+    }
+    x[n] = (double)(ns - t0);
+    y[n] = (double)(ticks - tick0);
+  }
+
+  for(i=0; i<n; i++) {
+    xavg += x[i];
+    yavg += y[i];
+  }
+  xavg /= n;
+  yavg /= n;
+  for(i=0; i<n; i++) {
+    sxy += (x[i]-xavg)*(y[i]-yavg);
+    sxx += (x[i]-xavg)*(x[i]-xavg);
+  }
+  if(sxx <= 0 || sxy <= 0) return 0;
+
+  /* slope is ticks per nanosecond */
+  return (unsigned long long)(sxy/sxx*1e9 + 0.5);
+#else
+  return 0;
+#endif
+}
+
+/* the result is valid for the whole run - patterns that ask again
+ * get it for free */
+static unsigned long long calib_freq = 0;
+static int calib_source = 0;
+
+unsigned long long ng_timer_calibrate(int *source) {
+  char key[384], path[1024];
+  unsigned long long freq;
+  int src;
+
+  if(calib_freq > 0) {
+    if(source) *source = calib_source;
+    return calib_freq;
+  }
+
+#if HRT_ARCH==2
+  if(g_hrt_backend == HRT_BACKEND_CLOCK) {
+    calib_freq = 1000000000ULL;
+    calib_source = NG_CALIB_CLOCK;
+    if(source) *source = calib_source;
+    return calib_freq;
+  }
+#endif
+
+  cache_key(key, sizeof(key));
+  cache_path(path, sizeof(path));
+
+  if((freq = cache_lookup(path, key)) > 0) {
+    src = NG_CALIB_CACHE;
+  } else {
+    if(calibrate_sane(freq = calibrate_cpuid())) src = NG_CALIB_CPUID;
+    else if(calibrate_sane(freq = calibrate_kernel())) src = NG_CALIB_KERNEL;
+    else if((freq = calibrate_regression()) > 0) src = NG_CALIB_REGRESSION;
+    else {
+#ifdef HRT_CALIBRATE_SLEEP
+      HRT_CALIBRATE_SLEEP(freq);
+#else
+      freq = 1000000000ULL; /* MPI_Wtime() based timer counts in ns */
+#endif
+      src = NG_CALIB_SLEEP;
+    }
+    cache_store(path, key, freq, src);
+  }
+
+  calib_freq = freq;
+  calib_source = src;
+  if(source) *source = src;
+  return freq;
+}
+
+/* RDTSCP is CPUID 0x80000001 EDX bit 27 */
+static int have_rdtscp(void) {
+#ifdef NG_CALIB_HAVE_CPUID
+  unsigned int eax, ebx, ecx, edx;
+
+  if(!__get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx)) return 0;
+  return (edx & (1 << 27)) != 0;
+#else
+  return 0;
+#endif
+}
+
+int ng_timer_backend(const char *name) {
+#if HRT_ARCH==2
+  if(!strcmp(name, "auto")) g_hrt_backend = have_rdtscp() ? HRT_BACKEND_RDTSCP : HRT_BACKEND_LFENCE;
+  else if(!strcmp(name, "rdtsc")) g_hrt_backend = HRT_BACKEND_RDTSC;
+  else if(!strcmp(name, "lfence")) g_hrt_backend = HRT_BACKEND_LFENCE;
+  else if(!strcmp(name, "rdtscp") && have_rdtscp()) g_hrt_backend = HRT_BACKEND_RDTSCP;
+  else if(!strcmp(name, "clock")) g_hrt_backend = HRT_BACKEND_CLOCK;
+  else return 1;
+  return 0;
+#else
+  /* the other architectures have a single backend */
+  return strcmp(name, "auto") != 0;
+#endif
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_CALIBRATE_H_
+#define NG_CALIBRATE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** where the frequency came from (reported in the output) */
+#define NG_CALIB_CACHE      1  /* per-host cache file */
+#define NG_CALIB_CPUID      2  /* CPUID leaf 0x15 (invariant TSC) */
+#define NG_CALIB_KERNEL     3  /* kernel's tsc_khz from sysfs */
+#define NG_CALIB_REGRESSION 4  /* short regression against CLOCK_MONOTONIC_RAW */
+#define NG_CALIB_SLEEP      5  /* old sleep(1) loop (last resort) */
+#define NG_CALIB_CLOCK      6  /* clock_gettime() backend, counts in ns */
+
+/** environment variable to override the cache file ("" disables it) */
+#define NG_CALIB_CACHE_ENV "NG_TIMER_CACHE"
+
+/** default cache file in $XDG_CACHE_HOME or $HOME/.cache */
+#define NG_CALIB_CACHE_FILE "netgauge-timer"
+
+/** CPUID and tsc_khz results off the base clock (CPUID leaf 0x16) by
+ * more than this factor are ignored */
+#define NG_CALIB_BASE_FACTOR 2
+
+/** duration of the clock_gettime() regression in nanoseconds */
+#define NG_CALIB_REGRESSION_NS 50000000ULL
+
+/**
+ * Determines the frequency of the high resolution timer (ticks/s)
+ * without the multi-second sleep loop. Tries (in this order) the
+ * per-host cache, CPUID, the kernel's tsc_khz and a short regression
+ * against CLOCK_MONOTONIC_RAW. Successful measurements are written
+ * back to the cache, keyed by CPU model and boot id.
+ *
+ * @param source if not NULL, returns one of the NG_CALIB_* constants
+ * @return the timer frequency in Hz
+ */
+unsigned long long ng_timer_calibrate(int *source);
+
+/** human readable name of a NG_CALIB_* constant */
+const char *ng_timer_calibrate_source(int source);
+
+/**
+ * Selects the timer backend by name ("auto", "rdtsc", "lfence",
+ * "rdtscp" or "clock"). "auto" picks rdtscp if the CPU has it and
+ * lfence;rdtsc otherwise. Must be called before HRT_INIT.
+ *
+ * @return non-zero if the backend is unknown or not supported
+ */
+int ng_timer_backend(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_CALIBRATE_H_ */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+#include "netgauge.h"
+#include "hrtimer/hrtimer.h"
+#include "ng_converge.h"
+
+extern struct ng_options g_options;
+
+static const char *reason_names[] = {"running", "converged", "budget", "max"};
+
+int ng_converge_enabled(const struct ng_options *options) {
+   return options->ci_target > 0 || options->budget > 0;
+}
+
+void ng_converge_init(struct ng_converge *c) {
+   HRT_TIMESTAMP_T t;
+
+   memset(c, 0, sizeof(*c));
+   HRT_GET_TIMESTAMP(t);
+   HRT_GET_TIME(t, c->start);
+}
+
+/* the vote of a measuring rank */
+static int converge_vote(struct ng_converge *c, const struct ng_stats *s) {
+   int have_ci;
+
+   /* the interval stays 0 until there are enough samples */
+   c->lo = c->hi = 0;
+   have_ci = ng_stats_quantile_ci(s, g_options.ci_quantile, NG_CONV_Z, &c->lo, &c->hi) == 0;
+
+   c->value = ng_stats_quantile(s, g_options.ci_quantile);
+   if (g_options.ci_target > 0 && have_ci && s->n >= g_options.min_tests &&
+       c->value > 0 && (c->hi - c->lo) / 2 <= g_options.ci_target * c->value) {
+      c->reason = NG_CONV_CONVERGED;
+      return 1;
+   }
+   if (g_options.budget > 0 && c->elapsed >= g_options.budget * 1e3) {
+      c->reason = NG_CONV_BUDGET;
+      return 1;
+   }
+   return 0;
+}
+
+int ng_converge_done(struct ng_converge *c, long test, const struct ng_stats *s) {
+   HRT_TIMESTAMP_T t;
+   unsigned long long now;
+   unsigned long n = test + 1;
+   int stop = 1, all;
+
+   if (test < 0) return 0;
+   if (n < g_options.testcount && n % NG_CONV_INTERVAL) return 0;
+
+   HRT_GET_TIMESTAMP(t);
+   HRT_GET_TIME(t, now);
+   c->elapsed = HRT_GET_USEC(now - c->start);
+   c->tests = n;
+   c->reason = NG_CONV_RUNNING;
+   if (s) stop = converge_vote(c, s);
+
+   all = stop;
+#ifdef NG_MPI
+   if (g_options.mpi) MPI_Allreduce(&stop, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#endif
+   if (!all && n >= g_options.testcount) {
+      /* the pattern's loop ends here anyway */
+      all = 1;
+   }
+   if (all && c->reason == NG_CONV_RUNNING) c->reason = NG_CONV_MAXTESTS;
+   return all;
+}
+
+void ng_converge_write(FILE *fp, long size, const struct ng_converge *c) {
+   if (fp == NULL) return;
+   fprintf(fp, "#C %ld tests %lu q%g %.2lf ci %.2lf %.2lf time %.2lf ms %s\n",
+           size, c->tests, g_options.ci_quantile * 100, c->value, c->lo, c->hi,
+           c->elapsed / 1e3, reason_names[c->reason]);
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_CONVERGE_H_
+#define NG_CONVERGE_H_
+
+#include "netgauge.h"
+#include "ng_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** confidence level of the interval (95%) */
+#define NG_CONV_Z 1.96
+
+/** tests between two convergence checks (each check is a collective) */
+#define NG_CONV_INTERVAL 16
+
+/** why the sampling of a size stopped */
+#define NG_CONV_RUNNING   0
+#define NG_CONV_CONVERGED 1  /* the interval met --ci-target */
+#define NG_CONV_BUDGET    2  /* --budget ran out */
+#define NG_CONV_MAXTESTS  3  /* -c tests were done */
+
+/**
+ * Convergence controller for one message size. A pattern runs up to
+ * -c tests and calls ng_converge_done() after each of them, it stops
+ * as soon as all measuring ranks agree.
+ */
+struct ng_converge {
+   unsigned long long start;  /* timer ticks at ng_converge_init() */
+   unsigned long tests;       /* tests done at the last check */
+   double value, lo, hi;      /* the quantile and its interval */
+   double elapsed;            /* usecs spent on this size */
+   int reason;                /* NG_CONV_* */
+};
+
+/** true if --ci-target or --budget is set (otherwise don't call the rest) */
+int ng_converge_enabled(const struct ng_options *options);
+
+/** starts a new size */
+void ng_converge_init(struct ng_converge *c);
+
+/**
+ * Decides after test (0-based, the warmup -1 is ignored) whether
+ * to stop. Every NG_CONV_INTERVAL tests (and after the last one)
+ * this is collective over MPI_COMM_WORLD, so all ranks must call it
+ * with the same test numbers. Ranks that don't measure pass NULL.
+ *
+ * @return non-zero if all ranks stop
+ */
+int ng_converge_done(struct ng_converge *c, long test, const struct ng_stats *s);
+
+/** writes the "#C" line (tests, interval, time and reason) to fp */
+void ng_converge_write(FILE *fp, long size, const struct ng_converge *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_CONVERGE_H_ */
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+#include "netgauge.h"
+#include "hrtimer/hrtimer.h"
+#include "ng_hist.h"
+
+static inline int hist_index(unsigned long long v) {
+  int msb, shift;
+
+  if(v < NG_HIST_SUB) return (int)v;
+  msb = 63 - __builtin_clzll(v);
+  shift = msb - NG_HIST_SUB_BITS + 1;
+  /* v >> shift is in [NG_HIST_SUB/2, NG_HIST_SUB) */
+  return NG_HIST_SUB + (shift-1)*(NG_HIST_SUB/2) + (int)(v >> shift) - NG_HIST_SUB/2;
+}
+
+static void hist_range(int idx, unsigned long long *lo, unsigned long long *hi) {
+  int j, shift;
+  unsigned long long sub;
+
+  if(idx < NG_HIST_SUB) {
+    *lo = *hi = idx;
+    return;
+  }
+  j = idx - NG_HIST_SUB;
+  shift = j/(NG_HIST_SUB/2) + 1;
+  sub = j%(NG_HIST_SUB/2) + NG_HIST_SUB/2;
+  *lo = sub << shift;
+  *hi = *lo + ((1ULL << shift) - 1);
+}
+
+void ng_hist_init(struct ng_hist *h) {
+  memset(h, 0, sizeof(struct ng_hist));
+  h->min = ~0ULL;
+}
+
+void ng_hist_record(struct ng_hist *h, unsigned long long ticks) {
+  h->bins[hist_index(ticks)]++;
+  h->n++;
+  if(ticks < h->min) h->min = ticks;
+  if(ticks > h->max) h->max = ticks;
+}
+
+void ng_hist_record_atomic(struct ng_hist *h, unsigned long long ticks) {
+  unsigned long long old;
+
+  __sync_fetch_and_add(&h->bins[hist_index(ticks)], 1);
+  __sync_fetch_and_add(&h->n, 1);
+  while(ticks < (old = h->min) && !__sync_bool_compare_and_swap(&h->min, old, ticks)) {};
+  while(ticks > (old = h->max) && !__sync_bool_compare_and_swap(&h->max, old, ticks)) {};
+}
+
+void ng_hist_merge(struct ng_hist *dst, const struct ng_hist *src) {
+  int i;
+
+  for(i=0; i<NG_HIST_BINS; i++) dst->bins[i] += src->bins[i];
+  dst->n += src->n;
+  if(src->min < dst->min) dst->min = src->min;
+  if(src->max > dst->max) dst->max = src->max;
+}
+
+unsigned long long ng_hist_percentile(const struct ng_hist *h, double p) {
+  unsigned long long rank, cnt = 0, lo, hi;
+  int i;
+
+  if(h->n == 0) return 0;
+  if(p <= 0) return h->min;
+
+  rank = (unsigned long long)ceil(p/100.0*(double)h->n);
+  if(rank < 1) rank = 1;
+  for(i=0; i<NG_HIST_BINS; i++) {
+    cnt += h->bins[i];
+    if(cnt >= rank) {
+      hist_range(i, &lo, &hi);
+      return hi < h->max ? hi : h->max;
+    }
+  }
+  return h->max;
+}
+
+void ng_hist_write(FILE *fp, const char *name, long size, const struct ng_hist *h) {
+  static const double pct[] = {50, 90, 99, 99.9, 99.99};
+  unsigned long long lo, hi;
+  int i;
+
+  if(fp == NULL || h->n == 0) return;
+
+  fprintf(fp, "#H %s %ld n %llu min %.2lf", name, size, h->n, HRT_GET_USEC(h->min));
+  for(i=0; i<sizeof(pct)/sizeof(pct[0]); i++) {
+    fprintf(fp, " p%g %.2lf", pct[i], HRT_GET_USEC(ng_hist_percentile(h, pct[i])));
+  }
+  fprintf(fp, " max %.2lf [us]\n", HRT_GET_USEC(h->max));
+
+  /* name size lowest-tick highest-tick count */
+  for(i=0; i<NG_HIST_BINS; i++) {
+    if(!h->bins[i]) continue;
+    hist_range(i, &lo, &hi);
+    fprintf(fp, "#H %s %ld %llu %llu %llu\n", name, size, lo, hi, h->bins[i]);
+  }
+}
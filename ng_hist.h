@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_HIST_H_
+#define NG_HIST_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 2^7 -> 64 linear sub-buckets per power of two, so a bucket is at
+ * most 1/64 (1.56%) of its value wide */
+#define NG_HIST_SUB_BITS 7
+#define NG_HIST_SUB (1 << NG_HIST_SUB_BITS)
+/** covers the whole 64 bit range */
+#define NG_HIST_BINS (NG_HIST_SUB + (64-NG_HIST_SUB_BITS)*(NG_HIST_SUB/2))
+
+/**
+ * Log-linear latency histogram (like HdrHistogram) in timer ticks.
+ * Values below NG_HIST_SUB are counted exactly, larger values in
+ * NG_HIST_SUB/2 linear sub-buckets per power of two. The memory is
+ * fixed and recording is a single increment (see ng_hist_record_atomic
+ * for concurrent recorders).
+ */
+struct ng_hist {
+  unsigned long long n;
+  unsigned long long min, max;
+  unsigned long long bins[NG_HIST_BINS];
+};
+
+void ng_hist_init(struct ng_hist *h);
+void ng_hist_record(struct ng_hist *h, unsigned long long ticks);
+void ng_hist_record_atomic(struct ng_hist *h, unsigned long long ticks);
+void ng_hist_merge(struct ng_hist *dst, const struct ng_hist *src);
+
+/** highest value (in ticks) that is equivalent to the p-th percentile
+ * (p in [0,100]) */
+unsigned long long ng_hist_percentile(const struct ng_hist *h, double p);
+
+/**
+ * Writes the percentiles and all non-empty buckets of a round as
+ * "#H" comment lines (ticks and usecs) to fp.
+ */
+void ng_hist_write(FILE *fp, const char *name, long size, const struct ng_hist *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_HIST_H_ */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+#include "netgauge.h"
+#include "ng_reqpool.h"
+#include <sched.h>
+
+struct ng_reqslab {
+   struct ng_reqslab *next;
+   int n;
+   req_handle_t reqs[1];
+};
+
+void ng_reqpool_init(struct ng_reqpool *pool, int n) {
+   pool->free = NULL;
+   pool->slabs = NULL;
+   pool->count = 0;
+   if (n > 0) ng_reqpool_grow(pool, n);
+}
+
+int ng_reqpool_grow(struct ng_reqpool *pool, int n) {
+   struct ng_reqslab *slab;
+   int i;
+
+   slab = malloc(sizeof(struct ng_reqslab) + (n-1)*sizeof(req_handle_t));
+   if (slab == NULL) {
+      ng_perror("Could not allocate %d requests", n);
+      return 0;
+   }
+   memset(slab, 0, sizeof(struct ng_reqslab) + (n-1)*sizeof(req_handle_t));
+   slab->n = n;
+   slab->next = pool->slabs;
+   pool->slabs = slab;
+   for (i = 0; i < n; i++) ng_reqpool_put(pool, &slab->reqs[i]);
+   pool->count += n;
+
+   ng_info(NG_VLEV2, "request pool holds %d requests", pool->count);
+   return n;
+}
+
+void ng_reqpool_destroy(struct ng_reqpool *pool) {
+   struct ng_reqslab *slab;
+
+   while ((slab = pool->slabs) != NULL) {
+      pool->slabs = slab->next;
+      free(slab);
+   }
+   pool->free = NULL;
+   pool->count = 0;
+}
+
+int ng_reqpool_waitall(struct ng_reqpool *pool, int count, NG_Request *reqs,
+                       int (*progress)(int timeout), int timeout, int yield) {
+   int i, pending, ret;
+
+   while (1) {
+      pending = 0;
+      for (i = 0; i < count; i++) {
+         if (reqs[i] != NULL && ng_reqpool_release(pool, &reqs[i]) > 0) pending++;
+      }
+      if (!pending) return 0;
+
+      if ((ret = progress(timeout)) < 0) return -1;
+      /* give the peer the core if we share it */
+      if (ret > 0 && yield) sched_yield();
+      if (g_stop_tests) return -1;
+   }
+}
+
+int ng_reqpool_testany(struct ng_reqpool *pool, int count, NG_Request *reqs, int *index,
+                       int (*progress)(int timeout)) {
+   int i, round, active;
+
+   for (round = 0; round < 2; round++) {
+      active = 0;
+      for (i = 0; i < count; i++) {
+         if (reqs[i] == NULL) continue;
+         active++;
+         if (ng_reqpool_release(pool, &reqs[i]) == 0) {
+            *index = i;
+            return 0;
+         }
+      }
+      if (!active) {
+         *index = -1;
+         return 0;
+      }
+      /* nothing complete - progress once */
+      if (round == 0 && progress(0) < 0) return -1;
+   }
+   return 1;
+}
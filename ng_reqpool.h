@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_REQPOOL_H_
+#define NG_REQPOOL_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** requests per slab when the pool has to grow */
+#define NG_REQPOOL_SLAB 64
+
+struct ng_reqslab;
+
+/**
+ * Free list of preallocated request handles for the non-blocking
+ * functions of the socket modules. Getting and releasing a request
+ * is a pointer swap, the pool only calls malloc if more requests are
+ * outstanding than were ever before.
+ */
+struct ng_reqpool {
+   req_handle_t *free;
+   struct ng_reqslab *slabs;
+   /** number of allocated requests */
+   int count;
+};
+
+/** preallocates n requests */
+void ng_reqpool_init(struct ng_reqpool *pool, int n);
+/** adds n requests to the free list */
+int ng_reqpool_grow(struct ng_reqpool *pool, int n);
+/** frees all slabs (all requests must have been released) */
+void ng_reqpool_destroy(struct ng_reqpool *pool);
+
+static inline req_handle_t *ng_reqpool_get(struct ng_reqpool *pool) {
+   req_handle_t *req;
+
+   if (pool->free == NULL && !ng_reqpool_grow(pool, NG_REQPOOL_SLAB)) {
+      return NULL;
+   }
+   req = pool->free;
+   pool->free = req->next;
+   req->next = NULL;
+   return req;
+}
+
+static inline void ng_reqpool_put(struct ng_reqpool *pool, req_handle_t *req) {
+   req->next = pool->free;
+   pool->free = req;
+}
+
+/**
+ * Gets a request for a transfer of size bytes with peer and stores it
+ * in *req. remaining_bytes starts at size, the module adjusts it for
+ * empty messages.
+ *
+ * @return the request or NULL if the pool can't grow
+ */
+static inline req_handle_t *ng_reqpool_new(struct ng_reqpool *pool, int type, int peer,
+                                           void *buffer, int size, NG_Request *req) {
+   req_handle_t *nreq = ng_reqpool_get(pool);
+
+   if (nreq == NULL) return NULL;
+   nreq->type            = type;
+   nreq->index           = peer;
+   nreq->buffer          = buffer;
+   nreq->size            = size;
+   nreq->remaining_bytes = size;
+   *req = (NG_Request *) nreq;
+   return nreq;
+}
+
+/**
+ * Releases *req into the pool if it is complete (remaining_bytes is
+ * 0) and sets it to NULL, no progress.
+ *
+ * @return the remaining bytes
+ */
+static inline int ng_reqpool_release(struct ng_reqpool *pool, NG_Request *req) {
+   req_handle_t *nreq = (req_handle_t *)*req;
+
+   if (nreq->remaining_bytes > 0) return nreq->remaining_bytes;
+   ng_reqpool_put(pool, nreq);
+   *req = NULL;
+   return 0;
+}
+
+/**
+ * waitall() of the modules that complete requests in their progress
+ * function: releases the complete requests and calls progress(timeout)
+ * until all are done. With yield set, sched_yield() gives the core
+ * away when progress() reports that it could not finish (> 0).
+ *
+ * @return 0 on success, -1 on errors or if the tests were stopped
+ */
+int ng_reqpool_waitall(struct ng_reqpool *pool, int count, NG_Request *reqs,
+                       int (*progress)(int timeout), int timeout, int yield);
+
+/**
+ * testany() of the same modules: releases the first complete request
+ * (*index, -1 if all are NULL), calls progress(0) once if none is.
+ *
+ * @return 0 if one completed, 1 if none did, -1 on errors
+ */
+int ng_reqpool_testany(struct ng_reqpool *pool, int count, NG_Request *reqs, int *index,
+                       int (*progress)(int timeout));
+
+/** requests of one peer and direction in the order they were posted */
+struct ng_reqqueue {
+   req_handle_t *head, *tail;
+};
+
+static inline void ng_reqqueue_push(struct ng_reqqueue *q, req_handle_t *nreq) {
+   nreq->next = NULL;
+   if (q->tail) q->tail->next = nreq;
+   else q->head = nreq;
+   q->tail = nreq;
+}
+
+/** removes the (completed) head */
+static inline void ng_reqqueue_pop(struct ng_reqqueue *q) {
+   req_handle_t *nreq = q->head;
+
+   q->head = nreq->next;
+   if (q->head == NULL) q->tail = NULL;
+   nreq->next = NULL;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_REQPOOL_H_ */
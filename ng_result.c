@@ -0,0 +1,320 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+#include "netgauge.h"
+#include "ng_result.h"
+#include <stdarg.h>
+#include <stdint.h>
+
+int ng_result_parse_format(const char *name) {
+  if(name == NULL || strcmp(name, "text") == 0) return NG_FMT_TEXT;
+  if(strcmp(name, "csv") == 0) return NG_FMT_CSV;
+  if(strcmp(name, "json") == 0) return NG_FMT_JSON;
+  if(strcmp(name, "binary") == 0) return NG_FMT_BINARY;
+  return -1;
+}
+
+void ng_result_flush(struct ng_result *r) {
+  if(r->len == 0) return;
+  if(fwrite(r->buf, 1, r->len, r->fp) != r->len) {
+    ng_perror("writing results failed");
+  }
+  r->len = 0;
+}
+
+static void res_put(struct ng_result *r, const void *data, size_t len) {
+  if(r->len + len > NG_RESULT_BUFSIZE) ng_result_flush(r);
+  if(len > NG_RESULT_BUFSIZE) {
+    fwrite(data, 1, len, r->fp);
+    return;
+  }
+  memcpy(r->buf + r->len, data, len);
+  r->len += len;
+}
+
+static void res_printf(struct ng_result *r, const char *fmt, ...) {
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(r->buf + r->len, NG_RESULT_BUFSIZE - r->len, fmt, ap);
+  va_end(ap);
+  if(n < 0) return;
+  if(r->len + n < NG_RESULT_BUFSIZE) {
+    r->len += n;
+    return;
+  }
+
+  /* did not fit - flush and try again */
+  ng_result_flush(r);
+  va_start(ap, fmt);
+  if(n < NG_RESULT_BUFSIZE) {
+    r->len = vsnprintf(r->buf, NG_RESULT_BUFSIZE, fmt, ap);
+  } else {
+    vfprintf(r->fp, fmt, ap);
+  }
+  va_end(ap);
+}
+
+static void res_put_u16(struct ng_result *r, uint16_t v) {
+  res_put(r, &v, sizeof(v));
+}
+
+/* binary strings are stored as 16 bit length + bytes */
+static void res_put_bstring(struct ng_result *r, const char *s) {
+  size_t len = strlen(s);
+  if(len > 0xffff) len = 0xffff;
+  res_put_u16(r, (uint16_t)len);
+  res_put(r, s, len);
+}
+
+static void res_put_quoted(struct ng_result *r, const char *s) {
+  char c[2] = {0, 0};
+
+  if(r->format == NG_FMT_CSV) {
+    if(strpbrk(s, ",\"\n") == NULL) {
+      res_put(r, s, strlen(s));
+      return;
+    }
+    res_put(r, "\"", 1);
+    for(; *s; s++) {
+      if(*s == '"') res_put(r, "\"", 1);
+      c[0] = *s;
+      res_put(r, c, 1);
+    }
+    res_put(r, "\"", 1);
+    return;
+  }
+
+  /* JSON */
+  res_put(r, "\"", 1);
+  for(; *s; s++) {
+    if(*s == '"' || *s == '\\') {
+      c[0] = *s;
+      res_put(r, "\\", 1);
+      res_put(r, c, 1);
+    } else if((unsigned char)*s < 0x20) {
+      res_printf(r, "\\u%04x", (unsigned char)*s);
+    } else {
+      c[0] = *s;
+      res_put(r, c, 1);
+    }
+  }
+  res_put(r, "\"", 1);
+}
+
+struct ng_result *ng_result_open(FILE *fp, const char *pattern, const struct ng_result_col *cols, int ncols) {
+  struct ng_result *r;
+  int i;
+
+  r = (struct ng_result*)malloc(sizeof(struct ng_result));
+  if(r == NULL) {
+    ng_error("Could not allocate memory for the result sink");
+    ng_exit(10);
+  }
+  r->fp = fp;
+  r->format = g_options.result_format;
+  r->cols = cols;
+  r->ncols = ncols;
+  r->col = 0;
+  r->len = 0;
+  r->notes = NULL;
+  r->notebuf = NULL;
+  r->notelen = 0;
+
+  switch(r->format) {
+    case NG_FMT_TEXT:
+      write_host_information(fp);
+      break;
+    case NG_FMT_CSV:
+      for(i=0; i<ncols; i++) {
+        if(i) res_put(r, ",", 1);
+        res_put_quoted(r, cols[i].name);
+      }
+      res_put(r, "\n", 1);
+      break;
+    case NG_FMT_BINARY: {
+      uint32_t v = NG_RESULT_VERSION, bom = NG_RESULT_BOM;
+      res_put(r, NG_RESULT_MAGIC, 4);
+      res_put(r, &v, sizeof(v));
+      res_put(r, &bom, sizeof(bom));
+      res_put_bstring(r, pattern);
+      res_put_u16(r, (uint16_t)ncols);
+      for(i=0; i<ncols; i++) {
+        uint8_t type = (uint8_t)cols[i].type;
+        res_put(r, &type, 1);
+        res_put_bstring(r, cols[i].name);
+      }
+      break;
+    }
+  }
+  return r;
+}
+
+void ng_result_comment(struct ng_result *r, const char *text) {
+  if(r->format == NG_FMT_TEXT) res_put(r, text, strlen(text));
+}
+
+/* writes the lines collected by ng_result_textfile() as notes */
+static void res_put_notes(struct ng_result *r) {
+  char *line, *end, *last;
+
+  if(r->notes == NULL) return;
+  fclose(r->notes);
+  last = r->notebuf + r->notelen;
+  for(line = r->notebuf; line < last; line = end + 1) {
+    end = (char*)memchr(line, '\n', last - line);
+    if(end == NULL) end = last;
+    *end = '\0';
+    switch(r->format) {
+      case NG_FMT_CSV:
+        res_put(r, line, end - line);
+        res_put(r, "\n", 1);
+        break;
+      case NG_FMT_JSON:
+        res_put(r, "{\"note\":", 8);
+        res_put_quoted(r, line);
+        res_put(r, "}\n", 2);
+        break;
+      case NG_FMT_BINARY: {
+        uint8_t tag = NG_RESULT_TAG_NOTE;
+        res_put(r, &tag, 1);
+        res_put_bstring(r, line);
+        break;
+      }
+    }
+  }
+  free(r->notebuf);
+  r->notes = NULL;
+  r->notebuf = NULL;
+  r->notelen = 0;
+}
+
+/* separator / key before the next value, returns the column */
+static const struct ng_result_col *res_next(struct ng_result *r) {
+  const struct ng_result_col *c;
+
+  if(r->col >= r->ncols) {
+    ng_error("result record has more than %i columns", r->ncols);
+    return NULL;
+  }
+  c = &r->cols[r->col];
+  if(r->col == 0) {
+    res_put_notes(r);
+    if(r->format == NG_FMT_BINARY) {
+      uint8_t tag = NG_RESULT_TAG_RECORD;
+      res_put(r, &tag, 1);
+    }
+  }
+  switch(r->format) {
+    case NG_FMT_TEXT:
+      if(r->col) res_put(r, " ", 1);
+      break;
+    case NG_FMT_CSV:
+      if(r->col) res_put(r, ",", 1);
+      break;
+    case NG_FMT_JSON:
+      res_put(r, r->col ? "," : "{", 1);
+      res_put_quoted(r, c->name);
+      res_put(r, ":", 1);
+      break;
+  }
+  r->col++;
+  return c;
+}
+
+void ng_result_int(struct ng_result *r, long long val) {
+  const struct ng_result_col *c = res_next(r);
+  int64_t v = val;
+
+  if(c == NULL) return;
+  if(r->format == NG_FMT_BINARY) {
+    res_put(r, &v, sizeof(v));
+  } else if(r->format == NG_FMT_TEXT && c->textfmt) {
+    res_printf(r, c->textfmt, val);
+  } else {
+    res_printf(r, "%lld", val);
+  }
+}
+
+void ng_result_double(struct ng_result *r, double val) {
+  const struct ng_result_col *c = res_next(r);
+
+  if(c == NULL) return;
+  switch(r->format) {
+    case NG_FMT_BINARY:
+      res_put(r, &val, sizeof(val));
+      break;
+    case NG_FMT_TEXT:
+      res_printf(r, c->textfmt ? c->textfmt : "%.2lf", val);
+      break;
+    case NG_FMT_JSON:
+      /* JSON has no inf/nan */
+      if(!isfinite(val)) {
+        res_put(r, "null", 4);
+        break;
+      }
+      /* fall through */
+    default:
+      res_printf(r, "%.9g", val);
+  }
+}
+
+void ng_result_string(struct ng_result *r, const char *val) {
+  const struct ng_result_col *c = res_next(r);
+
+  if(c == NULL) return;
+  switch(r->format) {
+    case NG_FMT_BINARY:
+      res_put_bstring(r, val);
+      break;
+    case NG_FMT_TEXT:
+      res_printf(r, c->textfmt ? c->textfmt : "%s", val);
+      break;
+    default:
+      res_put_quoted(r, val);
+  }
+}
+
+void ng_result_end(struct ng_result *r) {
+  if(r->col != r->ncols) {
+    ng_error("result record has %i of %i columns", r->col, r->ncols);
+  }
+  switch(r->format) {
+    case NG_FMT_JSON:
+      res_put(r, "}\n", 2);
+      break;
+    case NG_FMT_TEXT:
+    case NG_FMT_CSV:
+      res_put(r, "\n", 1);
+      break;
+  }
+  r->col = 0;
+}
+
+FILE *ng_result_textfile(struct ng_result *r) {
+  if(r->format == NG_FMT_TEXT) {
+    ng_result_flush(r);
+    return r->fp;
+  }
+  if(r->notes == NULL) {
+    r->notes = open_memstream(&r->notebuf, &r->notelen);
+    if(r->notes == NULL) ng_perror("Could not buffer the notes of the results");
+  }
+  return r->notes;
+}
+
+void ng_result_close(struct ng_result *r) {
+  if(r == NULL) return;
+  res_put_notes(r);
+  ng_result_flush(r);
+  fclose(r->fp);
+  free(r);
+}
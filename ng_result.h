@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_RESULT_H_
+#define NG_RESULT_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** result formats (-F/--format) */
+#define NG_FMT_TEXT   0
+#define NG_FMT_CSV    1
+#define NG_FMT_JSON   2
+#define NG_FMT_BINARY 3
+
+/** column types */
+#define NG_RES_INT    0
+#define NG_RES_DOUBLE 1
+#define NG_RES_STRING 2
+
+/** size of the write buffer of a result sink */
+#define NG_RESULT_BUFSIZE 65536
+
+/** binary format: "NGRB", version, byte order mark */
+#define NG_RESULT_MAGIC   "NGRB"
+#define NG_RESULT_VERSION 2
+
+/** binary format: tag byte in front of every record */
+#define NG_RESULT_TAG_RECORD 0
+#define NG_RESULT_TAG_NOTE   1
+#define NG_RESULT_BOM     0x01020304
+
+/**
+ * One column of a result record. textfmt is the printf format
+ * used in text mode (it may contain decorations like "(%.2lf" to
+ * reproduce the classic "A - B C (D E)" rows), the other formats
+ * only use name and type.
+ */
+struct ng_result_col {
+  const char *name;
+  int type;
+  const char *textfmt;
+};
+
+/**
+ * Result sink - patterns emit typed records into it and it writes
+ * them buffered in the format selected with -F.
+ */
+struct ng_result {
+  FILE *fp;
+  int format;
+  const struct ng_result_col *cols;
+  int ncols;
+  /** next column of the current record */
+  int col;
+  size_t len;
+  char buf[NG_RESULT_BUFSIZE];
+  /** "#" lines written to ng_result_textfile() in the other formats */
+  FILE *notes;
+  char *notebuf;
+  size_t notelen;
+};
+
+/** returns the NG_FMT_* value for name or -1 if unknown */
+int ng_result_parse_format(const char *name);
+
+/**
+ * Creates a sink on fp (opened with open_output_file) in the global
+ * format and writes the format header (host information in text mode,
+ * column names for CSV, the schema for binary).
+ */
+struct ng_result *ng_result_open(FILE *fp, const char *pattern, const struct ng_result_col *cols, int ncols);
+
+/** writes text (e.g. the "##" legend) - ignored for all but text mode */
+void ng_result_comment(struct ng_result *r, const char *text);
+
+/** append the next value of the current record */
+void ng_result_int(struct ng_result *r, long long val);
+void ng_result_double(struct ng_result *r, double val);
+void ng_result_string(struct ng_result *r, const char *val);
+/** finish the current record */
+void ng_result_end(struct ng_result *r);
+
+/** writes the buffer to the file */
+void ng_result_flush(struct ng_result *r);
+
+/**
+ * Flushes and returns the file for additional "#" lines (e.g.
+ * ng_hist_write). In the other formats the lines become notes in
+ * front of the next record: CSV keeps them as "#" lines, JSON writes
+ * {"note":"..."} objects and binary NG_RESULT_TAG_NOTE records.
+ */
+FILE *ng_result_textfile(struct ng_result *r);
+
+/** flushes, closes the file and frees the sink */
+void ng_result_close(struct ng_result *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_RESULT_H_ */
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+#include "netgauge.h"
+#include "ng_schedule.h"
+
+/* state of the adaptive schedule - a pattern walks the sizes once */
+static struct {
+   long last;            /* size returned last (-1: none) */
+   long grid;            /* last size of the regular schedule */
+   long rsize;           /* size and value of the last report */
+   double rvalue;
+   int npoints;          /* the current segment: a-b */
+   long ax, bx;
+   double ay, by;
+   long lo, hi;          /* bisection interval (hi == 0: inactive) */
+   double hiy;
+   long cx;              /* regular size that revealed the knee */
+   double cy;
+} sched = {-1, 0, -1, 0.0, 0, 0, 0, 0.0, 0.0, 0, 0, 0.0, 0, 0.0};
+
+static int cmp_size(const void *a, const void *b) {
+   unsigned long x = *(const unsigned long *)a, y = *(const unsigned long *)b;
+   return (x > y) - (x < y);
+}
+
+int ng_schedule_parse(const char *list, struct ng_options *options) {
+   unsigned long *sizes = NULL;
+   const char *p = list;
+   char *end;
+   int n = 0, i, j;
+   long size;
+
+   while (*p) {
+      size = strtol(p, &end, 10);
+      if (end == p || size < 1 || (*end != ',' && *end != '\0')) {
+         free(sizes);
+         return 1;
+      }
+      sizes = realloc(sizes, (n + 1) * sizeof(*sizes));
+      sizes[n++] = size;
+      p = *end ? end + 1 : end;
+   }
+   if (n == 0) return 1;
+
+   qsort(sizes, n, sizeof(*sizes), cmp_size);
+   for (i = 1, j = 1; i < n; i++) {
+      if (sizes[i] != sizes[j - 1]) sizes[j++] = sizes[i];
+   }
+   options->size_list = sizes;
+   options->size_count = j;
+   options->min_datasize = sizes[0];
+   options->max_datasize = sizes[j - 1];
+   return 0;
+}
+
+int ng_schedule_enabled(const struct ng_options *options) {
+   return options->size_list != NULL || options->adaptive;
+}
+
+void ng_schedule_report(long size, double value) {
+   sched.rsize = size;
+   sched.rvalue = value;
+}
+
+/* the regular schedule: the list or the geometric progression */
+static long grid_next(long size, const struct ng_options *options, long max_datasize) {
+   int i;
+
+   if (options->size_list) {
+      for (i = 0; i < options->size_count; i++) {
+         if ((long)options->size_list[i] > size)
+            return (long)options->size_list[i] <= max_datasize ? (long)options->size_list[i] : -1;
+      }
+      return -1;
+   }
+
+   /* after the maximum size has been
+    * reached a negative value will be returned
+    */
+   if (size < max_datasize) {
+      int x, data_inc;
+
+      frexp(size * pow(0.5, options->grad_datasize-1), &x);
+      data_inc = pow(2.0, --x);
+      /* ensure a data size increment at least of 1 and
+       * at most of the difference to the maximum data size
+       */
+      return size + ng_min(ng_max(data_inc, 1), max_datasize - size);
+   }
+   return -1;
+}
+
+/* does (x, y) lie on the line through the current segment? */
+static int on_segment(long x, double y) {
+   double pred = sched.by + (sched.by - sched.ay) * (x - sched.bx) / (double)(sched.bx - sched.ax);
+
+   return fabs(y - pred) <= NG_SCHED_KNEE_TOL * fabs(y);
+}
+
+/* the next bisection point or -1 if the knee is narrow enough */
+static long knee_next(void) {
+   if (sched.hi - sched.lo > ng_max(1, sched.lo / NG_SCHED_KNEE_RES))
+      return sched.lo + (sched.hi - sched.lo) / 2;
+
+   ng_info(NG_VNORM, "Knee between %ld and %ld bytes", sched.lo, sched.hi);
+   /* the new segment starts behind the knee */
+   if (sched.hi == sched.cx) {
+      sched.npoints = 1;
+   } else {
+      sched.npoints = 2;
+      sched.ax = sched.hi;
+      sched.ay = sched.hiy;
+   }
+   sched.bx = sched.cx;
+   sched.by = sched.cy;
+   sched.hi = 0;
+   return -1;
+}
+
+long ng_schedule_next(long size, const struct ng_options *options, long max_datasize) {
+   long next;
+   int have = (sched.rsize == size);
+
+   /* the pattern started over */
+   if (size != sched.last) {
+      sched.grid = size;
+      sched.npoints = 0;
+      sched.hi = 0;
+   }
+   sched.rsize = -1;
+   /* no result - a running bisection is abandoned */
+   if (!have) sched.hi = 0;
+
+   if (options->adaptive && have) {
+      double y = sched.rvalue;
+
+      if (sched.hi) {
+         if (on_segment(size, y)) {
+            sched.lo = size;
+         } else {
+            sched.hi = size;
+            sched.hiy = y;
+         }
+         if ((next = knee_next()) > 0) return sched.last = next;
+      } else if (sched.npoints >= 2 && !on_segment(size, y)) {
+         sched.lo = sched.bx;
+         sched.hi = sched.cx = size;
+         sched.hiy = sched.cy = y;
+         if ((next = knee_next()) > 0) return sched.last = next;
+      } else {
+         sched.ax = sched.bx;
+         sched.ay = sched.by;
+         sched.bx = size;
+         sched.by = y;
+         sched.npoints++;
+      }
+   }
+
+   next = grid_next(sched.grid, options, max_datasize);
+   sched.grid = next;
+   return sched.last = next;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_SCHEDULE_H_
+#define NG_SCHEDULE_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** relative deviation from the extrapolated segment that marks a knee */
+#define NG_SCHED_KNEE_TOL 0.1
+
+/** a knee is located if it is narrowed down to lo/NG_SCHED_KNEE_RES bytes */
+#define NG_SCHED_KNEE_RES 16
+
+/**
+ * Parses a comma separated list of message sizes into
+ * options->size_list (sorted, without duplicates) and sets the
+ * minimum and maximum data size accordingly.
+ *
+ * @return non-zero if the list is empty or contains invalid sizes
+ */
+int ng_schedule_parse(const char *list, struct ng_options *options);
+
+/** true if the user asked for a size list or the adaptive schedule */
+int ng_schedule_enabled(const struct ng_options *options);
+
+/**
+ * Reports the measured value (e.g. the median latency) of the size
+ * that was just tested. The adaptive schedule bisects between two
+ * sizes if the value leaves the line through the previous two sizes.
+ * Only the reports of rank 0 are used.
+ */
+void ng_schedule_report(long size, double value);
+
+/**
+ * Returns the size to test after size (-1 at the end): the next
+ * size of the list or the geometric progression, or a bisection
+ * point if the adaptive schedule found a knee after size.
+ */
+long ng_schedule_next(long size, const struct ng_options *options, long max_datasize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_SCHEDULE_H_ */
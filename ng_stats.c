@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+#include "netgauge.h"
+#include "ng_stats.h"
+#include <float.h>
+
+/* bucket i holds values in (gamma^(i-1+minidx), gamma^(i+minidx)] */
+static double stats_lgamma = 0; /* log(gamma) */
+static int stats_minidx = 0;
+
+static void stats_setup(void) {
+  double gamma = (1+NG_STATS_ALPHA)/(1-NG_STATS_ALPHA);
+  stats_lgamma = log(gamma);
+  stats_minidx = (int)ceil(log(NG_STATS_MIN_VALUE)/stats_lgamma);
+}
+
+static inline int stats_index(double x) {
+  int idx = (int)ceil(log(x)/stats_lgamma) - stats_minidx;
+  if(idx < 0) idx = 0;
+  if(idx >= NG_STATS_BINS) idx = NG_STATS_BINS-1;
+  return idx;
+}
+
+/* the value that has the same relative error to both bucket bounds */
+static inline double stats_value(int idx) {
+  return 2*exp((idx+stats_minidx)*stats_lgamma)/(1+exp(stats_lgamma));
+}
+
+void ng_stats_init(struct ng_stats *s) {
+  if(stats_lgamma == 0) stats_setup();
+  memset(s, 0, sizeof(struct ng_stats));
+  s->min = DBL_MAX;
+  s->max = -DBL_MAX;
+}
+
+void ng_stats_add(struct ng_stats *s, double x) {
+  double delta = x - s->mean;
+
+  s->n++;
+  s->mean += delta/s->n;
+  s->m2 += delta*(x - s->mean);
+  if(x < s->min) s->min = x;
+  if(x > s->max) s->max = x;
+
+  if(x < NG_STATS_MIN_VALUE) s->zero++;
+  else s->bins[stats_index(x)]++;
+}
+
+void ng_stats_merge(struct ng_stats *dst, const struct ng_stats *src) {
+  unsigned long long n = dst->n + src->n;
+  double delta = src->mean - dst->mean;
+  int i;
+
+  if(src->n == 0) return;
+
+  /* Chan et al.'s parallel variant of Welford */
+  dst->m2 += src->m2 + delta*delta*((double)dst->n*(double)src->n/(double)n);
+  dst->mean += delta*(double)src->n/(double)n;
+  dst->n = n;
+  if(src->min < dst->min) dst->min = src->min;
+  if(src->max > dst->max) dst->max = src->max;
+
+  dst->zero += src->zero;
+  for(i=0; i<NG_STATS_BINS; i++) dst->bins[i] += src->bins[i];
+}
+
+double ng_stats_mean(const struct ng_stats *s) {
+  return s->mean;
+}
+
+double ng_stats_stddev(const struct ng_stats *s) {
+  if(s->n < 2) return 0;
+  return sqrt(s->m2/(s->n-1));
+}
+
+double ng_stats_quantile(const struct ng_stats *s, double q) {
+  unsigned long long rank, cnt;
+  double val;
+  int i;
+
+  if(s->n == 0) return 0;
+  if(q <= 0) return s->min;
+  if(q >= 1) return s->max;
+
+  /* same element nth_element(..., begin()+size()/2, ...) would pick */
+  rank = (unsigned long long)(q*s->n);
+  cnt = s->zero;
+  if(rank < cnt) return s->min;
+  val = s->max;
+  for(i=0; i<NG_STATS_BINS; i++) {
+    cnt += s->bins[i];
+    if(rank < cnt) {
+      val = stats_value(i);
+      break;
+    }
+  }
+  /* the bucket value may be slightly outside of the observed range */
+  if(val < s->min) val = s->min;
+  if(val > s->max) val = s->max;
+  return val;
+}
+
+unsigned long long ng_stats_count_outside(const struct ng_stats *s, double lo, double hi) {
+  unsigned long long cnt = 0;
+  int i;
+
+  if(s->zero && lo > s->min) cnt += s->zero;
+  for(i=0; i<NG_STATS_BINS; i++) {
+    double val;
+    if(!s->bins[i]) continue;
+    val = stats_value(i);
+    if(val < lo || val > hi) cnt += s->bins[i];
+  }
+  return cnt;
+}
+
+int ng_stats_quantile_ci(const struct ng_stats *s, double q, double z, double *lo, double *hi) {
+  double n = (double)s->n, spread;
+
+  if(s->n < 2) return 1;
+  /* the rank of the q-quantile is binomial(n, q) distributed */
+  spread = z*sqrt(n*q*(1-q));
+  /* too few samples to bound the interval (e.g. tail quantiles) */
+  if(floor(n*q - spread) < 0 || ceil(n*q + spread) > n-1) return 1;
+  *lo = ng_stats_quantile(s, floor(n*q - spread)/n);
+  *hi = ng_stats_quantile(s, ceil(n*q + spread)/n);
+  return 0;
+}
+
+#ifdef NG_MPI
+static void stats_merge_op(void *in, void *inout, int *len, MPI_Datatype *type) {
+  struct ng_stats *src = (struct ng_stats*)in, *dst = (struct ng_stats*)inout;
+  int i;
+
+  for(i=0; i<*len; i++) ng_stats_merge(&dst[i], &src[i]);
+}
+
+void ng_stats_reduce(struct ng_stats *s, struct ng_stats *res, int root, MPI_Comm comm) {
+  MPI_Datatype type;
+  MPI_Op op;
+
+  MPI_Type_contiguous(sizeof(struct ng_stats), MPI_BYTE, &type);
+  MPI_Type_commit(&type);
+  MPI_Op_create(stats_merge_op, 1, &op);
+  MPI_Reduce(s, res, 1, type, op, root, comm);
+  MPI_Op_free(&op);
+  MPI_Type_free(&type);
+}
+#endif
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_STATS_H_
+#define NG_STATS_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** relative accuracy of the quantiles (DDSketch with 1% error) */
+#define NG_STATS_ALPHA 0.01
+/** smallest value that gets its own bucket - everything below (and 0)
+ * goes into the zero bucket */
+#define NG_STATS_MIN_VALUE 1e-6
+/** number of buckets - covers NG_STATS_MIN_VALUE .. 1e12 */
+#define NG_STATS_BINS 2080
+
+/**
+ * Online statistics for one series of samples. Mean and variance are
+ * computed with Welford's method, quantiles come from a fixed size
+ * log-bucketed sketch. The memory doesn't grow with the number of
+ * samples and two objects can be merged (e.g., across ranks).
+ */
+struct ng_stats {
+  unsigned long long n;
+  double mean, m2; /* Welford */
+  double min, max;
+  unsigned long long zero; /* samples < NG_STATS_MIN_VALUE */
+  unsigned long long bins[NG_STATS_BINS];
+};
+
+void ng_stats_init(struct ng_stats *s);
+void ng_stats_add(struct ng_stats *s, double x);
+void ng_stats_merge(struct ng_stats *dst, const struct ng_stats *src);
+
+double ng_stats_mean(const struct ng_stats *s);
+/** sample standard deviation (like standard_deviation() in ng_tools.hpp) */
+double ng_stats_stddev(const struct ng_stats *s);
+/** q in [0,1], e.g. 0.5 for the median */
+double ng_stats_quantile(const struct ng_stats *s, double q);
+/** (approximate) number of samples outside of [lo,hi] */
+unsigned long long ng_stats_count_outside(const struct ng_stats *s, double lo, double hi);
+/**
+ * distribution-free confidence interval of quantile q from the order
+ * statistics around rank q*n (z = 1.96 for 95%), as precise as the
+ * sketch (NG_STATS_ALPHA); returns non-zero if there are too few samples
+ * to bound it
+ */
+int ng_stats_quantile_ci(const struct ng_stats *s, double q, double z, double *lo, double *hi);
+
+#ifdef NG_MPI
+/** merges the objects of all ranks in comm into res on root */
+void ng_stats_reduce(struct ng_stats *s, struct ng_stats *res, int root, MPI_Comm comm);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_STATS_H_ */
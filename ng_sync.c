@@ -200,6 +200,68 @@ static unsigned long long gnext=0; /* start-time for next round - synchronized w
                              messages are *not* smaller than the current
                              smallest one */
 
+/* drift model: every run of ng_sync_init_stage1() adds one (local time,
+ * offset to rank 0) sample and the offset and skew are fit with least
+ * squares over the last NG_SYNC_SAMPLES samples */
+#define NG_SYNC_SAMPLES 16
+#define NG_SYNC_RESYNC_SEC 30 /* re-measure in stage2 if the newest sample is older */
+
+static unsigned long long sync_local[NG_SYNC_SAMPLES]; /* local time of the sample */
+static long long sync_off[NG_SYNC_SAMPLES]; /* offset (global - local) */
+static int sync_nsamples=0, sync_head=0, sync_commsize=0;
+static unsigned long long sync_tref=0; /* local time of the newest sample */
+static long long sync_oref=0; /* offset of the newest sample */
+static double sync_offset=0; /* fitted offset at sync_tref relative to sync_oref */
+static double sync_skew=0; /* fitted drift in ticks per local tick */
+
+static void sync_add_sample(unsigned long long local, long long off) {
+  double xavg=0, yavg=0, sxy=0, sxx=0;
+  int i;
+
+  sync_local[sync_head] = local;
+  sync_off[sync_head] = off;
+  sync_head = (sync_head+1) % NG_SYNC_SAMPLES;
+  if(sync_nsamples < NG_SYNC_SAMPLES) sync_nsamples++;
+
+  sync_tref = local;
+  sync_oref = off;
+
+  /* x and y relative to the newest sample to keep the doubles small */
+  for(i=0; i<sync_nsamples; i++) {
+    xavg += (double)(long long)(sync_local[i]-sync_tref);
+    yavg += (double)(sync_off[i]-sync_oref);
+  }
+  xavg /= sync_nsamples;
+  yavg /= sync_nsamples;
+  for(i=0; i<sync_nsamples; i++) {
+    double x = (double)(long long)(sync_local[i]-sync_tref) - xavg;
+    double y = (double)(sync_off[i]-sync_oref) - yavg;
+    sxy += x*y;
+    sxx += x*x;
+  }
+  sync_skew = (sxx > 0) ? sxy/sxx : 0;
+  sync_offset = yavg - sync_skew*xavg;
+}
+
+/* the offset (global - local) at local time t */
+static inline long long sync_offset_at(unsigned long long t) {
+  return sync_oref + (long long)(sync_offset + sync_skew*(double)(long long)(t-sync_tref));
+}
+
+unsigned long long ng_sync_local_to_global(unsigned long long local) {
+  return local + sync_offset_at(local);
+}
+
+unsigned long long ng_sync_global_to_local(unsigned long long global) {
+  /* the offset changes slowly - one fixed point step is enough */
+  unsigned long long local = global - sync_offset_at(global - sync_oref);
+  return global - sync_offset_at(local);
+}
+
+double ng_sync_skew(void) {
+  return sync_skew;
+}
+
 static inline unsigned long long p2psynch(int peer, int client, int server, MPI_Comm comm) {
   unsigned long long diff;
   int notsmaller = 0; /* count number of RTTs that are *not* smaller than
@@ -281,6 +343,13 @@ void ng_sync_init_stage1(MPI_Comm comm) {
 
   res = MPI_Comm_rank(comm, &r);
   res = MPI_Comm_size(comm, &p);
+
+  /* the old samples are offsets to a different rank 0 */
+  if(p != sync_commsize) {
+    sync_nsamples = 0;
+    sync_head = 0;
+    sync_commsize = p;
+  }
   
   /* reallocate tha diffs array with the right size */
   if(diffs != NULL) free(diffs);
@@ -420,6 +489,13 @@ void ng_sync_init_stage1(MPI_Comm comm) {
   }
   //printf("[%i] diff: %ld\n", r, gdiff);
 
+  { HRT_TIMESTAMP_T ts;
+    unsigned long long now;
+    HRT_GET_TIMESTAMP(ts);
+    HRT_GET_TIME(ts, now);
+    sync_add_sample(now, (long long)gdiff);
+  }
+
   /*if(!r) {
     int i;
     for(i=0; i<p; i++) {
@@ -433,10 +509,21 @@ void ng_sync_init_stage1(MPI_Comm comm) {
 /* done at the beginning of every new size */
 void ng_sync_init_stage2(MPI_Comm comm, unsigned long long *win) {
   unsigned long long time, bcasttime; /* measure MPI_Bcast() time :-/ */
-  int i;
+  int i, r, resync=0;
 
   HRT_TIMESTAMP_T t1, t2;
 
+  /* rank 0 decides if the offsets are too old - this is a collective
+   * point anyway, so the resync doesn't disturb a running measurement */
+  MPI_Comm_rank(comm, &r);
+  if(!r) {
+    HRT_GET_TIMESTAMP(t1);
+    HRT_GET_TIME(t1,time);
+    resync = (sync_nsamples == 0) ||
+             (time - sync_tref > NG_SYNC_RESYNC_SEC*g_timerfreq);
+  }
+  MPI_Bcast(&resync, 1, MPI_INT, 0, comm);
+  if(resync) ng_sync_init_stage1(comm);
 
   HRT_GET_TIMESTAMP(t1);
   for(i=0; i<10; i++) {
@@ -460,7 +547,8 @@ void ng_sync_init_stage2(MPI_Comm comm, unsigned long long *win) {
   gnext = time + bcasttime;
   MPI_Bcast(&gnext, 1, MPI_UNSIGNED_LONG_LONG, 0, comm);
 
-  gnext= gnext - gdiff; /* adjust rank 0's time to local time */
+  /* gnext stays in rank 0's (global) time - ng_sync() converts it with
+   * the drift model */
 }
 
 int syncctr=0;
@@ -470,18 +558,20 @@ volatile int NG_Dummy_var=0; /* avoid optimizations */
 long ng_sync(unsigned long long win) {
   long err = 0;
   HRT_TIMESTAMP_T ts;
-  unsigned long long time;
+  unsigned long long time, lnext;
+
+  lnext = ng_sync_global_to_local(gnext); /* adjust rank 0's time to local time */
 
   HRT_GET_TIMESTAMP(ts);
   HRT_GET_TIME(ts,time);
 
-  if(time > gnext) {
+  if(time > lnext) {
     //printf("[%i] tooooo late!!!! :-( (%lf)\n", mpiargs->rank, (MPI_Wtime()-gnext)*1e6);
-    err = time-gnext;
+    err = time-lnext;
   } else {
     /* wait */
     //printf("waiting ... %llu\n", gnext-time);
-    while(time < gnext) {
+    while(time < lnext) {
       NG_Dummy_var++;
       HRT_GET_TIMESTAMP(ts);
       HRT_GET_TIME(ts,time);
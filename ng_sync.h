@@ -10,3 +10,11 @@
 void ng_sync_init_stage1(MPI_Comm comm);
 void ng_sync_init_stage2(MPI_Comm comm, unsigned long long *win);
 long ng_sync(unsigned long long win);
+
+/** converts a local timestamp (HRT ticks) to rank 0's time using the
+ * fitted offset and skew */
+unsigned long long ng_sync_local_to_global(unsigned long long local);
+/** converts rank 0's time back to a local timestamp */
+unsigned long long ng_sync_global_to_local(unsigned long long global);
+/** the fitted clock drift relative to rank 0 (ticks per tick) */
+double ng_sync_skew(void);
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+#include "netgauge.h"
+#include "hrtimer/hrtimer.h"
+#include "ng_trace.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+
+#ifndef MAP_POPULATE
+#define MAP_POPULATE 0
+#endif
+
+struct ng_trace *ng_trace_open(const char *pattern) {
+  struct ng_trace *t;
+  char fname[1024];
+  void *map;
+
+  if(g_options.trace_file == NULL) return NULL;
+
+  t = (struct ng_trace*)malloc(sizeof(struct ng_trace));
+  if(t == NULL) {
+    ng_error("Could not allocate memory for the trace");
+    return NULL;
+  }
+  t->rank = g_options.mpi_opts->worldrank;
+  t->capacity = g_options.trace_records;
+  t->pos = 0;
+  t->maplen = sizeof(struct ng_trace_hdr) + t->capacity*sizeof(struct ng_trace_rec);
+
+  snprintf(fname, sizeof(fname), "%s.%u", g_options.trace_file, t->rank);
+  t->fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0644);
+  if(t->fd < 0) {
+    ng_perror("Could not open trace file %s", fname);
+    free(t);
+    return NULL;
+  }
+  if(ftruncate(t->fd, t->maplen) != 0) {
+    ng_perror("Could not allocate %lu bytes for trace file %s", (unsigned long)t->maplen, fname);
+    close(t->fd);
+    free(t);
+    return NULL;
+  }
+  /* populate the mapping now so that the benchmark loop does not take
+   * page faults */
+  map = mmap(NULL, t->maplen, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, t->fd, 0);
+  if(map == MAP_FAILED) {
+    ng_perror("Could not map trace file %s", fname);
+    close(t->fd);
+    free(t);
+    return NULL;
+  }
+  t->hdr = (struct ng_trace_hdr*)map;
+  t->recs = (struct ng_trace_rec*)(t->hdr+1);
+
+  memcpy(t->hdr->magic, NG_TRACE_MAGIC, 4);
+  t->hdr->version = NG_TRACE_VERSION;
+  t->hdr->bom = NG_TRACE_BOM;
+  t->hdr->recsize = sizeof(struct ng_trace_rec);
+  t->hdr->timerfreq = (uint64_t)g_timerfreq;
+  t->hdr->capacity = t->capacity;
+  t->hdr->count = 0;
+  strncpy(t->hdr->pattern, pattern, sizeof(t->hdr->pattern)-1);
+
+  ng_info(NG_VLEV1, "tracing up to %llu samples to %s.<rank>",
+          (unsigned long long)t->capacity, g_options.trace_file);
+  return t;
+}
+
+void ng_trace_close(struct ng_trace *t) {
+  uint64_t count;
+
+  if(t == NULL) return;
+  count = t->hdr->count;
+  if(count > t->capacity) {
+    ng_info(NG_VLEV1 | NG_VPALL, "trace ring wrapped, kept the last %llu of %llu samples",
+            (unsigned long long)t->capacity, (unsigned long long)count);
+  }
+  munmap(t->hdr, t->maplen);
+  if(count < t->capacity) {
+    ftruncate(t->fd, sizeof(struct ng_trace_hdr) + count*sizeof(struct ng_trace_rec));
+  }
+  close(t->fd);
+  free(t);
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_TRACE_H_
+#define NG_TRACE_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NG_TRACE_MAGIC   "NGTR"
+#define NG_TRACE_VERSION 1
+#define NG_TRACE_BOM     0x01020304
+/** peer of a sample that involves all other ranks (e.g. 1toN) */
+#define NG_TRACE_ALL     0xffffffff
+
+/**
+ * Trace file header (64 bytes). The samples follow it and form a
+ * ring of capacity records - if count > capacity the oldest sample
+ * is at index count % capacity.
+ */
+struct ng_trace_hdr {
+  char magic[4];
+  uint32_t version;
+  uint32_t bom;
+  uint32_t recsize;
+  /** timer ticks per second */
+  uint64_t timerfreq;
+  uint64_t capacity;
+  /** number of recorded samples (updated with every sample) */
+  uint64_t count;
+  char pattern[24];
+};
+
+/** one raw sample (32 bytes, host byte order) */
+struct ng_trace_rec {
+  /** send blocking time and full round trip time in ticks */
+  uint64_t block;
+  uint64_t rtt;
+  uint32_t size;
+  uint32_t iter;
+  uint32_t rank;
+  uint32_t peer;
+};
+
+struct ng_trace {
+  struct ng_trace_hdr *hdr;
+  struct ng_trace_rec *recs;
+  uint64_t pos;
+  uint64_t capacity;
+  uint32_t rank;
+  size_t maplen;
+  int fd;
+};
+
+/**
+ * Maps <trace file>.<rank> (-T) with room for -N samples and
+ * prefaults it. Returns NULL if tracing is not enabled.
+ */
+struct ng_trace *ng_trace_open(const char *pattern);
+
+/** truncates the file to the recorded samples and unmaps it */
+void ng_trace_close(struct ng_trace *t);
+
+/** stores a sample - no formatting or syscalls, t may be NULL */
+static inline void ng_trace_record(struct ng_trace *t, unsigned long long block,
+    unsigned long long rtt, long size, long iter, unsigned int peer) {
+  struct ng_trace_rec *r;
+
+  if(t == NULL) return;
+  r = &t->recs[t->pos];
+  r->block = block;
+  r->rtt = rtt;
+  r->size = (uint32_t)size;
+  r->iter = (uint32_t)iter;
+  r->rank = t->rank;
+  r->peer = peer;
+  if(++t->pos == t->capacity) t->pos = 0;
+  t->hdr->count++;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_TRACE_H_ */
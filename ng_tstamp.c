@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+#include "netgauge.h"
+#include "ng_tstamp.h"
+
+#ifdef NG_HAVE_TSTAMP
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+#include <linux/sockios.h>
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <ifaddrs.h>
+#ifdef HAVE_LINUX_IF_PACKET_H
+#include <linux/if_packet.h>
+#endif
+#endif
+
+static const char *stage_names[NG_TSTAMP_STAGES] = {"send", "qdisc", "wire", "recv", "nic"};
+
+int ng_tstamp_mode(const char *arg) {
+   if (strcmp(arg, "sw") == 0) return NG_TSTAMP_SW;
+   if (strcmp(arg, "hw") == 0) return NG_TSTAMP_HW;
+   return -1;
+}
+
+#ifdef NG_HAVE_TSTAMP
+static inline unsigned long long ts_ns(const struct timespec *ts) {
+   return (unsigned long long)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+/* lets the NIC stamp all packets - needs CAP_NET_ADMIN */
+static void tstamp_enable_hw(int fd, const char *ifname) {
+   struct hwtstamp_config cfg;
+   struct ifreq ifr;
+
+   memset(&cfg, 0, sizeof(cfg));
+   cfg.tx_type = HWTSTAMP_TX_ON;
+   cfg.rx_filter = HWTSTAMP_FILTER_ALL;
+   memset(&ifr, 0, sizeof(ifr));
+   strncpy(ifr.ifr_name, ifname, IF_NAMESIZE - 1);
+   ifr.ifr_data = (void *)&cfg;
+   if (ioctl(fd, SIOCSHWTSTAMP, &ifr) < 0) {
+      ng_info(NG_VLEV1 | NG_VPALL, "%s has no hardware timestamps (%s) - using software only",
+              ifname, strerror(errno));
+      return;
+   }
+   ng_info(NG_VLEV2 | NG_VPALL, "Enabled hardware timestamps on %s", ifname);
+}
+
+int ng_tstamp_enable(int fd, int mode, const char *ifname) {
+   int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+               SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_TX_SCHED |
+               SOF_TIMESTAMPING_OPT_TSONLY;
+
+   if (mode == NG_TSTAMP_HW) {
+      flags |= SOF_TIMESTAMPING_TX_HARDWARE | SOF_TIMESTAMPING_RX_HARDWARE |
+               SOF_TIMESTAMPING_RAW_HARDWARE;
+      if (ifname) tstamp_enable_hw(fd, ifname);
+   }
+   if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+      ng_perror("Could not enable SO_TIMESTAMPING");
+      return 1;
+   }
+   return 0;
+}
+
+/* the SCM_TIMESTAMPING payload: software, (deprecated), hardware */
+static struct timespec *tstamp_find(struct msghdr *msg) {
+   struct cmsghdr *cmsg;
+
+   for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+      if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPING)
+         return (struct timespec *)CMSG_DATA(cmsg);
+   }
+   return NULL;
+}
+
+void ng_tstamp_rx(struct msghdr *msg, struct ng_timestamps *ts) {
+   struct timespec *stamp = tstamp_find(msg);
+
+   if (stamp == NULL) return;
+   if (stamp[0].tv_sec || stamp[0].tv_nsec) ts->sw_rx = ts_ns(&stamp[0]);
+   if (stamp[2].tv_sec || stamp[2].tv_nsec) ts->hw_rx = ts_ns(&stamp[2]);
+}
+
+/* the extended error that says which stamp this is */
+static struct sock_extended_err *tstamp_serr(struct msghdr *msg) {
+   struct cmsghdr *cmsg;
+
+   for (cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+      if ((cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_RECVERR) ||
+          (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)
+#ifdef PACKET_TX_TIMESTAMP
+          || (cmsg->cmsg_level == SOL_PACKET && cmsg->cmsg_type == PACKET_TX_TIMESTAMP)
+#endif
+         )
+         return (struct sock_extended_err *)CMSG_DATA(cmsg);
+   }
+   return NULL;
+}
+
+int ng_tstamp_reap(int fd, struct ng_timestamps *ts) {
+   char control[256];
+   struct msghdr msg;
+   struct sock_extended_err *serr;
+   struct timespec *stamp;
+
+   while (1) {
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+         if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+         if (errno == EINTR) continue;
+         ng_perror("Could not read the timestamps from the error queue");
+         return -1;
+      }
+      serr = tstamp_serr(&msg);
+      stamp = tstamp_find(&msg);
+      if (serr == NULL || stamp == NULL || serr->ee_origin != SO_EE_ORIGIN_TIMESTAMPING)
+         continue;
+
+      if (stamp[2].tv_sec || stamp[2].tv_nsec) {
+         ts->hw_tx = ts_ns(&stamp[2]);
+      } else if (serr->ee_info == SCM_TSTAMP_SCHED) {
+         ts->sched = ts_ns(&stamp[0]);
+      } else if (serr->ee_info == SCM_TSTAMP_SND) {
+         ts->sw_tx = ts_ns(&stamp[0]);
+      }
+   }
+}
+
+int ng_tstamp_inet_if(struct in_addr addr, char *name) {
+   struct ifaddrs *ifas, *ifa;
+   int ret = 1;
+
+   if (getifaddrs(&ifas) < 0) return 1;
+   for (ifa = ifas; ifa != NULL; ifa = ifa->ifa_next) {
+      if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_INET) continue;
+      if (((struct sockaddr_in *)ifa->ifa_addr)->sin_addr.s_addr != addr.s_addr) continue;
+      strncpy(name, ifa->ifa_name, IF_NAMESIZE - 1);
+      name[IF_NAMESIZE - 1] = '\0';
+      ret = 0;
+      break;
+   }
+   freeifaddrs(ifas);
+   return ret;
+}
+#endif
+
+void ng_tstamp_stats_init(struct ng_tstamp_stats *st) {
+   int i;
+
+   for (i = 0; i < NG_TSTAMP_STAGES; i++) ng_stats_init(&st->stage[i]);
+}
+
+/* adds b - a in usecs if both stamps exist */
+static inline void stats_span(struct ng_stats *s, unsigned long long a, unsigned long long b) {
+   if (a && b) ng_stats_add(s, ((double)b - (double)a) / 1e3);
+}
+
+void ng_tstamp_stats_add(struct ng_tstamp_stats *st, unsigned long long tsend,
+                         unsigned long long trecv, const struct ng_timestamps *ts) {
+   /* the send stage ends at the first stamp the kernel took */
+   stats_span(&st->stage[NG_TSTAMP_SEND], tsend, ts->sched ? ts->sched : ts->sw_tx);
+   stats_span(&st->stage[NG_TSTAMP_QDISC], ts->sched, ts->sw_tx);
+   stats_span(&st->stage[NG_TSTAMP_WIRE], ts->sw_tx, ts->sw_rx);
+   stats_span(&st->stage[NG_TSTAMP_RECV], ts->sw_rx, trecv);
+   stats_span(&st->stage[NG_TSTAMP_NIC], ts->hw_tx, ts->hw_rx);
+}
+
+void ng_tstamp_stats_write(FILE *fp, long size, const struct ng_tstamp_stats *st) {
+   const struct ng_stats *s;
+   int i;
+
+   if (fp == NULL) return;
+   for (i = 0; i < NG_TSTAMP_STAGES; i++) {
+      s = &st->stage[i];
+      if (s->n == 0) continue;
+      fprintf(fp, "#T %ld %s n %llu min %.2lf avg %.2lf med %.2lf max %.2lf [us]\n",
+              size, stage_names[i], s->n, s->min, ng_stats_mean(s),
+              ng_stats_quantile(s, 0.5), s->max);
+   }
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_TSTAMP_H_
+#define NG_TSTAMP_H_
+
+#include "netgauge.h"
+#include "ng_stats.h"
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#if defined(HAVE_LINUX_NET_TSTAMP_H) && defined(HAVE_LINUX_ERRQUEUE_H) && defined(SO_TIMESTAMPING)
+#define NG_HAVE_TSTAMP 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** timestamping modes (module option -E) */
+#define NG_TSTAMP_OFF 0
+#define NG_TSTAMP_SW  1
+#define NG_TSTAMP_HW  2
+
+/** sends between two error queue reads of a module (bounds the queue) */
+#define NG_TSTAMP_REAP 64
+
+/** stages of a round trip as seen from the sending socket */
+enum {
+   NG_TSTAMP_SEND,   /* user send -> qdisc (or driver) */
+   NG_TSTAMP_QDISC,  /* qdisc -> driver */
+   NG_TSTAMP_WIRE,   /* driver -> receive stack (wire and peer) */
+   NG_TSTAMP_RECV,   /* receive stack -> user */
+   NG_TSTAMP_NIC,    /* NIC tx -> NIC rx (hardware only) */
+   NG_TSTAMP_STAGES
+};
+
+/** per-stage statistics in usecs */
+struct ng_tstamp_stats {
+   struct ng_stats stage[NG_TSTAMP_STAGES];
+};
+
+/** the clock of the kernel timestamps in ns */
+static inline unsigned long long ng_tstamp_now(void) {
+   struct timespec ts;
+
+   clock_gettime(CLOCK_REALTIME, &ts);
+   return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/** parses "sw" or "hw", returns the mode or -1 */
+int ng_tstamp_mode(const char *arg);
+
+#ifdef NG_HAVE_TSTAMP
+/**
+ * Enables SO_TIMESTAMPING on fd. In hardware mode the NIC ifname is
+ * switched to timestamp all packets (if ifname is not NULL), failures
+ * there only leave the hardware fields at 0.
+ *
+ * @return non-zero on failure
+ */
+int ng_tstamp_enable(int fd, int mode, const char *ifname);
+
+/** copies the receive timestamps of a recvmsg() result to ts */
+void ng_tstamp_rx(struct msghdr *msg, struct ng_timestamps *ts);
+
+/**
+ * Reads the send timestamps in the error queue of fd into ts (the
+ * newest of each kind wins).
+ *
+ * @return values < 0 indicate errors
+ */
+int ng_tstamp_reap(int fd, struct ng_timestamps *ts);
+
+/** name of the interface with address addr (buffer of IF_NAMESIZE) */
+int ng_tstamp_inet_if(struct in_addr addr, char *name);
+#endif
+
+void ng_tstamp_stats_init(struct ng_tstamp_stats *st);
+/** adds the stages of a round trip between tsend and trecv (in ns) */
+void ng_tstamp_stats_add(struct ng_tstamp_stats *st, unsigned long long tsend,
+                         unsigned long long trecv, const struct ng_timestamps *ts);
+/** writes one "#T" comment line per stage with samples to fp */
+void ng_tstamp_stats_write(FILE *fp, long size, const struct ng_tstamp_stats *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_TSTAMP_H_ */
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/*  vim:sts=3:sw=3:ts=3:expandtab */
+#include "netgauge.h"
+#include "hrtimer/hrtimer.h"
+#include "ng_warmup.h"
+
+extern struct ng_options g_options;
+
+void ng_warmup_init(struct ng_warmup *w) {
+   HRT_TIMESTAMP_T t;
+
+   memset(w, 0, sizeof(*w));
+   HRT_GET_TIMESTAMP(t);
+   HRT_GET_TIME(t, w->start);
+}
+
+static int cmp_double(const void *a, const void *b) {
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x > y) - (x < y);
+}
+
+static double window_median(const double *win) {
+   double sorted[NG_WARMUP_WINDOW];
+
+   memcpy(sorted, win, sizeof(sorted));
+   qsort(sorted, NG_WARMUP_WINDOW, sizeof(double), cmp_double);
+   return sorted[NG_WARMUP_WINDOW / 2];
+}
+
+/* did the median stop drifting? (the ring halves are the two windows) */
+static int warmup_steady(const struct ng_warmup *w) {
+   const double *older = w->win, *newer = w->win + NG_WARMUP_WINDOW;
+   double m1, m2;
+
+   if (w->tests % (2 * NG_WARMUP_WINDOW)) {
+      older = w->win + NG_WARMUP_WINDOW;
+      newer = w->win;
+   }
+   m1 = window_median(older);
+   m2 = window_median(newer);
+   return fabs(m2 - m1) <= NG_WARMUP_TOL * m2;
+}
+
+int ng_warmup_done(struct ng_warmup *w, double sample, int measuring) {
+   HRT_TIMESTAMP_T t;
+   unsigned long long now;
+   int stop = 1, all = 0;
+
+   w->win[w->tests % (2 * NG_WARMUP_WINDOW)] = sample;
+   w->tests++;
+
+   if (w->tests % NG_WARMUP_WINDOW == 0 && w->tests >= 2 * NG_WARMUP_WINDOW &&
+       w->tests < (unsigned long)g_options.warmup) {
+      if (measuring) stop = warmup_steady(w);
+      all = stop;
+#ifdef NG_MPI
+      if (g_options.mpi && !w->local) MPI_Allreduce(&stop, &all, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#endif
+      w->steady = all;
+   }
+   if (!all && w->tests < (unsigned long)g_options.warmup) return 0;
+
+   HRT_GET_TIMESTAMP(t);
+   HRT_GET_TIME(t, now);
+   w->elapsed = HRT_GET_USEC(now - w->start);
+   return 1;
+}
+
+int ng_warmup_follow(struct ng_warmup *w, int done) {
+   HRT_TIMESTAMP_T t;
+   unsigned long long now;
+
+   w->tests++;
+   /* the peer stops at the cap, too, but its decision may get lost */
+   if (!done && w->tests < (unsigned long)g_options.warmup) return 0;
+
+   /* the detector stops before the cap */
+   w->steady = done && w->tests < (unsigned long)g_options.warmup;
+   HRT_GET_TIMESTAMP(t);
+   HRT_GET_TIME(t, now);
+   w->elapsed = HRT_GET_USEC(now - w->start);
+   return 1;
+}
+
+void ng_warmup_write(FILE *fp, long size, const struct ng_warmup *w) {
+   if (fp == NULL) return;
+   fprintf(fp, "#W %ld warmup %lu tests %.2lf ms %s\n", size, w->tests, w->elapsed / 1e3,
+           w->steady ? "steady" : (w->tests > 1 ? "max" : "fixed"));
+}
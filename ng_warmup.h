@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#ifndef NG_WARMUP_H_
+#define NG_WARMUP_H_
+
+#include "netgauge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** samples per window, the medians of the last two windows are compared */
+#define NG_WARMUP_WINDOW 8
+
+/** maximum relative drift of the median between two windows */
+#define NG_WARMUP_TOL 0.05
+
+/**
+ * Steady-state detector for the warmup of one message size. The
+ * warmup ends when the median of the last NG_WARMUP_WINDOW samples
+ * is within NG_WARMUP_TOL of the median of the window before (TCP
+ * slow start, first touch page faults and the CPU clock ramp show up
+ * as a drift), or after --warmup tests.
+ */
+struct ng_warmup {
+   double win[2 * NG_WARMUP_WINDOW]; /* ring of the last two windows */
+   unsigned long tests;              /* warmup tests so far */
+   unsigned long long start;         /* timer ticks at ng_warmup_init() */
+   double elapsed;                   /* usecs spent on the warmup */
+   int steady;                       /* ended by the detector */
+   int local;                        /* decide without the MPI_Allreduce */
+};
+
+/** starts the warmup of a new size */
+void ng_warmup_init(struct ng_warmup *w);
+
+/**
+ * Adds the sample (e.g. the RTT in usecs) of a warmup test. The
+ * decision is collective over MPI_COMM_WORLD at window boundaries, so
+ * all ranks must call this for every warmup test. Ranks that don't
+ * measure pass measuring = 0. With w->local set the rank decides alone
+ * and the pattern has to tell its peers.
+ *
+ * @return non-zero if the warmup is over (this test was the last one)
+ */
+int ng_warmup_done(struct ng_warmup *w, double sample, int measuring);
+
+/**
+ * Counts a warmup test on a rank that got the decision (done) of a
+ * local detector from its peer. The warmup also ends after --warmup
+ * tests, where the peer's detector stops, in case its decision got
+ * lost.
+ *
+ * @return non-zero if the warmup is over
+ */
+int ng_warmup_follow(struct ng_warmup *w, int done);
+
+/** writes the "#W" line (warmup tests, time and outcome) to fp */
+void ng_warmup_write(FILE *fp, long size, const struct ng_warmup *w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NG_WARMUP_H_ */
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+/* vim: set expandtab tabstop=2 shiftwidth=2 autoindent smartindent: */
+
+/*
+ * ngtrace - converts the raw sample traces written by netgauge -T into
+ * text (or CSV with -c). Usage: ngtrace [-c] tracefile...
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ng_trace.h"
+
+static int convert(const char *fname, int csv, int first) {
+  struct ng_trace_hdr *hdr;
+  struct ng_trace_rec *recs, *r;
+  struct stat st;
+  uint64_t n, start, i, avail;
+  double usec;
+  void *map;
+  int fd;
+
+  fd = open(fname, O_RDONLY);
+  if(fd < 0 || fstat(fd, &st) != 0) {
+    perror(fname);
+    return 1;
+  }
+  if((size_t)st.st_size < sizeof(struct ng_trace_hdr)) {
+    fprintf(stderr, "%s: not a netgauge trace\n", fname);
+    close(fd);
+    return 1;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(map == MAP_FAILED) {
+    perror(fname);
+    return 1;
+  }
+  hdr = (struct ng_trace_hdr*)map;
+  recs = (struct ng_trace_rec*)(hdr+1);
+
+  if(memcmp(hdr->magic, NG_TRACE_MAGIC, 4) != 0) {
+    fprintf(stderr, "%s: not a netgauge trace\n", fname);
+    munmap(map, st.st_size);
+    return 1;
+  }
+  if(hdr->bom != NG_TRACE_BOM || hdr->version != NG_TRACE_VERSION ||
+     hdr->recsize != sizeof(struct ng_trace_rec)) {
+    fprintf(stderr, "%s: trace version %u, record size %u or byte order not supported\n",
+            fname, hdr->version, hdr->recsize);
+    munmap(map, st.st_size);
+    return 1;
+  }
+
+  /* the ring keeps the last capacity samples */
+  n = hdr->count;
+  start = 0;
+  if(n > hdr->capacity) {
+    start = n % hdr->capacity;
+    n = hdr->capacity;
+  }
+  avail = (st.st_size - sizeof(struct ng_trace_hdr)) / sizeof(struct ng_trace_rec);
+  if(n > avail) {
+    fprintf(stderr, "%s: truncated trace (%llu of %llu samples)\n", fname,
+            (unsigned long long)avail, (unsigned long long)n);
+    n = avail;
+    start = 0;
+  }
+  usec = 1e6/(double)hdr->timerfreq;
+
+  if(csv) {
+    if(first) printf("pattern,rank,peer,iter,size,block_ticks,rtt_ticks,block_us,rtt2_us\n");
+  } else {
+    printf("# %s: pattern %s, %llu samples, timer %llu Hz\n", fname, hdr->pattern,
+           (unsigned long long)n, (unsigned long long)hdr->timerfreq);
+    printf("# rank peer iter size block-ticks rtt-ticks block[us] rtt/2[us]\n");
+  }
+  for(i=0; i<n; i++) {
+    r = &recs[(start+i) % hdr->capacity];
+    printf(csv ? "%s,%u,%d,%u,%u,%llu,%llu,%.4f,%.4f\n" : "%.0s%u %d %u %u %llu %llu %.4f %.4f\n",
+           hdr->pattern, r->rank, r->peer == NG_TRACE_ALL ? -1 : (int)r->peer, r->iter, r->size,
+           (unsigned long long)r->block, (unsigned long long)r->rtt,
+           r->block*usec, r->rtt*usec/2);
+  }
+
+  munmap(map, st.st_size);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int i, csv = 0, ret = 0, first = 1;
+
+  for(i=1; i<argc && argv[i][0] == '-'; i++) {
+    if(strcmp(argv[i], "-c") == 0) csv = 1;
+    else break;
+  }
+  if(i >= argc) {
+    fprintf(stderr, "usage: %s [-c] tracefile...\n"
+                    "  converts netgauge -T traces to text (or CSV with -c)\n", argv[0]);
+    return 1;
+  }
+  for(; i<argc; i++) {
+    ret |= convert(argv[i], csv, first);
+    first = 0;
+  }
+  return ret;
+}
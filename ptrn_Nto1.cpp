@@ -10,16 +10,42 @@
 #include "netgauge.h"
 #if defined NG_PTRN_NTO1
 #include "hrtimer/hrtimer.h"
-#include <vector>
 #include "statistics.h"
 #include <string.h>
 #include <algorithm>
-#include "ng_tools.hpp"
+#include "ng_stats.h"
+#include "ng_hist.h"
+#include "ng_trace.h"
+#include "ng_schedule.h"
+#include "ng_converge.h"
+#include "ng_warmup.h"
+#include "ng_result.h"
 
 /* internal function prototypes & extern stuff */
 static void Nto1_do_benchmarks(struct ng_module *module);
 extern struct ng_options g_options;
 
+/** output file columns (the layout of one_one) */
+static const struct ng_result_col fNto1_cols[] = {
+  {"size", NG_RES_INT, "%lld -"},
+  {"block_min", NG_RES_DOUBLE, NULL},
+  {"block_avg", NG_RES_DOUBLE, NULL},
+  {"block_med", NG_RES_DOUBLE, NULL},
+  {"block_max", NG_RES_DOUBLE, NULL},
+  {"block_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"block_outliers", NG_RES_INT, "%lld) -"},
+  {"rtt2_min", NG_RES_DOUBLE, NULL},
+  {"rtt2_avg", NG_RES_DOUBLE, NULL},
+  {"rtt2_med", NG_RES_DOUBLE, NULL},
+  {"rtt2_max", NG_RES_DOUBLE, NULL},
+  {"rtt2_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"rtt2_outliers", NG_RES_INT, "%lld) -"},
+  {"bw_min", NG_RES_DOUBLE, NULL},
+  {"bw_avg", NG_RES_DOUBLE, NULL},
+  {"bw_med", NG_RES_DOUBLE, NULL},
+  {"bw_max", NG_RES_DOUBLE, NULL}
+};
+
 /**
  * one-to-many communication pattern registration
  * structure
@@ -76,6 +102,28 @@ void Nto1_do_benchmarks(struct ng_module *module) {
     reqs = (NG_Request*)malloc(sizeof(NG_Request) * (g_options.mpi_opts->worldsize-1) );
   }
 
+  /* rank 0 writes the results and the per-round histograms */
+  struct ng_result *res = NULL;
+  struct ng_hist *hrtt = NULL;
+  /* stop each size once the latency interval is narrow enough */
+  int converge = ng_converge_enabled(&g_options);
+  struct ng_converge conv;
+  /* the warmup of each size runs until the RTT is steady */
+  struct ng_warmup warm;
+  /* rank 1 takes the time and traces the samples */
+  struct ng_trace *trace = NULL;
+  if(rank == 1) trace = ng_trace_open("Nto1");
+  if(rank == 0) {
+    ng_info(NG_VNORM, "writing data to %s", g_options.output_file);
+    res = ng_result_open(open_output_file(g_options.output_file), "Nto1", fNto1_cols,
+                         sizeof(fNto1_cols)/sizeof(fNto1_cols[0]));
+    hrtt = (struct ng_hist*)malloc(sizeof(struct ng_hist));
+    if (hrtt == NULL) {
+      ng_error("Could not allocate memory for the histogram");
+      ng_exit(10);
+    }
+  }
+
   /* buffer for header ... */
   char* txtbuf = (char *)malloc(2048 * sizeof(char));
   if (txtbuf == NULL) {
@@ -86,36 +134,37 @@ void Nto1_do_benchmarks(struct ng_module *module) {
 
   /* header printing */
   if(rank == 0) {
-    // if very verbose - long output
-    if (NG_VLEV2 & g_options.verbose) {
-      snprintf(txtbuf, 2047,
+    snprintf(txtbuf, 2047,
 	      "## Netgauge v%s - mode %s - 2 processes\n"
 	      "##\n"
-        "## A...packet size [byte]\n"
-        "##\n"
-        "## B...minimum send blocking time\n"
-        "## C...average send blocking time\n"
-        "## D...median send blocking time\n"
-        "## E...maximum send blocking time\n"
-        "## F...standard deviation for send blocking time\n"
-        "## G...number of send blocking time values, that were bigger than 2*avg.\n"
-        "##\n"
-        "## H...minimum RTT/2\n"
-        "## I...average RTT/2\n"
-        "## J...median RTT/2\n"
-        "## K...maximum RTT/2\n"
-        "## L...standard deviation for RTT/2\n"
-        "## M...number of RTT/2 values, that were bigger than 2*avg.\n"
-        "##\n"
-        "## N...minimum throughput [Mbit/sec]\n"
-        "## O...average throughput [Mbit/sec]\n"
-        "## P...median throughput [Mbit/sec]\n"
-        "## Q...maximum throughput [Mbit/sec]\n"
-        "##\n"
-        "## A  -  B  C  S  D  (E F) - G  H  T  I  (J K)  -  L  M  U  N\n",
-        NG_VERSION,
-        g_options.mode);
+      "## A...packet size [byte]\n"
+      "##\n"
+      "## B...minimum send blocking time\n"
+      "## C...average send blocking time\n"
+      "## D...median send blocking time\n"
+      "## E...maximum send blocking time\n"
+      "## F...standard deviation for send blocking time\n"
+      "## G...number of send blocking time values, that were bigger than 2*avg.\n"
+      "##\n"
+      "## H...minimum RTT/2\n"
+      "## I...average RTT/2\n"
+      "## J...median RTT/2\n"
+      "## K...maximum RTT/2\n"
+      "## L...standard deviation for RTT/2\n"
+      "## M...number of RTT/2 values, that were bigger than 2*avg.\n"
+      "##\n"
+      "## N...minimum throughput [Mbit/sec]\n"
+      "## O...average throughput [Mbit/sec]\n"
+      "## P...median throughput [Mbit/sec]\n"
+      "## Q...maximum throughput [Mbit/sec]\n"
+      "##\n"
+      "## A  -  B  C  S  D  (E F) - G  H  T  I  (J K)  -  L  M  U  N\n",
+      NG_VERSION,
+      g_options.mode);
+    ng_result_comment(res, txtbuf);
 
+    // if very verbose - long output
+    if (NG_VLEV2 & g_options.verbose) {
       printf("%s", txtbuf);
     } else
     // if verbose - short output
@@ -166,9 +215,15 @@ void Nto1_do_benchmarks(struct ng_module *module) {
     }
     
     // the benchmark results
-    std::vector<double> tblock, trtt;
+    struct ng_stats tblock, trtt;
+    ng_stats_init(&tblock);
+    ng_stats_init(&trtt);
+    if(rank == 0) ng_hist_init(hrtt);
+    if(converge) ng_converge_init(&conv);
+    ng_warmup_init(&warm);
     
-    for (long test=-1 /* 1 warmup */; (test < test_count) && !g_stop_tests; test++) {
+    for (long test=-1 /* warmup tests */; (test < test_count) && !g_stop_tests; test++) {
+      double wsample = 0;
       /* TODO: introduce internal dissemination barrier */
       MPI_Barrier(MPI_COMM_WORLD);
 
@@ -182,25 +237,20 @@ void Nto1_do_benchmarks(struct ng_module *module) {
           /* TODO: all receive in one buffer ... is this a problem? */
           module->irecvfrom(i, buffer, data_size, &reqs[i-1]);
         }
-        /* loop until all requests done */
-        while(1) {
-          int ctr;
-          ctr = 0;
-          for(i = 1; i<g_options.mpi_opts->worldsize; i++) {
-            ctr += module->test(&reqs[i-1]);
-          }
-          /* all returned 0 :) */
-          if(ctr == 0) break;
-        }
+        /* wait until all requests are done */
+        ng_waitall(module, g_options.mpi_opts->worldsize-1, reqs);
         /* send ack to rank 1 */
         module->sendto(1, buffer, 1);
 
         /* receive measurement data from rank 1 */
         MPI_Recv(&results, 2, MPI_DOUBLE, 1, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        wsample = results[1];
         /* calculate results */
         if(test >= 0) {
-          trtt.push_back(results[1]/2);
-          tblock.push_back(results[0]);
+          ng_stats_add(&trtt, results[1]/2);
+          ng_stats_add(&tblock, results[0]);
+          /* rank 1 sends usecs */
+          ng_hist_record(hrtt, (unsigned long long)(results[1]/2*1e-6*g_timerfreq));
         }
           
       } else {
@@ -226,6 +276,7 @@ void Nto1_do_benchmarks(struct ng_module *module) {
 
           HRT_GET_ELAPSED_TICKS(t[0],t[1],&tibl);
           HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
+          if(test >= 0) ng_trace_record(trace, tibl, tirtt, data_size, test, 0);
 
           /* send results to rank 0 */
           results[0] = HRT_GET_USEC(tibl);
@@ -233,6 +284,10 @@ void Nto1_do_benchmarks(struct ng_module *module) {
           MPI_Send(&results, 2, MPI_DOUBLE, 0, 1, MPI_COMM_WORLD);
         }
       }
+
+      /* stay at test -1 until the warmup is over */
+      if(test < 0 && !ng_warmup_done(&warm, wsample, rank == 0)) test--;
+      if(converge && ng_converge_done(&conv, test, rank == 0 ? &trtt : NULL)) break;
     }
 
     /* add linebreak if we made dots ... */
@@ -242,24 +297,40 @@ void Nto1_do_benchmarks(struct ng_module *module) {
 
     if(rank==0) {
       /* output statistics - blocking time */
-      double tblock_avg = std::accumulate(tblock.begin(), tblock.end(), (double)0)/(double)tblock.size(); 
-      double tblock_min = *std::min_element(tblock.begin(), tblock.end()); 
-      double tblock_max = *std::max_element(tblock.begin(), tblock.end()); 
-      std::vector<double>::iterator nthblock = tblock.begin()+tblock.size()/2;
-      std::nth_element(tblock.begin(), nthblock, tblock.end());
-      double tblock_med = *nthblock;
-      double tblock_var = standard_deviation(tblock.begin(), tblock.end(), tblock_avg);
-      int tblock_fail = count_range(tblock.begin(), tblock.end(), tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
+      double tblock_avg = ng_stats_mean(&tblock);
+      double tblock_min = tblock.min;
+      double tblock_max = tblock.max;
+      double tblock_med = ng_stats_quantile(&tblock, 0.5);
+      double tblock_var = ng_stats_stddev(&tblock);
+      int tblock_fail = ng_stats_count_outside(&tblock, tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
 
       /* output statistics - rtt time */
-      double trtt_avg = std::accumulate(trtt.begin(), trtt.end(), (double)0)/(double)trtt.size(); 
-      double trtt_min = *std::min_element(trtt.begin(), trtt.end()); 
-      double trtt_max = *std::max_element(trtt.begin(), trtt.end()); 
-      std::vector<double>::iterator nthrtt = trtt.begin()+trtt.size()/2;
-      std::nth_element(trtt.begin(), nthrtt, trtt.end());
-      double trtt_med = *nthrtt;
-      double trtt_var = standard_deviation(trtt.begin(), trtt.end(), trtt_avg);
-      int trtt_fail = count_range(trtt.begin(), trtt.end(), trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
+      double trtt_avg = ng_stats_mean(&trtt);
+      double trtt_min = trtt.min;
+      double trtt_max = trtt.max;
+      double trtt_med = ng_stats_quantile(&trtt, 0.5);
+      double trtt_var = ng_stats_stddev(&trtt);
+      int trtt_fail = ng_stats_count_outside(&trtt, trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
+      ng_schedule_report(data_size, trtt_med);
+
+      ng_result_int(res, data_size);
+      ng_result_double(res, tblock_min);
+      ng_result_double(res, tblock_avg);
+      ng_result_double(res, tblock_med);
+      ng_result_double(res, tblock_max);
+      ng_result_double(res, tblock_var);
+      ng_result_int(res, tblock_fail);
+      ng_result_double(res, trtt_min);
+      ng_result_double(res, trtt_avg);
+      ng_result_double(res, trtt_med);
+      ng_result_double(res, trtt_max);
+      ng_result_double(res, trtt_var);
+      ng_result_int(res, trtt_fail);
+      ng_result_double(res, data_size/trtt_max*8);
+      ng_result_double(res, data_size/trtt_avg*8);
+      ng_result_double(res, data_size/trtt_med*8);
+      ng_result_double(res, data_size/trtt_min*8);
+      ng_result_end(res);
 
       // if very verbose - long output
       if (NG_VLEV2 & g_options.verbose) {
@@ -320,13 +391,24 @@ void Nto1_do_benchmarks(struct ng_module *module) {
           );
         printf("%s", txtbuf);
       }
+      ng_hist_write(ng_result_textfile(res), "rtt/2", data_size, hrtt);
+      ng_warmup_write(ng_result_textfile(res), data_size, &warm);
+      if(NG_VLEV1 & g_options.verbose) ng_warmup_write(stdout, data_size, &warm);
+      if(converge) {
+        ng_converge_write(ng_result_textfile(res), data_size, &conv);
+        if(NG_VLEV1 & g_options.verbose) ng_converge_write(stdout, data_size, &conv);
+      }
+      ng_result_flush(res);
     }
     
   } /* outer test loop */
 
  shutdown:
   /* clean up */
-  if (buffer) free(buffer);
+  if (buffer) NG_FREE(module, buffer);
+  ng_result_close(res);
+  ng_trace_close(trace);
+  free(hrtt);
 #endif
 }
 
@@ -13,6 +13,7 @@
 #include "MersenneTwister.h"
 //#include "ptrn_cpu_cmdline.h"
 #include "ng_tools.hpp"
+#include "ng_warmup.h"
 #include <vector>
 #include <time.h>
 #include <algorithm>
@@ -75,12 +76,16 @@ static void cpu_do_benchmarks(struct ng_module *module) {
 
   std::vector<double> alltimes, unrtimes, vectimes;
 
+  /* warm up until the first kernel's time is steady (CPU clock ramp) */
+  struct ng_warmup warm;
+  ng_warmup_init(&warm);
+
   /* Inner test loop
    * - run the requested number of tests for the current data size
    * - but only if testtime does not exceed the max. allowed test time
    *   (only if max. test time is not zero)
    */
-  for (int test = -1 /* 1 warmup test */; test < test_count; test++) {
+  for (int test = -1 /* warmup tests */; test < test_count; test++) {
     HRT_TIMESTAMP_T t[2];
     MTRand mt;
     unsigned long long ticks;
@@ -112,6 +117,7 @@ static void cpu_do_benchmarks(struct ng_module *module) {
 #endif
 
     if(test >=0) alltimes.push_back(HRT_GET_USEC(ticks));
+    double wsample = HRT_GET_USEC(ticks);
 
 #ifdef NG_HPM
         if(test > -1 ) hpmStart(90,"unroll8");
@@ -228,6 +234,8 @@ static void cpu_do_benchmarks(struct ng_module *module) {
 
     NG_CPU_res=x;
 
+    /* stay at test -1 until the warmup is over */
+    if(test < 0 && !ng_warmup_done(&warm, wsample, 1)) test--;
   }	/* end inner test loop */
   //ng_info(NG_VLEV1, "\n");
   //fflush(stdout);
@@ -262,6 +270,7 @@ static void cpu_do_benchmarks(struct ng_module *module) {
       tamax, (double)TESTS/tamax, tumax, (double)TESTS/tumax, tvmax, (double)TESTS/tvmax, 
       tamed, (double)TESTS/tamed, tumed, (double)TESTS/tumed, tvmed, (double)TESTS/tvmed, 
       tavar, tuvar, tvvar);
+  ng_warmup_write(stdout, 0, &warm);
     
 }
 
@@ -16,16 +16,15 @@
 #include "MersenneTwister.h"
 #include "hrtimer/hrtimer.h"
 #include "ptrn_disk_cmdline.h"
-#include "ng_tools.hpp"
+#include "ng_stats.h"
+#include "ng_hist.h"
 #include <errno.h>
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <linux/fs.h> // nasty linux header needes for ioctl to get device size ...
 
-#include <vector>
 #include <time.h>
-#include <algorithm>
-#include <numeric>
+#include <vector>
 
 
 extern "C" {
@@ -60,8 +59,11 @@ static void disk_do_benchmarks(struct ng_module *module) {
   int size = g_options.mpi_opts->worldsize;
   if(size > 1) ng_abort("this pattern only supports a single rank!\n");
 
-  std::vector<double> ts;
-  std::vector<unsigned long> bnum;
+  struct ng_stats ts;
+  ng_stats_init(&ts);
+  struct ng_hist *hts = (struct ng_hist*)malloc(sizeof(struct ng_hist));
+  if(!hts) ng_abort("could not allocate histogram\n");
+  ng_hist_init(hts);
 
   /** number of times to test the current datasize */
   long test_count = g_options.testcount;
@@ -134,6 +136,13 @@ static void disk_do_benchmarks(struct ng_module *module) {
 
   MTRand rand;
 
+  /* the samples are written after the loop - no file I/O between the
+   * timed calls */
+  std::vector<double> lats;
+  std::vector<unsigned long> blocks;
+  lats.reserve(test_count);
+  blocks.reserve(test_count);
+
   /* Inner test loop */
   for (int test = 1; test < test_count; test++) {
 	
@@ -144,7 +153,6 @@ static void disk_do_benchmarks(struct ng_module *module) {
 	  }
 
     unsigned long randblock = (unsigned long)floor(rand.randDblExc(totblks));
-    bnum.push_back(randblock);
 
     /* do the client stuff ... take time, send message, wait for
      * reply and take time  ... simple ping-pong scheme */
@@ -180,32 +188,36 @@ static void disk_do_benchmarks(struct ng_module *module) {
     HRT_GET_TIMESTAMP(t[2]);
 
     HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
-    if(test >= 0) ts.push_back(HRT_GET_USEC(tirtt));
+    if(test >= 0) {
+      ng_stats_add(&ts, HRT_GET_USEC(tirtt));
+      ng_hist_record(hts, tirtt);
+      lats.push_back(HRT_GET_USEC(tirtt));
+      blocks.push_back(randblock);
+    }
 
   }	/* end inner test loop */
 
 	if(NG_VLEV1 & g_options.verbose) printf("\n");
+
+  fprintf(outputfd, "# \n# sample latency [us] blockno\n");
+  for (size_t i = 0; i < lats.size(); i++)
+    fprintf(outputfd, "%i %f %lu\n", (int)i, lats[i], blocks[i]);
     
   /* compute statistics - read time */
-  double ts_avg = std::accumulate(ts.begin(), ts.end(), (double)0)/(double)ts.size(); 
-  double ts_min = *min_element(ts.begin(), ts.end()); 
-  double ts_max = *max_element(ts.begin(), ts.end()); 
-  std::vector<double>::iterator nthr = ts.begin()+ts.size()/2;
-  std::nth_element(ts.begin(), nthr, ts.end());
-  double ts_med = *nthr;
-  double ts_var = standard_deviation(ts.begin(), ts.end(), ts_avg);
-  int ts_fail = count_range(ts.begin(), ts.end(), ts_avg-ts_var*2, ts_avg+ts_var*2);
-
+  double ts_avg = ng_stats_mean(&ts);
+  double ts_min = ts.min;
+  double ts_max = ts.max;
+  double ts_med = ng_stats_quantile(&ts, 0.5);
+  double ts_var = ng_stats_stddev(&ts);
+  int ts_fail = ng_stats_count_outside(&ts, ts_avg-ts_var*2, ts_avg+ts_var*2);
 
-  fprintf(outputfd, "# \n# sample latency [us] blockno\n");
-  for(int i=0; i<ts.size(); ++i) {
-    fprintf(outputfd, "%i %f %lu\n", i, ts[i], bnum[i]);
-  }
 
   printf("bs: %i kiB min: %.2f ms avg: %.2f med: %.2f max: %.2f std-var: %.2f outliers: %i\n", bs/1024, ts_min/1000, ts_avg/1000, ts_med/1000, ts_max/1000, ts_var/1000, ts_fail);
   fprintf(outputfd, "# bs: %i kiB min: %.2f ms avg: %.2f med: %.2f max: %.2f std-var: %.2f outliers: %i\n", bs/1024, ts_min/1000, ts_avg/1000, ts_med/1000, ts_max/1000, ts_var/1000, ts_fail);
+  ng_hist_write(outputfd, args_info.write_given ? "write" : "read", bs, hts);
   
   fclose(outputfd);
+  free(hts);
 
 // shutdown:
     
@@ -11,6 +11,7 @@
 #if defined NG_PTRN_DISTRTT
 #include "statistics.h"
 #include "hrtimer/hrtimer.h"
+#include "ng_hist.h"
 #include <string.h>
 
 #define NUM_TESTS 500
@@ -56,6 +57,7 @@ void fdistrtt_do_benchmarks(struct ng_module *module) {
 	u_int64_t roundtrips[NUM_TESTS]; /* roundtrip time, minim. newtwork jitter */
 	u_int64_t clockdiffs[NUM_TESTS]; /* clock "difference", see expl. below */
 	double localtimes[NUM_TESTS]; /* time of measurement, relative to start */
+	struct ng_hist hrtt;
 
 	MPI_Comm_size(MPI_COMM_WORLD, &nprocs);
 	MPI_Comm_rank(MPI_COMM_WORLD, &myproc);
@@ -68,6 +70,8 @@ void fdistrtt_do_benchmarks(struct ng_module *module) {
 	
 	other_proc = (myproc + 1) % 2;
 
+	ng_hist_init(&hrtt);
+
 	MPI_Barrier(MPI_COMM_WORLD);
 	timestart = MPI_Wtime();
 
@@ -84,6 +88,7 @@ void fdistrtt_do_benchmarks(struct ng_module *module) {
 			HRT_GET_TIMESTAMP(t3);
 			localtimes[i] = MPI_Wtime() - timestart;
 			HRT_GET_ELAPSED_TICKS(t1, t3, &roundtrips[i]);
+			ng_hist_record(&hrtt, roundtrips[i]);
 			//if (t1 > t2) {clockdiffs[i] = t1 - t2;}
 			//else {clockdiffs[i] = t2 - t1;}
 			HRT_GET_ELAPSED_TICKS(t1, t2, &clockdiffs[i]);
@@ -106,6 +111,8 @@ void fdistrtt_do_benchmarks(struct ng_module *module) {
 		}
 	}
 
+	/* latency distribution of the roundtrips */
+	if (myproc == 0) ng_hist_write(stdout, "rtt", sizeof(HRT_TIMESTAMP_T), &hrtt);
 #endif
 }
 
@@ -23,6 +23,7 @@ typedef std::vector<pair_t> ptrn_t;
 
 extern "C" {
 #include "ng_sync.h"
+#include "ng_schedule.h"
 
 extern struct ng_options g_options;
 
@@ -178,6 +179,9 @@ static void ebb_do_benchmarks(struct ng_module *module) {
 
     }
 
+    /* the average over all ranks and rounds steers the size schedule */
+    if(r == 0) ng_schedule_report(data_size, std::accumulate(times.begin(), times.end(), 0.0)/times.size());
+
     if((r == 0) && (num_buckets)) {
       ng_info(NG_VNORM, "---- bucket data ----");
 
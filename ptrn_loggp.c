@@ -671,7 +671,7 @@ void loggp_do_benchmarks(struct ng_module *module) {
   }
 
   shutdown:
-   free(buffer);
+   NG_FREE(module, buffer);
    results_1_0.destructor(&results_1_0);
    results_n_0.destructor(&results_n_0);
    results_n_d.destructor(&results_n_d);
@@ -0,0 +1,379 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#include "netgauge.h"
+#if defined NG_PTRN_LOSS && defined NG_MPI
+#include "hrtimer/hrtimer.h"
+#include "ng_result.h"
+#include "ptrn_loss_cmdline.h"
+#include <stdint.h>
+
+/*
+ * Open-loop loss measurement: rank 0 sends count datagrams at a fixed
+ * rate (busy-waiting on the timer between datagrams, no feedback from
+ * the receiver), rank 1 records loss, reordering and interarrival
+ * jitter (RFC 3550). The rate doubles until the loss exceeds --loss
+ * and is then bisected to find the highest sustainable rate.
+ */
+
+/** the start of every datagram */
+struct loss_hdr {
+  uint32_t seq;
+  /** rate step - datagrams of earlier steps are late */
+  uint32_t step;
+  /** send time in ticks */
+  uint64_t tsend;
+};
+
+/** marks the datagrams that release the last posted receive */
+#define LOSS_STEP_STOP 0xffffffff
+/** idle time after the last datagram before the rest counts as lost */
+#define LOSS_GRACE_USEC 5000
+/** bisection steps after the knee was bracketed */
+#define LOSS_MAX_BISECT 8
+
+/* receiver statistics of one rate step (sent to rank 0 as doubles) */
+#define LOSS_RCVD      0
+#define LOSS_DUPS      1
+#define LOSS_LATE      2
+#define LOSS_REORDERED 3
+#define LOSS_DEPTH     4
+#define LOSS_JITTER    5
+#define LOSS_RECV_USEC 6
+#define LOSS_NSTATS    7
+
+static struct ptrn_loss_cmd_struct args_info;
+
+extern struct ng_options g_options;
+
+/* internal function prototypes */
+static void loss_do_benchmarks(struct ng_module *module);
+
+/** output file columns */
+static const struct ng_result_col loss_cols[] = {
+  {"rate", NG_RES_DOUBLE, "%.1lf"},
+  {"send_rate", NG_RES_DOUBLE, "%.1lf"},
+  {"recv_rate", NG_RES_DOUBLE, "%.1lf"},
+  {"sent", NG_RES_INT, NULL},
+  {"lost", NG_RES_INT, NULL},
+  {"loss_ppm", NG_RES_DOUBLE, "%.0lf"},
+  {"reordered", NG_RES_INT, NULL},
+  {"reorder_depth", NG_RES_INT, NULL},
+  {"jitter_us", NG_RES_DOUBLE, "%.3lf"},
+  {"dups", NG_RES_INT, NULL},
+  {"late", NG_RES_INT, NULL}
+};
+
+/**
+ * comm. pattern description and function pointer table
+ */
+static struct ng_comm_pattern pattern_loss = {
+   .name = "loss",
+   .desc = "measures loss, reordering and jitter of a paced datagram stream and the highest rate without loss",
+   .flags = NG_PTRN_NB,
+   .do_benchmarks = loss_do_benchmarks
+};
+
+/**
+ * register this comm. pattern for usage in main
+ * program
+ */
+int register_pattern_loss() {
+  ng_register_pattern(&pattern_loss);
+  return 0;
+}
+
+static inline unsigned long long loss_now(void) {
+  HRT_TIMESTAMP_T ts;
+  unsigned long long time;
+
+  HRT_GET_TIMESTAMP(ts);
+  HRT_GET_TIME(ts, time);
+  return time;
+}
+
+/**
+ * Sends count datagrams, one every interval ticks. The deadlines are
+ * computed from the start time so that late datagrams do not shift
+ * the schedule. Returns the time the sender needed in usec.
+ */
+static double loss_send(struct ng_module *module, char *buffer, int size,
+                        int count, double interval, uint32_t step) {
+  struct loss_hdr *hdr = (struct loss_hdr*)buffer;
+  HRT_TIMESTAMP_T t0, t1;
+  unsigned long long start, target, now, ticks;
+  int i;
+
+  HRT_GET_TIMESTAMP(t0);
+  HRT_GET_TIME(t0, start);
+  for (i = 0; i < count && !g_stop_tests; i++) {
+    target = start + (unsigned long long)(i * interval);
+    do {
+      now = loss_now();
+    } while (now < target);
+
+    hdr->seq = i;
+    hdr->step = step;
+    hdr->tsend = now;
+    if (module->sendto(1, buffer, size) != size) {
+      ng_error("sending datagram %i failed", i);
+      break;
+    }
+  }
+  HRT_GET_TIMESTAMP(t1);
+  HRT_GET_ELAPSED_TICKS(t0, t1, &ticks);
+  return HRT_GET_USEC(ticks);
+}
+
+/**
+ * Receives the datagrams of one step until all arrived or the sender
+ * finished and nothing arrived for LOSS_GRACE_USEC. *req is the
+ * posted receive - it stays posted for the next step.
+ */
+static int loss_recv(struct ng_module *module, char *buffer, int size, int count,
+                     uint32_t step, NG_Request *req, double *stats) {
+  struct loss_hdr *hdr = (struct loss_hdr*)buffer;
+  HRT_TIMESTAMP_T tnow, tfirst;
+  unsigned long long now, last = 0, prev_r = 0, prev_s = 0, ticks;
+  unsigned long long grace = (unsigned long long)(LOSS_GRACE_USEC * 1e-6 * g_timerfreq);
+  unsigned char *seen;
+  uint32_t max_seq = 0;
+  long long d;
+  double jitter = 0, send_usec;
+  MPI_Request done_req;
+  int ret, done = 0;
+
+  memset(stats, 0, LOSS_NSTATS * sizeof(double));
+  seen = (unsigned char*)calloc(count / 8 + 1, 1);
+  if (seen == NULL) {
+    ng_error("Could not allocate the sequence bitmap for %i datagrams", count);
+    return 1;
+  }
+  MPI_Irecv(&send_usec, 1, MPI_DOUBLE, 0, 1, MPI_COMM_WORLD, &done_req);
+  HRT_GET_TIMESTAMP(tfirst); /* set again by the first datagram */
+
+  while (!g_stop_tests) {
+    ret = module->test(req);
+    if (ret < 0) {
+      ng_error("receiving datagrams failed");
+      break;
+    }
+    HRT_GET_TIMESTAMP(tnow);
+    HRT_GET_TIME(tnow, now);
+
+    if (ret > 0) {
+      /* nothing arrived - did the sender finish and are we idle? */
+      if (!done) {
+        MPI_Test(&done_req, &done, MPI_STATUS_IGNORE);
+        if (done) last = now;
+      } else if (now - last > grace) {
+        break;
+      }
+      continue;
+    }
+
+    /* a datagram - classify it and post the next receive */
+    last = now;
+    if (hdr->step != step || hdr->seq >= (uint32_t)count) {
+      stats[LOSS_LATE]++;
+    } else if (seen[hdr->seq / 8] & (1 << (hdr->seq % 8))) {
+      stats[LOSS_DUPS]++;
+    } else {
+      seen[hdr->seq / 8] |= 1 << (hdr->seq % 8);
+      if (stats[LOSS_RCVD] == 0) {
+        tfirst = tnow;
+      } else {
+        /* RFC 3550 interarrival jitter (the timer overhead cancels out) */
+        d = (long long)(now - prev_r) - (long long)(hdr->tsend - prev_s);
+        if (d < 0) d = -d;
+        jitter += (HRT_GET_USEC(d) - jitter) / 16;
+      }
+      if (hdr->seq < max_seq) {
+        stats[LOSS_REORDERED]++;
+        if (max_seq - hdr->seq > stats[LOSS_DEPTH]) stats[LOSS_DEPTH] = max_seq - hdr->seq;
+      } else {
+        max_seq = hdr->seq;
+      }
+      prev_r = now;
+      prev_s = hdr->tsend;
+      stats[LOSS_RCVD]++;
+      HRT_GET_ELAPSED_TICKS(tfirst, tnow, &ticks);
+      stats[LOSS_RECV_USEC] = HRT_GET_USEC(ticks);
+    }
+    module->irecvfrom(0, buffer, size, req);
+    if (stats[LOSS_RCVD] == count && done) break;
+  }
+
+  if (!done) MPI_Wait(&done_req, MPI_STATUS_IGNORE);
+  stats[LOSS_JITTER] = jitter;
+  free(seen);
+  return 0;
+}
+
+/**
+ * Completes the receive that is still posted after the last step:
+ * rank 0 sends stop datagrams until rank 1 got one.
+ */
+static void loss_finish(struct ng_module *module, char *buffer, int size, NG_Request *req) {
+  struct loss_hdr *hdr = (struct loss_hdr*)buffer;
+  MPI_Request ack_req;
+  unsigned long long next;
+  int ack = 0;
+
+  if (g_options.mpi_opts->worldrank == 0) {
+    MPI_Irecv(&ack, 1, MPI_INT, 1, 2, MPI_COMM_WORLD, &ack_req);
+    do {
+      hdr->seq = 0;
+      hdr->step = LOSS_STEP_STOP;
+      hdr->tsend = 0;
+      module->sendto(1, buffer, size);
+      next = loss_now() + g_timerfreq / 1000;
+      while (loss_now() < next && !ack) MPI_Test(&ack_req, &ack, MPI_STATUS_IGNORE);
+    } while (!ack && !g_stop_tests);
+  } else {
+    while (module->test(req) > 0 && !g_stop_tests);
+    MPI_Send(&ack, 1, MPI_INT, 0, 2, MPI_COMM_WORLD);
+  }
+}
+
+static void loss_do_benchmarks(struct ng_module *module) {
+  int rank = g_options.mpi_opts->worldrank;
+  struct ng_result *res = NULL;
+  double stats[LOSS_NSTATS], rate, next, good = 0, bad = 0;
+  double send_usec, send_rate, recv_rate, loss_ppm;
+  char *buffer, txtbuf[512];
+  NG_Request req = NULL;
+  int size, count, bisect = 0, limited = 0;
+  long long lost;
+  uint32_t step;
+
+  /* parse cmdline arguments */
+  if (ptrn_loss_parser_string(g_options.ptrnopts, &args_info, "netgauge") != 0) {
+    ng_abort("commandline parser error");
+  }
+  if (g_options.mpi_opts->worldsize != 2) {
+    ng_abort("this pattern needs exactly two ranks");
+  }
+  size = args_info.size_arg;
+  count = args_info.count_arg;
+  if (size < (int)sizeof(struct loss_hdr) ||
+      (module->max_datasize > 0 && size > module->max_datasize)) {
+    ng_error("datagram size must be between %i and %i bytes", (int)sizeof(struct loss_hdr),
+             module->max_datasize);
+    return;
+  }
+  if (count < 1 || args_info.rate_arg < 1 || args_info.maxrate_arg < args_info.rate_arg) {
+    ng_error("count and rate must be positive, maxrate at least rate");
+    return;
+  }
+  if (module->flags & NG_MOD_RELIABLE) {
+    ng_info(NG_VLEV1, "module %s is reliable - expect no loss", module->name);
+  }
+
+  NG_MALLOC(module, char*, size + module->headerlen, buffer);
+  memset(buffer, 0, size);
+
+  if (rank == 0) {
+    ng_info(NG_VNORM, "writing data to %s", g_options.output_file);
+    res = ng_result_open(open_output_file(g_options.output_file), "loss", loss_cols,
+                         sizeof(loss_cols)/sizeof(loss_cols[0]));
+    snprintf(txtbuf, sizeof(txtbuf),
+        "## Netgauge v%s - mode %s - open-loop loss, %i datagrams of %i bytes per rate\n"
+        "## rate send_rate recv_rate [Mbit/s] sent lost loss[ppm] reordered reorder_depth jitter[us] dups late\n",
+        NG_VERSION, g_options.mode, count, size);
+    ng_result_comment(res, txtbuf);
+  } else {
+    /* one receive is always posted */
+    module->irecvfrom(0, buffer, size, &req);
+  }
+
+  rate = args_info.rate_arg;
+  for (step = 0; rate > 0 && !g_stop_tests; step++) {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    if (rank == 0) {
+      /* ticks between two datagrams */
+      double interval = (double)g_timerfreq * size * 8 / (rate * 1e6);
+
+      send_usec = loss_send(module, buffer, size, count, interval, step);
+      MPI_Send(&send_usec, 1, MPI_DOUBLE, 1, 1, MPI_COMM_WORLD);
+      MPI_Recv(stats, LOSS_NSTATS, MPI_DOUBLE, 1, 3, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+      lost = count - (long long)stats[LOSS_RCVD];
+      loss_ppm = 1e6 * lost / count;
+      send_rate = send_usec > 0 ? (double)count * size * 8 / send_usec : 0;
+      recv_rate = stats[LOSS_RECV_USEC] > 0 ? (stats[LOSS_RCVD] - 1) * size * 8 / stats[LOSS_RECV_USEC] : 0;
+
+      ng_result_double(res, rate);
+      ng_result_double(res, send_rate);
+      ng_result_double(res, recv_rate);
+      ng_result_int(res, count);
+      ng_result_int(res, lost);
+      ng_result_double(res, loss_ppm);
+      ng_result_int(res, (long long)stats[LOSS_REORDERED]);
+      ng_result_int(res, (long long)stats[LOSS_DEPTH]);
+      ng_result_double(res, stats[LOSS_JITTER]);
+      ng_result_int(res, (long long)stats[LOSS_DUPS]);
+      ng_result_int(res, (long long)stats[LOSS_LATE]);
+      ng_result_end(res);
+      ng_syscalls_write(ng_result_textfile(res), size, module);
+
+      printf("%.1f Mbit/s (sent %.1f) -> loss %.0f ppm, reordered %.0f (depth %.0f), jitter %.3f us\n",
+             rate, send_rate, loss_ppm, stats[LOSS_REORDERED], stats[LOSS_DEPTH], stats[LOSS_JITTER]);
+
+      /* next rate: double until the first loss, then bisect */
+      next = 0;
+      if (loss_ppm <= args_info.loss_arg) {
+        good = rate;
+        /* the sender cannot go faster - the knee is above its limit */
+        if (send_rate < 0.9 * rate) limited = 1;
+      } else {
+        bad = rate;
+      }
+      if (args_info.fixed_flag || limited) {
+        next = 0;
+      } else if (bad == 0) {
+        if (rate < args_info.maxrate_arg) next = ng_min(2 * rate, (double)args_info.maxrate_arg);
+      } else if (good == 0) {
+        if (rate / 2 >= 1) next = rate / 2;
+      } else if (bisect++ < LOSS_MAX_BISECT && bad - good > 0.02 * good) {
+        next = (good + bad) / 2;
+      }
+      rate = next;
+    } else {
+      loss_recv(module, buffer, size, count, step, &req, stats);
+      MPI_Send(stats, LOSS_NSTATS, MPI_DOUBLE, 0, 3, MPI_COMM_WORLD);
+    }
+    MPI_Bcast(&rate, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+  }
+
+  loss_finish(module, buffer, size, &req);
+
+  if (rank == 0) {
+    if (good > 0) {
+      snprintf(txtbuf, sizeof(txtbuf), "# highest rate with loss <= %i ppm: %.1f Mbit/s%s\n",
+               args_info.loss_arg, good, limited ? " (sender limited)" : "");
+    } else {
+      snprintf(txtbuf, sizeof(txtbuf), "# no rate with loss <= %i ppm\n", args_info.loss_arg);
+    }
+    printf("%s", txtbuf);
+    ng_result_comment(res, txtbuf);
+    ng_result_close(res);
+  }
+  NG_FREE(module, buffer);
+}
+
+#else
+
+/* dummy pattern registration */
+int register_pattern_loss() {
+  return 0;
+}
+
+#endif
@@ -12,8 +12,9 @@
 #include "hrtimer/hrtimer.h"
 #include "MersenneTwister.h"
 #include "ptrn_memory_cmdline.h"
-#include "ng_tools.hpp"
-#include <vector>
+#include "ng_stats.h"
+#include "ng_result.h"
+#include "ng_schedule.h"
 #include <time.h>
 #include <algorithm>
 #include <numeric>
@@ -97,6 +98,41 @@ extern struct ng_options g_options;
 /* internal function prototypes */
 static void memory_do_benchmarks(struct ng_module *module);
 
+/** output file columns (text: "A - B C D E (F G) - ... - ...") */
+static const struct ng_result_col memory_cols[] = {
+  {"size", NG_RES_INT, "%lld - "},
+  {"read_min", NG_RES_DOUBLE, NULL},
+  {"read_avg", NG_RES_DOUBLE, NULL},
+  {"read_med", NG_RES_DOUBLE, NULL},
+  {"read_max", NG_RES_DOUBLE, NULL},
+  {"read_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"read_outliers", NG_RES_INT, "%lld) - "},
+  {"write_min", NG_RES_DOUBLE, NULL},
+  {"write_avg", NG_RES_DOUBLE, NULL},
+  {"write_med", NG_RES_DOUBLE, NULL},
+  {"write_max", NG_RES_DOUBLE, NULL},
+  {"write_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"write_outliers", NG_RES_INT, "%lld) - "},
+  {"copy_min", NG_RES_DOUBLE, NULL},
+  {"copy_avg", NG_RES_DOUBLE, NULL},
+  {"copy_med", NG_RES_DOUBLE, NULL},
+  {"copy_max", NG_RES_DOUBLE, NULL},
+  {"copy_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"copy_outliers", NG_RES_INT, "%lld)"}
+};
+
+/** output file columns for pchase (text: "A1 A2 - B C D E (F G)") */
+static const struct ng_result_col memory_pchase_cols[] = {
+  {"hops", NG_RES_INT, NULL},
+  {"ptrsize", NG_RES_INT, "%lld - "},
+  {"min", NG_RES_DOUBLE, NULL},
+  {"avg", NG_RES_DOUBLE, NULL},
+  {"med", NG_RES_DOUBLE, NULL},
+  {"max", NG_RES_DOUBLE, NULL},
+  {"stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"outliers", NG_RES_INT, "%lld)"}
+};
+
 /**
  * comm. pattern description and function pointer table
  */
@@ -126,6 +162,19 @@ TYPE wipe_cache(TYPE *cachewiper, int cachewiper_size) {
   return ret;
 }
 
+/* doubles the element count unless the user asked for a size schedule,
+ * sizes that round to the same element count are skipped */
+static long memory_next_elems(long *data_size, long data_elems, struct ng_module *module) {
+  long test_count;
+
+  if(!ng_schedule_enabled(&g_options)) return data_elems*2;
+  do {
+    get_next_testparams(data_size, &test_count, &g_options, module);
+    if(*data_size < 0) return LONG_MAX;
+  } while(*data_size/(long)sizeof(TYPE) <= data_elems);
+  return *data_size/sizeof(TYPE);
+}
+
 static void memory_do_benchmarks(struct ng_module *module) {
 
   /** currently tested packet size and maximum */
@@ -197,8 +246,14 @@ static void memory_do_benchmarks(struct ng_module *module) {
     snprintf(suffix, 511, ".%i", g_options.mpi_opts->worldrank);
     strncat(fname, suffix, 1023);
   }
-	FILE* outputfd = open_output_file(fname);
-  write_host_information(outputfd);
+  struct ng_result *res;
+  if (strcmp(args_info.method_arg, "pchase") != 0) {
+    res = ng_result_open(open_output_file(fname), "memory", memory_cols,
+                         sizeof(memory_cols)/sizeof(memory_cols[0]));
+  } else {
+    res = ng_result_open(open_output_file(fname), "memory", memory_pchase_cols,
+                         sizeof(memory_pchase_cols)/sizeof(memory_pchase_cols[0]));
+  }
 
 
   /* header printing */
@@ -222,8 +277,8 @@ static void memory_do_benchmarks(struct ng_module *module) {
       g_options.mode, g_options.mpi_opts->worldsize);
 
     if(!rank || args_info.write_all_given) {
-      fprintf(outputfd, "%s", txtbuf);
-      fprintf(outputfd, "#\n"
+      ng_result_comment(res, txtbuf);
+      ng_result_comment(res, "#\n"
           "# gnuplot script (medians):\n"
           "#  set logscale x\n"
           "#  plot 'ng.out' using 1:($1/$5) title 'read'\n"
@@ -357,11 +412,16 @@ static void memory_do_benchmarks(struct ng_module *module) {
    * - geometrically increments data_elems (i.e. data_elems = data_elems * 2)
    *  (- geometrically decrements test_count) not yet implemented
    */
-  for (data_elems = ng_max(g_options.min_datasize/sizeof(TYPE), 1); data_elems <= max_data_elems; data_elems*=2) {
+  long data_size = g_options.min_datasize;
+  for (data_elems = ng_max(g_options.min_datasize/sizeof(TYPE), 1); data_elems <= max_data_elems;
+       data_elems = memory_next_elems(&data_size, data_elems, module)) {
     ++test_round;
 
     // the benchmark results
-    std::vector<double> tr, tw, tc; // read, write, copy
+    struct ng_stats tr, tw, tc; // read, write, copy
+    ng_stats_init(&tr);
+    ng_stats_init(&tw);
+    ng_stats_init(&tc);
     
     ng_info(NG_VLEV1, "Round %d: testing %d times with %d bytes:", test_round, test_count, data_elems);
     // if we print dots ...
@@ -389,7 +449,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
       }
       HRT_GET_TIMESTAMP(t[2]);
       HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
-      tr.push_back(HRT_GET_USEC(tirtt)/test_count);
+      ng_stats_add(&tr, HRT_GET_USEC(tirtt)/test_count);
       NG_Memory_res += k; // avoid optimization
 
       ////////////////////////////////////////////////////////////
@@ -409,7 +469,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
       }
       HRT_GET_TIMESTAMP(t[2]);
       HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
-      tw.push_back(HRT_GET_USEC(tirtt)/test_count);
+      ng_stats_add(&tw, HRT_GET_USEC(tirtt)/test_count);
       NG_Memory_res += k; // avoid optimization
 
       ////////////////////////////////////////////////////////////
@@ -434,7 +494,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
       }
       HRT_GET_TIMESTAMP(t[2]);
       HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
-      tc.push_back(HRT_GET_USEC(tirtt)/test_count);
+      ng_stats_add(&tc, HRT_GET_USEC(tirtt)/test_count);
   	} else // end batchstream
 
     /* Inner test loop
@@ -488,7 +548,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(10);
 #endif
     
-        if(test >= 0) tr.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tr, HRT_GET_USEC(tirtt));
         
         ////////////////////////////////////////////////////////////
         // write phase
@@ -519,7 +579,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(20);
 #endif
     
-        if(test >= 0) tw.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tw, HRT_GET_USEC(tirtt));
         
         ////////////////////////////////////////////////////////////
         // copy phase
@@ -549,7 +609,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(30);
 #endif
     
-        if(test >= 0) tc.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tc, HRT_GET_USEC(tirtt));
       } 
 
 	    if (strcmp(args_info.method_arg, "random") == 0) {
@@ -590,7 +650,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(40);
 #endif
     
-        if(test >= 0) tr.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tr, HRT_GET_USEC(tirtt));
       
         ////////////////////////////////////////////////////////////
         // random write phase
@@ -625,7 +685,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(50);
 #endif
 
-        if(test >= 0) tw.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tw, HRT_GET_USEC(tirtt));
 
         ////////////////////////////////////////////////////////////
         // random copy phase
@@ -654,7 +714,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
         if(test > -1 ) hpmStop(60);
 #endif
     
-        if(test >= 0) tc.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tc, HRT_GET_USEC(tirtt));
       }
 
 	    if (strcmp(args_info.method_arg, "pchase") == 0) {
@@ -683,54 +743,60 @@ static void memory_do_benchmarks(struct ng_module *module) {
 #ifdef NG_HPM
         if(test > -1 ) hpmStop(70);
 #endif
-        if(test >= 0) tr.push_back(HRT_GET_USEC(tirtt));
+        if(test >= 0) ng_stats_add(&tr, HRT_GET_USEC(tirtt));
       }
 
     }	/* end inner test loop */
     
 	  if (strcmp(args_info.method_arg, "pchase") != 0) {
       /* compute statistics - read time */
-      double tr_avg = std::accumulate(tr.begin(), tr.end(), (double)0)/(double)tr.size(); 
-      double tr_min = *min_element(tr.begin(), tr.end()); 
-      double tr_max = *max_element(tr.begin(), tr.end()); 
-      std::vector<double>::iterator nthr = tr.begin()+tr.size()/2;
-      std::nth_element(tr.begin(), nthr, tr.end());
-      double tr_med = *nthr;
-      double tr_var = standard_deviation(tr.begin(), tr.end(), tr_avg);
-      int tr_fail = count_range(tr.begin(), tr.end(), tr_avg-tr_var*2, tr_avg+tr_var*2);
+      double tr_avg = ng_stats_mean(&tr);
+      double tr_min = tr.min;
+      double tr_max = tr.max;
+      double tr_med = ng_stats_quantile(&tr, 0.5);
+      double tr_var = ng_stats_stddev(&tr);
+      int tr_fail = ng_stats_count_outside(&tr, tr_avg-tr_var*2, tr_avg+tr_var*2);
 
       /* compute statistics - write time */
-      double tw_avg = std::accumulate(tw.begin(), tw.end(), (double)0)/(double)tw.size(); 
-      double tw_min = *min_element(tw.begin(), tw.end()); 
-      double tw_max = *max_element(tw.begin(), tw.end()); 
-      std::vector<double>::iterator nthw = tw.begin()+tw.size()/2;
-      std::nth_element(tw.begin(), nthw, tw.end());
-      double tw_med = *nthw;
-      double tw_var = standard_deviation(tw.begin(), tw.end(), tw_avg);
-      int tw_fail = count_range(tw.begin(), tw.end(), tw_avg-tw_var*2, tw_avg+tw_var*2);
+      double tw_avg = ng_stats_mean(&tw);
+      double tw_min = tw.min;
+      double tw_max = tw.max;
+      double tw_med = ng_stats_quantile(&tw, 0.5);
+      double tw_var = ng_stats_stddev(&tw);
+      int tw_fail = ng_stats_count_outside(&tw, tw_avg-tw_var*2, tw_avg+tw_var*2);
 
       /* compute statistics - copy time */
-      double tc_avg = std::accumulate(tc.begin(), tc.end(), (double)0)/(double)tc.size(); 
-      double tc_min = *min_element(tc.begin(), tc.end()); 
-      double tc_max = *max_element(tc.begin(), tc.end()); 
-      std::vector<double>::iterator nthc = tc.begin()+tc.size()/2;
-      std::nth_element(tc.begin(), nthc, tc.end());
-      double tc_med = *nthc;
-      double tc_var = standard_deviation(tc.begin(), tc.end(), tc_avg);
-      int tc_fail = count_range(tc.begin(), tc.end(), tc_avg-tc_var*2, tc_avg+tc_var*2);
-
-
-      // if very verbose - long output
-        memset(txtbuf, '\0', 2048);
-        snprintf(txtbuf, 2047,
-          "%ld -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i) -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i) -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
-          data_elems*sizeof(TYPE), 
-          tr_min, tr_avg, tr_med, tr_max, 
-          tr_var, /* standard deviation */
-          tr_fail, /* how many are bigger than twice the standard deviation? */
-          tw_min, tw_avg, tw_med, tw_max, tw_var, tw_fail, 
-          tc_min, tc_avg, tc_med, tc_max, tc_var, tc_fail);
-      if(!rank || args_info.write_all_given) fprintf(outputfd, "%s", txtbuf);
+      double tc_avg = ng_stats_mean(&tc);
+      double tc_min = tc.min;
+      double tc_max = tc.max;
+      double tc_med = ng_stats_quantile(&tc, 0.5);
+      double tc_var = ng_stats_stddev(&tc);
+      int tc_fail = ng_stats_count_outside(&tc, tc_avg-tc_var*2, tc_avg+tc_var*2);
+      if(!rank) ng_schedule_report(data_size, tr_med);
+
+
+      if(!rank || args_info.write_all_given) {
+        ng_result_int(res, data_elems*sizeof(TYPE));
+        ng_result_double(res, tr_min);
+        ng_result_double(res, tr_avg);
+        ng_result_double(res, tr_med);
+        ng_result_double(res, tr_max);
+        ng_result_double(res, tr_var);
+        ng_result_int(res, tr_fail);
+        ng_result_double(res, tw_min);
+        ng_result_double(res, tw_avg);
+        ng_result_double(res, tw_med);
+        ng_result_double(res, tw_max);
+        ng_result_double(res, tw_var);
+        ng_result_int(res, tw_fail);
+        ng_result_double(res, tc_min);
+        ng_result_double(res, tc_avg);
+        ng_result_double(res, tc_med);
+        ng_result_double(res, tc_max);
+        ng_result_double(res, tc_var);
+        ng_result_int(res, tc_fail);
+        ng_result_end(res);
+      }
 
 
       if (rank==0) {
@@ -740,6 +806,15 @@ static void memory_do_benchmarks(struct ng_module *module) {
         }
 
         if (NG_VLEV2 & g_options.verbose) {
+          memset(txtbuf, '\0', 2048);
+          snprintf(txtbuf, 2047,
+            "%ld -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i) -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i) -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
+            data_elems*sizeof(TYPE), 
+            tr_min, tr_avg, tr_med, tr_max, 
+            tr_var, /* standard deviation */
+            tr_fail, /* how many are bigger than twice the standard deviation? */
+            tw_min, tw_avg, tw_med, tw_max, tw_var, tw_fail, 
+            tc_min, tc_avg, tc_med, tc_max, tc_var, tc_fail);
           printf("%s", txtbuf);
           
         } else
@@ -772,24 +847,24 @@ static void memory_do_benchmarks(struct ng_module *module) {
       }
     } else { // pchase
       /* compute statistics - time */
-      double tr_avg = std::accumulate(tr.begin(), tr.end(), (double)0)/(double)tr.size(); 
-      double tr_min = *min_element(tr.begin(), tr.end()); 
-      double tr_max = *max_element(tr.begin(), tr.end()); 
-      std::vector<double>::iterator nthr = tr.begin()+tr.size()/2;
-      std::nth_element(tr.begin(), nthr, tr.end());
-      double tr_med = *nthr;
-      double tr_var = standard_deviation(tr.begin(), tr.end(), tr_avg);
-      int tr_fail = count_range(tr.begin(), tr.end(), tr_avg-tr_var*2, tr_avg+tr_var*2);
-
-      // if very verbose - long output
-        memset(txtbuf, '\0', 2048);
-        snprintf(txtbuf, 2047,
-          "%ld %ld -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
-          data_elems, sizeof(char*),
-          tr_min, tr_avg, tr_med, tr_max, 
-          tr_var, /* standard deviation */
-          tr_fail /* how many are bigger than twice the standard deviation? */);
-      if(!rank || args_info.write_all_given) fprintf(outputfd, "%s", txtbuf);
+      double tr_avg = ng_stats_mean(&tr);
+      double tr_min = tr.min;
+      double tr_max = tr.max;
+      double tr_med = ng_stats_quantile(&tr, 0.5);
+      double tr_var = ng_stats_stddev(&tr);
+      int tr_fail = ng_stats_count_outside(&tr, tr_avg-tr_var*2, tr_avg+tr_var*2);
+
+      if(!rank || args_info.write_all_given) {
+        ng_result_int(res, data_elems);
+        ng_result_int(res, sizeof(char*));
+        ng_result_double(res, tr_min);
+        ng_result_double(res, tr_avg);
+        ng_result_double(res, tr_med);
+        ng_result_double(res, tr_max);
+        ng_result_double(res, tr_var);
+        ng_result_int(res, tr_fail);
+        ng_result_end(res);
+      }
 
 
       if (rank==0) {
@@ -799,6 +874,13 @@ static void memory_do_benchmarks(struct ng_module *module) {
         }
 
         if (NG_VLEV2 & g_options.verbose) {
+          memset(txtbuf, '\0', 2048);
+          snprintf(txtbuf, 2047,
+            "%ld %ld -  %.2lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
+            data_elems, sizeof(char*),
+            tr_min, tr_avg, tr_med, tr_max, 
+            tr_var, /* standard deviation */
+            tr_fail /* how many are bigger than twice the standard deviation? */);
           printf("%s", txtbuf);
           
         } else
@@ -832,7 +914,7 @@ static void memory_do_benchmarks(struct ng_module *module) {
 
   }	/* end outer test loop */
 
-  if(!rank || args_info.write_all_given) fclose(outputfd);
+  ng_result_close(res);
 
 
   if(args_info.wipe_given) for(int w=0; w<cachewiper_size; w++) {
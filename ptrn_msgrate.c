@@ -0,0 +1,229 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#include "netgauge.h"
+#if defined NG_PTRN_MSGRATE && defined NG_MPI
+#include "hrtimer/hrtimer.h"
+#include "ng_result.h"
+#include "ng_schedule.h"
+#include "ng_warmup.h"
+#include "ptrn_msgrate_cmdline.h"
+
+/*
+ * Windowed message rate (like osu_mbw_mr): sender i posts --window
+ * isendto()s to receiver i + pairs and waits for all of them, the
+ * receiver posts as many irecvfrom()s and returns a small ack when the
+ * window is complete. All pairs run at the same time, the aggregate
+ * rate is the number of messages of all pairs over the time of the
+ * slowest sender.
+ */
+
+/** size of the ack that closes a window */
+#define MSGRATE_ACK_SIZE 4
+
+static struct ptrn_msgrate_cmd_struct args_info;
+
+extern struct ng_options g_options;
+
+/* internal function prototypes */
+static void msgrate_do_benchmarks(struct ng_module *module);
+
+/** output file columns */
+static const struct ng_result_col msgrate_cols[] = {
+  {"size", NG_RES_INT, NULL},
+  {"pairs", NG_RES_INT, NULL},
+  {"window", NG_RES_INT, NULL},
+  {"msgs_per_s", NG_RES_DOUBLE, "%.0lf"},
+  {"mbit_per_s", NG_RES_DOUBLE, "%.2lf"},
+  {"pair_msgs_per_s", NG_RES_DOUBLE, "%.0lf"},
+  {"usec_per_msg", NG_RES_DOUBLE, "%.3lf"}
+};
+
+/**
+ * comm. pattern description and function pointer table
+ */
+static struct ng_comm_pattern pattern_msgrate = {
+   .name = "msgrate",
+   .desc = "measures the message rate of concurrent pairs with a window of outstanding non-blocking sends",
+   .flags = NG_PTRN_NB,
+   .do_benchmarks = msgrate_do_benchmarks
+};
+
+/**
+ * register this comm. pattern for usage in main
+ * program
+ */
+int register_pattern_msgrate() {
+  ng_register_pattern(&pattern_msgrate);
+  return 0;
+}
+
+/**
+ * Runs one window between the pair: window non-blocking transfers
+ * followed by the ack from the receiver. A failed transfer aborts,
+ * the other pairs would wait for this one forever.
+ */
+static void msgrate_window(struct ng_module *module, int sender, int peer, char *buffer,
+                           int size, char *ack, NG_Request *reqs, int window) {
+  int i, ret;
+
+  for (i = 0; i < window; i++) {
+    if (sender) ret = module->isendto(peer, buffer, size, &reqs[i]);
+    else ret = module->irecvfrom(peer, buffer, size, &reqs[i]);
+    if (ret < 0) ng_abort("posting a message of the window failed\n");
+  }
+  if (ng_waitall(module, window, reqs)) ng_abort("waiting for the window failed\n");
+
+  if (sender) ret = ng_recv_all(peer, ack, MSGRATE_ACK_SIZE, module);
+  else ret = ng_send_all(peer, ack, MSGRATE_ACK_SIZE, module);
+  if (ret) ng_abort("the ack of the window failed\n");
+}
+
+/** usecs since start, without the timer overhead */
+static inline double msgrate_usec_since(HRT_TIMESTAMP_T *start) {
+  HRT_TIMESTAMP_T now;
+  unsigned long long ticks;
+
+  HRT_GET_TIMESTAMP(now);
+  HRT_GET_ELAPSED_TICKS(*start, now, &ticks);
+  return HRT_GET_USEC(ticks);
+}
+
+static void msgrate_do_benchmarks(struct ng_module *module) {
+  int rank = g_options.mpi_opts->worldrank;
+  int p = g_options.mpi_opts->worldsize;
+  struct ng_result *res = NULL;
+  struct ng_warmup warm;
+  NG_Request *reqs;
+  char *buffer, *ack, txtbuf[1024];
+  long data_size, test_count = g_options.testcount, test;
+  long max_data_size = ng_min(g_options.max_datasize + module->headerlen, module->max_datasize);
+  int pairs, window, active, sender, peer = -1;
+  HRT_TIMESTAMP_T start, wstart;
+  double elapsed, wsample, times[2], all[2];
+
+  /* parse cmdline arguments */
+  if (ptrn_msgrate_parser_string(g_options.ptrnopts, &args_info, "netgauge") != 0) {
+    ng_abort("commandline parser error");
+  }
+  window = args_info.window_arg;
+  pairs = args_info.pairs_arg ? args_info.pairs_arg : p / 2;
+  if (window < 1) {
+    ng_error("the window must hold at least one message");
+    return;
+  }
+  if (pairs < 1 || 2 * pairs > p) {
+    ng_error("%i pairs need at least %i ranks (have %i)", pairs, 2 * ng_max(pairs, 1), p);
+    return;
+  }
+  if (!(module->flags & NG_MOD_RELIABLE)) {
+    ng_error("module %s is not reliable - a lost message would stall the window", module->name);
+    return;
+  }
+
+  /* rank i < pairs sends to rank i + pairs, the rest only joins the collectives */
+  active = rank < 2 * pairs;
+  sender = rank < pairs;
+  if (active) peer = sender ? rank + pairs : rank - pairs;
+
+  ng_info(NG_VLEV1, "Allocating %ld bytes data buffer and %i requests", max_data_size, window);
+  NG_MALLOC(module, char*, max_data_size, buffer);
+  NG_MALLOC(module, char*, MSGRATE_ACK_SIZE + module->headerlen, ack);
+  reqs = (NG_Request*)calloc(window, sizeof(NG_Request));
+  if (reqs == NULL) {
+    ng_error("Could not allocate %i requests", window);
+    ng_exit(10);
+  }
+  memset(buffer, 0xff, max_data_size);
+  memset(ack, 0, MSGRATE_ACK_SIZE);
+
+  if (rank == 0) {
+    ng_info(NG_VNORM, "writing data to %s", g_options.output_file);
+    res = ng_result_open(open_output_file(g_options.output_file), "msgrate", msgrate_cols,
+                         sizeof(msgrate_cols)/sizeof(msgrate_cols[0]));
+    snprintf(txtbuf, sizeof(txtbuf),
+        "## Netgauge v%s - mode %s - %i processes, %i pairs, window %i\n"
+        "##\n"
+        "## A...message size [byte]\n"
+        "## B...aggregate message rate of all pairs [msgs/sec]\n"
+        "## C...aggregate throughput [Mbit/sec]\n"
+        "## D...average message rate of one pair [msgs/sec]\n"
+        "## E...time per message of all pairs [usec]\n"
+        "##\n"
+        "## A - B C - D E\n",
+        NG_VERSION, g_options.mode, p, pairs, window);
+    ng_result_comment(res, txtbuf);
+    if (NG_VLEV1 & g_options.verbose) printf("%s", txtbuf);
+  }
+
+  for (data_size = g_options.min_datasize; data_size > 0;
+       get_next_testparams(&data_size, &test_count, &g_options, module)) {
+    ng_info(NG_VLEV1, "testing %ld windows of %i messages with %ld bytes", test_count, window, data_size);
+
+    /* warm up until the time per window is steady */
+    ng_warmup_init(&warm);
+    do {
+      wsample = 0;
+      if (active) {
+        HRT_GET_TIMESTAMP(wstart);
+        msgrate_window(module, sender, peer, buffer, data_size, ack, reqs, window);
+        wsample = msgrate_usec_since(&wstart);
+      }
+    } while (!g_stop_tests && !ng_warmup_done(&warm, wsample, sender));
+
+    /* all pairs start together */
+    MPI_Barrier(MPI_COMM_WORLD);
+    HRT_GET_TIMESTAMP(start);
+    for (test = 0; active && test < test_count && !g_stop_tests; test++) {
+      msgrate_window(module, sender, peer, buffer, data_size, ack, reqs, window);
+    }
+    elapsed = msgrate_usec_since(&start);
+
+    /* [0] the slowest sender, [1] the sum of the pair rates */
+    times[0] = sender ? elapsed : 0;
+    times[1] = sender && elapsed > 0 ? window * test_count / elapsed * 1e6 : 0;
+    MPI_Reduce(&times[0], &all[0], 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&times[1], &all[1], 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0 && all[0] > 0) {
+      double msgs = (double)pairs * window * test_count;
+      double rate = msgs / all[0] * 1e6;
+      double mbit = rate * data_size * 8 / 1e6;
+
+      ng_result_int(res, data_size);
+      ng_result_int(res, pairs);
+      ng_result_int(res, window);
+      ng_result_double(res, rate);
+      ng_result_double(res, mbit);
+      ng_result_double(res, all[1] / pairs);
+      ng_result_double(res, all[0] / msgs);
+      ng_result_end(res);
+      ng_warmup_write(ng_result_textfile(res), data_size, &warm);
+      if (NG_VLEV1 & g_options.verbose) ng_warmup_write(stdout, data_size, &warm);
+      ng_syscalls_write(ng_result_textfile(res), data_size, module);
+      ng_schedule_report(data_size, all[0] / msgs);
+
+      printf("%ld bytes \t -> %.0lf msgs/s \t == %.2lf Mbit/s (%.0lf msgs/s per pair)\n",
+             data_size, rate, mbit, all[1] / pairs);
+      fflush(stdout);
+    }
+  }
+
+  if (rank == 0) ng_result_close(res);
+  free(reqs);
+}
+
+#else
+
+/* dummy pattern registration */
+int register_pattern_msgrate() {
+  return 0;
+}
+
+#endif
@@ -154,7 +154,7 @@ void fnbov_do_benchmarks(struct ng_module *module) {
   }
  shutdown:
    /* clean up */
-   free(buffer);
+   NG_FREE(module, buffer);
 #endif
 }
 
@@ -52,29 +52,8 @@ int register_pattern_noise() {
 }
 
 double get_ticks_per_second() {
-	#define NUM_TESTS 10
-
-	HRT_TIMESTAMP_T t1, t2;
-	uint64_t res[NUM_TESTS];
-	static uint64_t min=0; 
-	int count;
-
-	if (min > 0) {return ((double) min);}
-
-	ng_info(NG_VLEV1, "Calibrating timer, this might take some time: ");
-	for (count=0; count<NUM_TESTS; count++) {
-		HRT_GET_TIMESTAMP(t1);
-		sleep(1);
-		HRT_GET_TIMESTAMP(t2);
-		HRT_GET_ELAPSED_TICKS(t1, t2, &res[count])
-	}
-
-	min = res[0];
-	for (count=0; count<NUM_TESTS; count++) {
-		if (min > res[count]) min = res[count];
-	}
-
-	return ((double) min);
+	/* the timer is calibrated once at startup (see ng_calibrate.c) */
+	return ((double) g_timerfreq);
 }
 
 double tune_workload(int usecs) {
@@ -43,7 +43,8 @@
 /******** PROTOTYPES *********/
 
 /* This function returns the number of timerticks that happen in an interval of
- * one second, when the timer-macro "HRT_GET_TIMESTAMP( HRT_TIMESTAMP_T t1 )" is used. */
+ * one second, when the timer-macro "HRT_GET_TIMESTAMP( HRT_TIMESTAMP_T t1 )" is used.
+ * This is the frequency netgauge calibrated at startup (g_timerfreq). */
 
 double get_ticks_per_second();
 
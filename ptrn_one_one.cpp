@@ -10,12 +10,18 @@
 #include "netgauge.h"
 #ifdef NG_PTRN_ONE_ONE
 #include "hrtimer/hrtimer.h"
-#include <vector>
 #include <time.h>
 #include <algorithm>
 #include "fullresult.h"
 #include "statistics.h"
-#include "ng_tools.hpp"
+#include "ng_stats.h"
+#include "ng_hist.h"
+#include "ng_result.h"
+#include "ng_trace.h"
+#include "ng_tstamp.h"
+#include "ng_schedule.h"
+#include "ng_converge.h"
+#include "ng_warmup.h"
 
 
 extern "C" {
@@ -25,6 +31,27 @@ extern struct ng_options g_options;
 /* internal function prototypes */
 static void one_one_do_benchmarks(struct ng_module *module);
 
+/** output file columns (text: "A - B C D E (F G) - H I J K (L M) - N O P Q") */
+static const struct ng_result_col one_one_cols[] = {
+  {"size", NG_RES_INT, "%lld -"},
+  {"block_min", NG_RES_DOUBLE, NULL},
+  {"block_avg", NG_RES_DOUBLE, NULL},
+  {"block_med", NG_RES_DOUBLE, NULL},
+  {"block_max", NG_RES_DOUBLE, NULL},
+  {"block_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"block_outliers", NG_RES_INT, "%lld) -"},
+  {"rtt2_min", NG_RES_DOUBLE, NULL},
+  {"rtt2_avg", NG_RES_DOUBLE, NULL},
+  {"rtt2_med", NG_RES_DOUBLE, NULL},
+  {"rtt2_max", NG_RES_DOUBLE, NULL},
+  {"rtt2_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"rtt2_outliers", NG_RES_INT, "%lld) -"},
+  {"bw_min", NG_RES_DOUBLE, NULL},
+  {"bw_avg", NG_RES_DOUBLE, NULL},
+  {"bw_med", NG_RES_DOUBLE, NULL},
+  {"bw_max", NG_RES_DOUBLE, NULL}
+};
+
 /**
  * comm. pattern description and function pointer table
  */
@@ -81,7 +108,8 @@ static void one_one_do_benchmarks(struct ng_module *module) {
   if(rank % 2 == 0) g_options.mpi_opts->partner = rank+1;
   else g_options.mpi_opts->partner = rank-1;
 
-	FILE *outputfd;
+  struct ng_result *res = NULL;
+  struct ng_trace *trace = NULL;
   if(rank % 2 == 0) {
     char fname[1024];
     strncpy(fname, g_options.output_file, 1023);
@@ -93,8 +121,9 @@ static void one_one_do_benchmarks(struct ng_module *module) {
 
     // TODO: should be done globally in netgauge.c
     ng_info(NG_VNORM, "writing data to %s", fname);
-    outputfd = open_output_file(fname);
-    write_host_information(outputfd);
+    res = ng_result_open(open_output_file(fname), "one_one", one_one_cols,
+                         sizeof(one_one_cols)/sizeof(one_one_cols[0]));
+    trace = ng_trace_open("one_one");
   }
   
   /* buffer for header ... */
@@ -105,6 +134,31 @@ static void one_one_do_benchmarks(struct ng_module *module) {
   }
   memset(txtbuf, '\0', 2048);
 
+  /* latency histograms in ticks (written after each round) */
+  struct ng_hist *hblock = (struct ng_hist*)malloc(sizeof(struct ng_hist));
+  struct ng_hist *hrtt = (struct ng_hist*)malloc(sizeof(struct ng_hist));
+  if (hblock == NULL || hrtt == NULL) {
+    ng_error("Could not allocate memory for the histograms");
+    ng_exit(10);
+  }
+
+  /* stop each size once the latency interval is narrow enough */
+  int converge = ng_converge_enabled(&g_options);
+  struct ng_converge conv;
+  /* the warmup of each size runs until the RTT is steady */
+  struct ng_warmup warm;
+
+  /* per-stage latency breakdown if the module collects kernel timestamps */
+  struct ng_timestamps kts;
+  struct ng_tstamp_stats *tstages = NULL;
+  if (rank % 2 == 0 && module->timestamps && module->timestamps(g_options.mpi_opts->partner, &kts) == 0) {
+    tstages = (struct ng_tstamp_stats*)malloc(sizeof(struct ng_tstamp_stats));
+    if (tstages == NULL) {
+      ng_error("Could not allocate memory for the timestamp statistics");
+      ng_exit(10);
+    }
+  }
+
   /* header printing */
   if(rank % 2 == 0) {
     // if very verbose - long output
@@ -135,7 +189,7 @@ static void one_one_do_benchmarks(struct ng_module *module) {
       "## A  -  B  C  D  E  (F G) - H  I  J  K  (L M)  -  N  O  P  Q\n",
       NG_VERSION,
       g_options.mode, p);
-    fprintf(outputfd, "%s", txtbuf);
+    ng_result_comment(res, txtbuf);
 
     if(rank == 0) {
       if (NG_VLEV2 & g_options.verbose) {
@@ -186,7 +240,14 @@ static void one_one_do_benchmarks(struct ng_module *module) {
     ++test_round;
 
     // the benchmark results
-    std::vector<double> tblock, trtt;
+    struct ng_stats tblock, trtt;
+    ng_stats_init(&tblock);
+    ng_stats_init(&trtt);
+    ng_hist_init(hblock);
+    ng_hist_init(hrtt);
+    if (tstages) ng_tstamp_stats_init(tstages);
+    if (converge) ng_converge_init(&conv);
+    ng_warmup_init(&warm);
     
     ng_info(NG_VLEV1, "Round %d: testing %d times with %d bytes:", test_round, test_count, data_size);
     // if we print dots ...
@@ -202,7 +263,8 @@ static void one_one_do_benchmarks(struct ng_module *module) {
      *   (only if max. test time is not zero)
      */
     test_time = 0;
-    for (int test = -1 /* 1 warmup test */; test < test_count; test++) {
+    for (int test = -1 /* warmup tests */; test < test_count; test++) {
+      double wsample = 0;
 	
 	    /* first statement to prevent floating exception */
       /* TODO: add cool abstract dot interface ;) */
@@ -238,10 +300,13 @@ static void one_one_do_benchmarks(struct ng_module *module) {
            * reply and take time  ... simple ping-pong scheme */
           HRT_TIMESTAMP_T t[3];
           unsigned long long tibl, tirtt;
+          unsigned long long tssend = 0, tsrecv = 0;
   
           /* init statistics (TODO: what does this do?) */
           ng_statistics_test_begin(&statistics);
 
+          /* the kernel timestamps need a user timestamp on their clock */
+          if (tstages) tssend = ng_tstamp_now();
           HRT_GET_TIMESTAMP(t[0]);
 
           NG_SEND(g_options.mpi_opts->partner, buffer, data_size, module);
@@ -253,20 +318,32 @@ static void one_one_do_benchmarks(struct ng_module *module) {
           NG_RECV(g_options.mpi_opts->partner, buffer, data_size, module);
   
           HRT_GET_TIMESTAMP(t[2]);
+          if (tstages) tsrecv = ng_tstamp_now();
           HRT_GET_ELAPSED_TICKS(t[0],t[1],&tibl);
           HRT_GET_ELAPSED_TICKS(t[0],t[2],&tirtt);
+          wsample = HRT_GET_USEC(tirtt);
                       
           /* TODO: check received data */
   
           /* calculate results */
   
           if(test >= 0) {
-            trtt.push_back(HRT_GET_USEC(tirtt)/2);
-            tblock.push_back(HRT_GET_USEC(tibl));
+            ng_stats_add(&trtt, HRT_GET_USEC(tirtt)/2);
+            ng_stats_add(&tblock, HRT_GET_USEC(tibl));
+            ng_hist_record(hrtt, tirtt/2);
+            ng_hist_record(hblock, tibl);
+            ng_trace_record(trace, tibl, tirtt, data_size, test, g_options.mpi_opts->partner);
+          }
+          /* always fetch them so that the next round starts clean */
+          if (tstages && module->timestamps(g_options.mpi_opts->partner, &kts) == 0 && test >= 0) {
+            ng_tstamp_stats_add(tstages, tssend, tsrecv, &kts);
           }
 	        test_time += time(NULL) - cur_test_time;
 	    }
 
+	    /* stay at test -1 until the warmup is over */
+	    if (test < 0 && !ng_warmup_done(&warm, wsample, rank % 2 == 0)) test--;
+
 	    /* calculate overall statistics */
 	    ovr_tests++;
 	    ovr_bytes += data_size;
@@ -281,6 +358,8 @@ static void one_one_do_benchmarks(struct ng_module *module) {
 	      ng_info(NG_VLEV2, "Test stopped at %d tests", test);
 	      break;
 	    }
+
+      if (converge && ng_converge_done(&conv, test, rank % 2 == 0 ? &trtt : NULL)) break;
 	 
     }	/* end inner test loop */
     
@@ -291,58 +370,78 @@ static void one_one_do_benchmarks(struct ng_module *module) {
       }
 
       /* output statistics - blocking time */
-      double tblock_avg = std::accumulate(tblock.begin(), tblock.end(), (double)0)/(double)tblock.size(); 
-      double tblock_min = *min_element(tblock.begin(), tblock.end()); 
-      double tblock_max = *max_element(tblock.begin(), tblock.end()); 
-      std::vector<double>::iterator nthblock = tblock.begin()+tblock.size()/2;
-      nth_element(tblock.begin(), nthblock, tblock.end());
-      double tblock_med = *nthblock;
-      double tblock_var = standard_deviation(tblock.begin(), tblock.end(), tblock_avg);
-      int tblock_fail = count_range(tblock.begin(), tblock.end(), tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
+      double tblock_avg = ng_stats_mean(&tblock);
+      double tblock_min = tblock.min;
+      double tblock_max = tblock.max;
+      double tblock_med = ng_stats_quantile(&tblock, 0.5);
+      double tblock_var = ng_stats_stddev(&tblock);
+      int tblock_fail = ng_stats_count_outside(&tblock, tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
 
       /* output statistics - rtt time */
-      double trtt_avg = std::accumulate(trtt.begin(), trtt.end(), (double)0)/(double)trtt.size(); 
-      double trtt_min = *min_element(trtt.begin(), trtt.end()); 
-      double trtt_max = *max_element(trtt.begin(), trtt.end()); 
-      std::vector<double>::iterator nthrtt = trtt.begin()+trtt.size()/2;
-      std::nth_element(trtt.begin(), nthrtt, trtt.end());
-      double trtt_med = *nthrtt;
-      double trtt_var = standard_deviation(trtt.begin(), trtt.end(), trtt_avg);
-      int trtt_fail = count_range(trtt.begin(), trtt.end(), trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
-
-      // generate long output for output file
-      memset(txtbuf, '\0', 2048);
-      snprintf(txtbuf, 2047,
-	      "%ld - %.2lf %.2lf %.2lf %.2lf (%.2lf %i) - %.2lf %.2lf %.2lf %.2lf (%.2lf %i) - %.2lf %.2lf %.2lf %.2lf\n",
-        data_size, /* packet size */
-
-        tblock_min, /* minimum send blocking time */
-        tblock_avg, /* average send blocking time */
-        tblock_med, /* median send blocking time */
-        tblock_max, /* maximum send blocking time */ 
-
-        tblock_var, /* standard deviation */
-        tblock_fail, /* how many are bigger than twice the standard deviation? */
-        
-        trtt_min, /* minimum RTT time */
-        trtt_avg, /* average RTT time */
-        trtt_med, /* median RTT time */
-        trtt_max, /* maximum RTT time */
-        
-        trtt_var, /* standard deviation */
-        trtt_fail, /* how many are bigger than twice the standard deviation? */
-
-        data_size/trtt_max*8, /* minimum bandwidth */
-        data_size/trtt_avg*8, /* average bandwidth */
-        data_size/trtt_med*8, /* median bandwidth */
-        data_size/trtt_min*8 /* maximum bandwidth */
-        );
-      fprintf(outputfd, "%s", txtbuf);
+      double trtt_avg = ng_stats_mean(&trtt);
+      double trtt_min = trtt.min;
+      double trtt_max = trtt.max;
+      double trtt_med = ng_stats_quantile(&trtt, 0.5);
+      double trtt_var = ng_stats_stddev(&trtt);
+      int trtt_fail = ng_stats_count_outside(&trtt, trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
+
+      // write the record to the output file
+      ng_result_int(res, data_size);
+      ng_result_double(res, tblock_min);
+      ng_result_double(res, tblock_avg);
+      ng_result_double(res, tblock_med);
+      ng_result_double(res, tblock_max);
+      ng_result_double(res, tblock_var);
+      ng_result_int(res, tblock_fail);
+      ng_result_double(res, trtt_min);
+      ng_result_double(res, trtt_avg);
+      ng_result_double(res, trtt_med);
+      ng_result_double(res, trtt_max);
+      ng_result_double(res, trtt_var);
+      ng_result_int(res, trtt_fail);
+      ng_result_double(res, data_size/trtt_max*8);
+      ng_result_double(res, data_size/trtt_avg*8);
+      ng_result_double(res, data_size/trtt_med*8);
+      ng_result_double(res, data_size/trtt_min*8);
+      ng_result_end(res);
+      ng_hist_write(ng_result_textfile(res), "block", data_size, hblock);
+      ng_hist_write(ng_result_textfile(res), "rtt/2", data_size, hrtt);
+      if (tstages) ng_tstamp_stats_write(ng_result_textfile(res), data_size, tstages);
+      if (converge) ng_converge_write(ng_result_textfile(res), data_size, &conv);
+      ng_warmup_write(ng_result_textfile(res), data_size, &warm);
+      ng_syscalls_write(ng_result_textfile(res), data_size, module);
+      ng_schedule_report(data_size, trtt_med);
         
       // printf output *only* on rank 0!
 	    if (rank ==0) {
         // if very verbose - long output
         if (NG_VLEV2 & g_options.verbose) {
+          memset(txtbuf, '\0', 2048);
+          snprintf(txtbuf, 2047,
+            "%ld - %.2lf %.2lf %.2lf %.2lf (%.2lf %i) - %.2lf %.2lf %.2lf %.2lf (%.2lf %i) - %.2lf %.2lf %.2lf %.2lf\n",
+            data_size, /* packet size */
+
+            tblock_min, /* minimum send blocking time */
+            tblock_avg, /* average send blocking time */
+            tblock_med, /* median send blocking time */
+            tblock_max, /* maximum send blocking time */ 
+
+            tblock_var, /* standard deviation */
+            tblock_fail, /* how many are bigger than twice the standard deviation? */
+        
+            trtt_min, /* minimum RTT time */
+            trtt_avg, /* average RTT time */
+            trtt_med, /* median RTT time */
+            trtt_max, /* maximum RTT time */
+        
+            trtt_var, /* standard deviation */
+            trtt_fail, /* how many are bigger than twice the standard deviation? */
+
+            data_size/trtt_max*8, /* minimum bandwidth */
+            data_size/trtt_avg*8, /* average bandwidth */
+            data_size/trtt_med*8, /* median bandwidth */
+            data_size/trtt_min*8 /* maximum bandwidth */
+            );
           printf("%s", txtbuf);
           
         } else
@@ -386,6 +485,15 @@ static void one_one_do_benchmarks(struct ng_module *module) {
         }
       }
     }
+    if (tstages && rank == 0 && (NG_VLEV1 & g_options.verbose)) {
+      ng_tstamp_stats_write(stdout, data_size, tstages);
+    }
+    if (converge && rank == 0 && (NG_VLEV1 & g_options.verbose)) {
+      ng_converge_write(stdout, data_size, &conv);
+    }
+    if (rank == 0 && (NG_VLEV1 & g_options.verbose)) {
+      ng_warmup_write(stdout, data_size, &warm);
+    }
     // write output file
       
     ng_info(NG_VLEV1, "\n");
@@ -398,13 +506,17 @@ static void one_one_do_benchmarks(struct ng_module *module) {
   }	/* end outer test loop */
 
   if(rank % 2 == 0) {
-    fclose(outputfd);
+    ng_result_close(res);
+    ng_trace_close(trace);
   }
 
 
    
  shutdown:
    if(txtbuf) free(txtbuf);
+   free(hblock);
+   free(hrtt);
+   free(tstages);
     
 }
 
@@ -12,12 +12,12 @@
 #ifdef NG_PTRN_ONE_ONE_ALL
 #include "hrtimer/hrtimer.h"
 #include <time.h>
-#include <numeric>
-#include <vector>
-#include <algorithm>
 #include "fullresult.h"
 #include "statistics.h"
-#include "ng_tools.hpp"
+#include "ng_stats.h"
+#include "ng_hist.h"
+#include "ng_result.h"
+#include "ng_trace.h"
 
 #define MAX_ROUNDS 1024
 
@@ -27,6 +27,37 @@ extern struct ng_options g_options;
 
 static void one_one_all_do_benchmarks(struct ng_module *module);
 
+/** output file columns (text: "R T A - B C D E (F G) - H I J K (L M)") */
+static const struct ng_result_col one_one_all_cols[] = {
+  {"peer", NG_RES_INT, NULL},
+  {"tests", NG_RES_INT, NULL},
+  {"size", NG_RES_INT, "%lld -"},
+  {"block_min", NG_RES_DOUBLE, NULL},
+  {"block_avg", NG_RES_DOUBLE, NULL},
+  {"block_med", NG_RES_DOUBLE, NULL},
+  {"block_max", NG_RES_DOUBLE, NULL},
+  {"block_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"block_outliers", NG_RES_INT, "%lld) -"},
+  {"rtt2_min", NG_RES_DOUBLE, "%.4lf"},
+  {"rtt2_avg", NG_RES_DOUBLE, NULL},
+  {"rtt2_med", NG_RES_DOUBLE, NULL},
+  {"rtt2_max", NG_RES_DOUBLE, NULL},
+  {"rtt2_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"rtt2_outliers", NG_RES_INT, "%lld)"}
+};
+
+/** short text output (without -vv): "R T - B C D E (F G)" */
+static const struct ng_result_col one_one_all_short_cols[] = {
+  {"peer", NG_RES_INT, NULL},
+  {"tests", NG_RES_INT, "%lld -"},
+  {"rtt2_min", NG_RES_DOUBLE, "%.4lf"},
+  {"rtt2_avg", NG_RES_DOUBLE, NULL},
+  {"rtt2_med", NG_RES_DOUBLE, NULL},
+  {"rtt2_max", NG_RES_DOUBLE, NULL},
+  {"rtt2_stddev", NG_RES_DOUBLE, "(%.2lf"},
+  {"rtt2_outliers", NG_RES_INT, "%lld)"}
+};
+
 static struct ng_comm_pattern pattern_one_one_all = {
   pattern_one_one_all.name = "one_one_all",
   pattern_one_one_all.desc = "measures ping-pong latency between all nodes",
@@ -74,8 +105,17 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
     ng_exit(10);
   }
 
-  /* file to write results in */
-  FILE *outputfd;
+  /* RTT/2 histogram in ticks (written for each peer) */
+  struct ng_hist *hrtt = (struct ng_hist*)malloc(sizeof(struct ng_hist));
+  if (!hrtt) {
+    ng_error("Could not allocate memory for the histogram");
+    ng_exit(10);
+  }
+
+  /* file to write results in - the short layout only for plain text */
+  struct ng_result *res = NULL;
+  struct ng_trace *trace = ng_trace_open("one_one_all");
+  int longrec = (NG_VLEV2 & g_options.verbose) || g_options.result_format != NG_FMT_TEXT;
 
   for (int boss = 0; boss < size; boss++) {
     if(rank == boss) {
@@ -88,8 +128,13 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
       }
       ng_info(NG_VNORM, "writing data to %s", fname);
 
-      outputfd = open_output_file(fname);
-      write_host_information(outputfd);
+      if (longrec) {
+        res = ng_result_open(open_output_file(fname), "one_one_all", one_one_all_cols,
+                             sizeof(one_one_all_cols)/sizeof(one_one_all_cols[0]));
+      } else {
+        res = ng_result_open(open_output_file(fname), "one_one_all", one_one_all_short_cols,
+                             sizeof(one_one_all_short_cols)/sizeof(one_one_all_short_cols[0]));
+      }
   
       /* header printing */
       // if very verbose - long output
@@ -137,8 +182,8 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
                  NG_VERSION, g_options.mode, rank, size);
       }
       // write to the output file
-      fprintf(outputfd, "%s", txtbuf);
-      fflush(outputfd);
+      ng_result_comment(res, txtbuf);
+      ng_result_flush(res);
     }
 
     for (int slave = 0; slave < size; slave++) {
@@ -154,8 +199,11 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
 
       if (rank == boss || rank == slave) {
         // the benchmark results
-        std::vector<double> tblock, trtt;
+        struct ng_stats tblock, trtt;
         unsigned long long tibl, tirtt;
+        ng_stats_init(&tblock);
+        ng_stats_init(&trtt);
+        ng_hist_init(hrtt);
 
         /* Test loop
          * - run the tests for data size 1
@@ -219,15 +267,17 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
             if(test_round >= 0) {
               double cur_rtt = (HRT_GET_USEC(tirtt)/2);
               double trtt_min = 0;
-              if (trtt.size() > 0) {
-                trtt_min = *min_element(trtt.begin(), trtt.end());
+              if (trtt.n > 0) {
+                trtt_min = trtt.min;
               }
               if (cur_rtt < trtt_min) {
                 test_count += g_options.testcount;
                 ng_info(NG_VLEV2, "Test count increased to %d", test_count);
               }
-              tblock.push_back(HRT_GET_USEC(tibl));
-              trtt.push_back(cur_rtt);
+              ng_stats_add(&tblock, HRT_GET_USEC(tibl));
+              ng_stats_add(&trtt, cur_rtt);
+              ng_hist_record(hrtt, tirtt/2);
+              ng_trace_record(trace, tibl, tirtt, data_size, test_round, slave);
             }
             test_time += time(NULL) - cur_test_time;
 
@@ -252,68 +302,44 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
 
         if (rank==boss) {
           /* output statistics - blocking time */
-          double tblock_avg = std::accumulate(tblock.begin(), tblock.end(), (double)0)/(double)tblock.size();
-          double tblock_min = *min_element(tblock.begin(), tblock.end());
-          double tblock_max = *max_element(tblock.begin(), tblock.end());
-          std::vector<double>::iterator nthblock = tblock.begin()+tblock.size()/2;
-          nth_element(tblock.begin(), nthblock, tblock.end());
-          double tblock_med = *nthblock;
-          double tblock_var = standard_deviation(tblock.begin(), tblock.end(), tblock_avg);
-          int tblock_fail = count_range(tblock.begin(), tblock.end(), tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
+          double tblock_avg = ng_stats_mean(&tblock);
+          double tblock_min = tblock.min;
+          double tblock_max = tblock.max;
+          double tblock_med = ng_stats_quantile(&tblock, 0.5);
+          double tblock_var = ng_stats_stddev(&tblock);
+          int tblock_fail = ng_stats_count_outside(&tblock, tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
 
           /* output statistics - rtt time */
-          double trtt_avg = std::accumulate(trtt.begin(), trtt.end(), (double)0)/(double)trtt.size();
-          double trtt_min = *min_element(trtt.begin(), trtt.end());
-          double trtt_max = *max_element(trtt.begin(), trtt.end());
-          std::vector<double>::iterator nthrtt = trtt.begin()+trtt.size()/2;
-          std::nth_element(trtt.begin(), nthrtt, trtt.end());
-          double trtt_med = *nthrtt;
-          double trtt_var = standard_deviation(trtt.begin(), trtt.end(), trtt_avg);
-          int trtt_fail = count_range(trtt.begin(), trtt.end(), trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
+          double trtt_avg = ng_stats_mean(&trtt);
+          double trtt_min = trtt.min;
+          double trtt_max = trtt.max;
+          double trtt_med = ng_stats_quantile(&trtt, 0.5);
+          double trtt_var = ng_stats_stddev(&trtt);
+          int trtt_fail = ng_stats_count_outside(&trtt, trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
 
           // generate long output for output file
-          memset(txtbuf, '\0', 2048);
-          if (NG_VLEV2 & g_options.verbose) {
-            snprintf(txtbuf, 2047,
-                     "%d %d %ld - %.2lf %.2lf %.2lf %.2lf (%.2lf %i) - %.4lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
-                     slave,
-                     test_round, /* num tests */
-                     data_size, /* packet size */
-
-                     tblock_min, /* minimum send blocking time */
-                     tblock_avg, /* average send blocking time */
-                     tblock_med, /* median send blocking time */
-                     tblock_max, /* maximum send blocking time */ 
-
-                     tblock_var, /* standard deviation */
-                     tblock_fail, /* how many are bigger than twice the standard deviation? */
-        
-                     trtt_min, /* minimum RTT time */
-                     trtt_avg, /* average RTT time */
-                     trtt_med, /* median RTT time */
-                     trtt_max, /* maximum RTT time */
-        
-                     trtt_var, /* standard deviation */
-                     trtt_fail /* how many are bigger than twice the standard deviation? */
-                     );
-          } else {
-            snprintf(txtbuf, 2047,
-                     "%d %d - %.4lf %.2lf %.2lf %.2lf (%.2lf %i)\n",
-                     slave,
-                     test_round, /* num tests */
-
-                     trtt_min, /* minimum RTT time */
-                     trtt_avg, /* average RTT time */
-                     trtt_med, /* median RTT time */
-                     trtt_max, /* maximum RTT time */
-        
-                     trtt_var, /* standard deviation */
-                     trtt_fail /* how many are bigger than twice the standard deviation? */
-                     );
+          ng_result_int(res, slave);
+          ng_result_int(res, test_round);
+          if (longrec) {
+            ng_result_int(res, data_size);
+            ng_result_double(res, tblock_min);
+            ng_result_double(res, tblock_avg);
+            ng_result_double(res, tblock_med);
+            ng_result_double(res, tblock_max);
+            ng_result_double(res, tblock_var);
+            ng_result_int(res, tblock_fail);
           }
-          
-          fprintf(outputfd, "%s", txtbuf);
-          fflush(outputfd);
+          ng_result_double(res, trtt_min);
+          ng_result_double(res, trtt_avg);
+          ng_result_double(res, trtt_med);
+          ng_result_double(res, trtt_max);
+          ng_result_double(res, trtt_var);
+          ng_result_int(res, trtt_fail);
+          ng_result_end(res);
+
+          snprintf(txtbuf, 2047, "rtt/2:%i", slave);
+          ng_hist_write(ng_result_textfile(res), txtbuf, data_size, hrtt);
+          ng_result_flush(res);
         }
 
         /* only a client does the stats stuff */
@@ -325,11 +351,13 @@ static void one_one_all_do_benchmarks(struct ng_module *module) {
     }
 
     /* close the output file */
-    if (rank==boss) fclose(outputfd);
+    if (rank==boss) ng_result_close(res);
     if (size > 2) MPI_Barrier(MPI_COMM_WORLD);
   }
 
+  ng_trace_close(trace);
   if (txtbuf) free(txtbuf);
+  free(hrtt);
 }
 
 } /* extern C */
@@ -10,12 +10,11 @@
 #include "netgauge.h"
 #if defined NG_PTRN_ONE_ONE_DTYPE && defined NG_MPI
 #include "hrtimer/hrtimer.h"
-#include <vector>
 #include <time.h>
 #include <algorithm>
 #include "fullresult.h"
 #include "statistics.h"
-#include "ng_tools.hpp"
+#include "ng_stats.h"
 
 
 extern "C" {
@@ -172,7 +171,9 @@ static void one_one_do_benchmarks(struct ng_module *module) {
     ++test_round;
 
     // the benchmark results
-    std::vector<double> tblock, trtt;
+    struct ng_stats tblock, trtt;
+    ng_stats_init(&tblock);
+    ng_stats_init(&trtt);
     
     ng_info(NG_VLEV1, "Round %d: testing %d times with %d bytes:", test_round, test_count, data_size);
     // if we print dots ...
@@ -254,8 +255,8 @@ static void one_one_do_benchmarks(struct ng_module *module) {
           /* calculate results */
   
           if(test >= 0) {
-            trtt.push_back(HRT_GET_USEC(tirtt)/2);
-            tblock.push_back(HRT_GET_USEC(tibl));
+            ng_stats_add(&trtt, HRT_GET_USEC(tirtt)/2);
+            ng_stats_add(&tblock, HRT_GET_USEC(tibl));
           }
 	        test_time += time(NULL) - cur_test_time;
 	    }
@@ -286,24 +287,20 @@ static void one_one_do_benchmarks(struct ng_module *module) {
       }
 
       /* output statistics - blocking time */
-      double tblock_avg = std::accumulate(tblock.begin(), tblock.end(), (double)0)/(double)tblock.size(); 
-      double tblock_min = *min_element(tblock.begin(), tblock.end()); 
-      double tblock_max = *max_element(tblock.begin(), tblock.end()); 
-      std::vector<double>::iterator nthblock = tblock.begin()+tblock.size()/2;
-      nth_element(tblock.begin(), nthblock, tblock.end());
-      double tblock_med = *nthblock;
-      double tblock_var = standard_deviation(tblock.begin(), tblock.end(), tblock_avg);
-      int tblock_fail = count_range(tblock.begin(), tblock.end(), tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
+      double tblock_avg = ng_stats_mean(&tblock);
+      double tblock_min = tblock.min;
+      double tblock_max = tblock.max;
+      double tblock_med = ng_stats_quantile(&tblock, 0.5);
+      double tblock_var = ng_stats_stddev(&tblock);
+      int tblock_fail = ng_stats_count_outside(&tblock, tblock_avg-tblock_var*2, tblock_avg+tblock_var*2);
 
       /* output statistics - rtt time */
-      double trtt_avg = std::accumulate(trtt.begin(), trtt.end(), (double)0)/(double)trtt.size(); 
-      double trtt_min = *min_element(trtt.begin(), trtt.end()); 
-      double trtt_max = *max_element(trtt.begin(), trtt.end()); 
-      std::vector<double>::iterator nthrtt = trtt.begin()+trtt.size()/2;
-      std::nth_element(trtt.begin(), nthrtt, trtt.end());
-      double trtt_med = *nthrtt;
-      double trtt_var = standard_deviation(trtt.begin(), trtt.end(), trtt_avg);
-      int trtt_fail = count_range(trtt.begin(), trtt.end(), trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
+      double trtt_avg = ng_stats_mean(&trtt);
+      double trtt_min = trtt.min;
+      double trtt_max = trtt.max;
+      double trtt_med = ng_stats_quantile(&trtt, 0.5);
+      double trtt_var = ng_stats_stddev(&trtt);
+      int trtt_fail = ng_stats_count_outside(&trtt, trtt_avg-trtt_var*2, trtt_avg+trtt_var*2);
 
       // if very verbose - long output
       if (NG_VLEV2 & g_options.verbose) {
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2009 The Trustees of Indiana University and Indiana
+ *                    University Research and Technology
+ *                    Corporation.  All rights reserved.
+ *
+ * Author(s): Torsten Hoefler <htor@cs.indiana.edu>
+ *
+ */
+
+#include "netgauge.h"
+#ifdef NG_PTRN_STREAM
+#include "hrtimer/hrtimer.h"
+#include "ng_result.h"
+#include "ng_schedule.h"
+#include "ng_warmup.h"
+#include "ptrn_stream_cmdline.h"
+#include <stdint.h>
+
+/*
+ * Unidirectional streaming bandwidth (like iperf or netperf
+ * TCP_STREAM): the sender pushes --window messages back-to-back and
+ * the receiver returns one small ack per window. The sustained
+ * bandwidth is the delivered data over the time of all windows. The
+ * pattern only uses the module, so it runs between a client and a
+ * server (-a) without MPI as well as between two MPI ranks.
+ */
+
+/** receives on unreliable modules give up after this idle time */
+#define STREAM_TIMEOUT_USEC 100000
+
+/** both sides give up after this many windows in a row that timed out */
+#define STREAM_MAX_TIMEOUTS 10
+
+/**
+ * Byte of every message that holds the number of its window (byte 0 is
+ * the sender id of mod_eth). The ack returns it, so the sender can tell
+ * the late ack of a window it gave up on from the ack of the current
+ * one. 1-byte messages have no room for it.
+ */
+#define STREAM_TAG_OFF 1
+/** the ack has no window number */
+#define STREAM_NO_TAG 0xffffffff
+
+/** the ack that closes a window */
+struct stream_ack {
+  uint32_t hdr;        /* mod_eth puts the sender id in the first byte */
+  uint32_t lost;       /* messages of the window that did not arrive */
+  uint32_t warmup;     /* warmup windows of the receiver, 0 while it warms up */
+  uint32_t window;     /* newest window number that arrived or STREAM_NO_TAG */
+};
+
+static struct ptrn_stream_cmd_struct args_info;
+
+extern struct ng_options g_options;
+
+/* internal function prototypes */
+static void stream_do_benchmarks(struct ng_module *module);
+
+/** output file columns */
+static const struct ng_result_col stream_cols[] = {
+  {"size", NG_RES_INT, NULL},
+  {"window", NG_RES_INT, NULL},
+  {"mbit_per_s", NG_RES_DOUBLE, "%.2lf"},
+  {"best_mbit_per_s", NG_RES_DOUBLE, "%.2lf"},
+  {"msgs_per_s", NG_RES_DOUBLE, "%.0lf"},
+  {"lost", NG_RES_INT, NULL}
+};
+
+/**
+ * comm. pattern description and function pointer table
+ */
+static struct ng_comm_pattern pattern_stream = {
+   .name = "stream",
+   .desc = "measures the sustained unidirectional bandwidth of a window of back-to-back messages",
+   .flags = NG_PTRN_NB,
+   .do_benchmarks = stream_do_benchmarks
+};
+
+/**
+ * register this comm. pattern for usage in main
+ * program
+ */
+int register_pattern_stream() {
+  ng_register_pattern(&pattern_stream);
+  return 0;
+}
+
+/** usecs since start, without the timer overhead */
+static inline double stream_usec_since(HRT_TIMESTAMP_T *start) {
+  HRT_TIMESTAMP_T now;
+  unsigned long long ticks;
+
+  HRT_GET_TIMESTAMP(now);
+  HRT_GET_ELAPSED_TICKS(*start, now, &ticks);
+  return HRT_GET_USEC(ticks);
+}
+
+/**
+ * Receives one message from peer into a request that stays posted
+ * over calls (*req is NULL once it completed), so a message that
+ * timed out is picked up by the next call.
+ *
+ * @return 0 when it arrived, 1 after timeout usecs without it
+ *    (0 = wait forever) and -1 on errors
+ */
+static int stream_recv(struct ng_module *module, int peer, void *buf, int size,
+                       NG_Request *req, double timeout) {
+  HRT_TIMESTAMP_T start;
+  int ret;
+
+  HRT_GET_TIMESTAMP(start);
+  if (*req == NULL && module->irecvfrom(peer, buf, size, req) < 0) return -1;
+  while ((ret = module->test(req)) > 0) {
+    if (g_stop_tests) return -1;
+    if (timeout > 0 && stream_usec_since(&start) > timeout) return 1;
+    if (module->progress && module->progress(timeout > 0 ? 1 : -1) < 0) return -1;
+  }
+  return ret < 0 ? -1 : 0;
+}
+
+/** sends a window of back-to-back messages, @return 0 on success */
+static int stream_send_window(struct ng_module *module, int peer, char *buffer, int size,
+                              NG_Request *reqs, int window) {
+  int i;
+
+  if (args_info.isend_flag) {
+    for (i = 0; i < window; i++) {
+      if (module->isendto(peer, buffer, size, &reqs[i]) < 0) return -1;
+    }
+    return ng_waitall(module, window, reqs);
+  }
+  for (i = 0; i < window; i++) {
+    if (ng_send_all(peer, buffer, size, module)) return -1;
+  }
+  return 0;
+}
+
+/**
+ * Counts the windows in a row that timed out completely (the ack on
+ * the sender, all messages on the receiver), so a lost peer doesn't
+ * keep the other side waiting for timeouts forever.
+ *
+ * @return non-zero after STREAM_MAX_TIMEOUTS of them
+ */
+static int stream_timed_out(int *timeouts, int timedout, int sender) {
+  *timeouts = timedout ? *timeouts + 1 : 0;
+  if (*timeouts < STREAM_MAX_TIMEOUTS) return 0;
+  ng_error("no %s from the peer for %i windows in a row, giving up",
+           sender ? "ack" : "data", STREAM_MAX_TIMEOUTS);
+  return 1;
+}
+
+/**
+ * Receives a window, counts the messages that did not arrive (the rest
+ * of the window once one timed out) in ack->lost and puts the newest
+ * window number of the messages into ack->window.
+ *
+ * @return 0 on success
+ */
+static int stream_recv_window(struct ng_module *module, int peer, char *buffer, int size,
+                              NG_Request *req, int window, double timeout, struct stream_ack *ack) {
+  int i, ret;
+  uint8_t tag;
+
+  ack->lost = 0;
+  ack->window = STREAM_NO_TAG;
+  for (i = 0; i < window; i++) {
+    ret = stream_recv(module, peer, buffer, size, req, timeout);
+    if (ret < 0) return -1;
+    if (ret > 0) {
+      ack->lost = window - i;
+      break;
+    }
+    /* stragglers of an earlier window may be in between */
+    if (size > STREAM_TAG_OFF) {
+      tag = buffer[STREAM_TAG_OFF];
+      if (ack->window == STREAM_NO_TAG || (int8_t)(tag - ack->window) > 0) ack->window = tag;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Receives the ack of window wnum, acks of other windows (late acks of
+ * windows that timed out) are dropped. Without window numbers every
+ * ack is taken.
+ *
+ * @return like stream_recv(), the ack has all messages lost and no
+ *    warmup on timeout (the ack may arrive into it before the call, so
+ *    it is only set then)
+ */
+static int stream_recv_ack(struct ng_module *module, int peer, struct stream_ack *ack, NG_Request *req,
+                           int window, double timeout, int tagged, uint8_t wnum) {
+  HRT_TIMESTAMP_T start;
+  double left = timeout;
+  int ret;
+
+  HRT_GET_TIMESTAMP(start);
+  while (1) {
+    ret = stream_recv(module, peer, ack, sizeof(*ack), req, left);
+    if (ret != 0 || !tagged || ack->window == wnum) break;
+    ng_info(NG_VLEV2, "dropping a late ack (window %u, waiting for %u)", ack->window, wnum);
+    if (timeout > 0 && (left = timeout - stream_usec_since(&start)) <= 0) {
+      ret = 1;
+      break;
+    }
+  }
+  if (ret != 0) {
+    ack->lost = window;
+    ack->warmup = 0;
+  }
+  return ret;
+}
+
+static void stream_do_benchmarks(struct ng_module *module) {
+  struct ng_result *res = NULL;
+  struct ng_warmup warm;
+  struct stream_ack *ack;
+  NG_Request *reqs, dreq = NULL, areq = NULL;
+  char *buffer, txtbuf[1024];
+  long data_size, test_count = g_options.testcount, test;
+  long max_data_size = ng_min(g_options.max_datasize + module->headerlen, module->max_datasize);
+  unsigned long lost, warmup;
+  int window, sender, peer, ret, tagged, timeouts = 0, started = 0, reliable = module->flags & NG_MOD_RELIABLE;
+  uint8_t wnum = 0;
+  unsigned long long ticks;
+  HRT_TIMESTAMP_T wstart, last;
+  double timeout, elapsed, best, t, delivered;
+
+  /* parse cmdline arguments */
+  if (ptrn_stream_parser_string(g_options.ptrnopts, &args_info, "netgauge") != 0) {
+    ng_abort("commandline parser error");
+  }
+  window = args_info.window_arg;
+  if (window < 1) {
+    ng_error("the window must hold at least one message");
+    return;
+  }
+  if (g_options.mpi && g_options.mpi_opts->worldsize != 2) {
+    ng_error("the stream pattern needs exactly 2 processes (have %i)", g_options.mpi_opts->worldsize);
+    return;
+  }
+  if (!g_options.mpi && g_options.adaptive) {
+    ng_error("the adaptive size schedule needs MPI (the server can't follow the client)");
+    return;
+  }
+
+  /* rank 0 or the client sends, the other side is peer 1 or 0 of the module */
+  sender = g_options.mpi ? g_options.mpi_opts->worldrank == 0 : !g_options.server;
+  peer = sender ? 1 : 0;
+  /* the sender waits for the receiver's timeout and the ack */
+  timeout = reliable ? 0 : (sender ? 4 : 1) * STREAM_TIMEOUT_USEC;
+
+  ng_info(NG_VLEV1, "Allocating %ld bytes data buffer and %i requests", max_data_size, window);
+  NG_MALLOC(module, char*, max_data_size, buffer);
+  NG_MALLOC(module, struct stream_ack*, sizeof(struct stream_ack) + module->headerlen, ack);
+  reqs = (NG_Request*)calloc(window, sizeof(NG_Request));
+  if (reqs == NULL) {
+    ng_error("Could not allocate %i requests", window);
+    ng_exit(10);
+  }
+  /* mod_eth reads the first byte of every frame as the sender id (0) */
+  memset(buffer, 0, max_data_size);
+  memset(ack, 0, sizeof(*ack));
+
+  if (sender) {
+    ng_info(NG_VNORM, "writing data to %s", g_options.output_file);
+    res = ng_result_open(open_output_file(g_options.output_file), "stream", stream_cols,
+                         sizeof(stream_cols)/sizeof(stream_cols[0]));
+    snprintf(txtbuf, sizeof(txtbuf),
+        "## Netgauge v%s - mode %s - window %i (%s)\n"
+        "##\n"
+        "## A...message size [byte]\n"
+        "## B...sustained bandwidth of the delivered data [Mbit/sec]\n"
+        "## C...bandwidth of the fastest window [Mbit/sec]\n"
+        "## D...delivered messages [msgs/sec]\n"
+        "## E...lost messages\n"
+        "##\n"
+        "## A - B C - D E\n",
+        NG_VERSION, g_options.mode, window, args_info.isend_flag ? "isendto" : "sendto");
+    ng_result_comment(res, txtbuf);
+    if (NG_VLEV1 & g_options.verbose) printf("%s", txtbuf);
+  }
+
+  for (data_size = g_options.min_datasize; data_size > 0;
+       get_next_testparams(&data_size, &test_count, &g_options, module)) {
+    ng_info(NG_VLEV1, "testing %ld windows of %i messages with %ld bytes", test_count, window, data_size);
+    tagged = data_size > STREAM_TAG_OFF;
+
+    /* the receiver decides when the time between windows is steady */
+    ng_warmup_init(&warm);
+    warm.local = 1;
+    HRT_GET_TIMESTAMP(last);
+    while (!g_stop_tests) {
+      if (sender) {
+        if (tagged) buffer[STREAM_TAG_OFF] = ++wnum;
+        if (stream_send_window(module, peer, buffer, data_size, reqs, window) ||
+            (ret = stream_recv_ack(module, peer, ack, &areq, window, timeout, tagged, wnum)) < 0) {
+          ng_error("the warmup window of %ld bytes failed", data_size);
+          goto out;
+        }
+        if (stream_timed_out(&timeouts, ret, sender)) goto out;
+        if (ng_warmup_follow(&warm, ack->warmup > 0)) break;
+      } else {
+        /* without a handshake (mod_eth) the server waits for the client */
+        if (stream_recv_window(module, peer, buffer, data_size, &dreq, window,
+                               started ? timeout : 0, ack)) {
+          ng_error("the warmup window of %ld bytes failed", data_size);
+          goto out;
+        }
+        started = 1;
+        if (stream_timed_out(&timeouts, ack->lost == (uint32_t)window, sender)) goto out;
+        HRT_GET_TIMESTAMP(wstart);
+        HRT_GET_ELAPSED_TICKS(last, wstart, &ticks);
+        ack->warmup = ng_warmup_done(&warm, HRT_GET_USEC(ticks), 1) ? warm.tests : 0;
+        last = wstart;
+        if (ng_send_all(peer, ack, sizeof(*ack), module)) {
+          ng_error("the ack of a warmup window failed");
+          goto out;
+        }
+        if (ack->warmup) break;
+      }
+    }
+
+    /* both sides run test_count windows after the receiver's warmup;
+     * if the ack that ended it got lost, the sender already sent some
+     * of them as warmup windows (the later acks tell it) */
+    warmup = ack->warmup && ack->warmup <= warm.tests ? ack->warmup : warm.tests;
+    elapsed = 0;
+    best = -1;
+    lost = 0;
+    for (test = 0; warm.tests + test < warmup + test_count && !g_stop_tests; test++) {
+      if (sender) {
+        if (tagged) buffer[STREAM_TAG_OFF] = ++wnum;
+        HRT_GET_TIMESTAMP(wstart);
+        if (stream_send_window(module, peer, buffer, data_size, reqs, window) ||
+            (ret = stream_recv_ack(module, peer, ack, &areq, window, timeout, tagged, wnum)) < 0) {
+          ng_error("window %ld of %ld bytes failed", test, data_size);
+          goto out;
+        }
+        t = stream_usec_since(&wstart);
+        if (stream_timed_out(&timeouts, ret, sender)) goto out;
+        if (ack->warmup && ack->warmup <= warm.tests) warmup = ack->warmup;
+        /* a lost ack counts the whole window as lost */
+        elapsed += t;
+        lost += ack->lost;
+        if (ack->lost == 0 && (best < 0 || t < best)) best = t;
+      } else {
+        if (stream_recv_window(module, peer, buffer, data_size, &dreq, window, timeout, ack) ||
+            ng_send_all(peer, ack, sizeof(*ack), module)) {
+          ng_error("window %ld of %ld bytes failed", test, data_size);
+          goto out;
+        }
+        if (stream_timed_out(&timeouts, ack->lost == (uint32_t)window, sender)) goto out;
+      }
+    }
+
+    if (sender && elapsed > 0) {
+      delivered = (double)window * test - lost;
+      ng_result_int(res, data_size);
+      ng_result_int(res, window);
+      ng_result_double(res, delivered * data_size * 8 / elapsed);
+      ng_result_double(res, best > 0 ? window * data_size * 8 / best : 0);
+      ng_result_double(res, delivered / elapsed * 1e6);
+      ng_result_int(res, lost);
+      ng_result_end(res);
+      ng_warmup_write(ng_result_textfile(res), data_size, &warm);
+      if (NG_VLEV1 & g_options.verbose) ng_warmup_write(stdout, data_size, &warm);
+      ng_syscalls_write(ng_result_textfile(res), data_size, module);
+      ng_schedule_report(data_size, delivered > 0 ? elapsed / delivered : elapsed);
+
+      printf("%ld bytes \t -> %.2lf Mbit/s sustained (best window %.2lf Mbit/s, %lu lost)\n",
+             data_size, delivered * data_size * 8 / elapsed,
+             best > 0 ? window * data_size * 8 / best : 0, lost);
+      fflush(stdout);
+    } else if (!sender) {
+      /* the receive side of the syscall statistics */
+      ng_syscalls_write(NULL, data_size, module);
+    }
+  }
+
+out:
+  if (sender) ng_result_close(res);
+  free(reqs);
+}
+
+#else
+
+/* dummy pattern registration */
+int register_pattern_stream() {
+  return 0;
+}
+
+#endif